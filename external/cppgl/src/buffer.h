@@ -40,6 +40,9 @@ public:
     void unbind_base(uint32_t unit) const {
         glBindBufferBase(GL_TEMPLATE_BUFFER, unit, 0);
     }
+    void bind_range(uint32_t unit, size_t offset_bytes, size_t size_bytes) const {
+        glBindBufferRange(GL_TEMPLATE_BUFFER, unit, id, offset_bytes, size_bytes);
+    }
 
     // directly upload data (discards and reallocates memory, slow!)
     void upload_data(const void* data, size_t size_bytes, GLenum hint = GL_DYNAMIC_DRAW) {
@@ -72,6 +75,11 @@ public:
         bind();
         return glMapBuffer(GL_TEMPLATE_BUFFER, access);
     }
+    // map a range, e.g. with GL_MAP_UNSYNCHRONIZED_BIT for ranges the GPU is known to be done with (see FramePacer)
+    void* map_range(size_t offset_bytes, size_t size_bytes, GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT) const {
+        bind();
+        return glMapBufferRange(GL_TEMPLATE_BUFFER, offset_bytes, size_bytes, access);
+    }
     void unmap() const {
         glUnmapBuffer(GL_TEMPLATE_BUFFER);
         unbind();
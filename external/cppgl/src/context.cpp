@@ -9,6 +9,8 @@
 #include "drawelement.h"
 #include "anim.h"
 #include "query.h"
+#include "trace.h"
+#include "texture_loader.h"
 #include "gui.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -102,6 +104,7 @@ Context::Context() {
     glfwWindowHint(GLFW_FLOATING, parameters.floating);
     glfwWindowHint(GLFW_MAXIMIZED, parameters.maximised);
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, parameters.gl_debug_context);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, parameters.context_api);
 
     // create window and context
     glfw_window = glfwCreateWindow(parameters.width, parameters.height, parameters.title.c_str(), 0, 0);
@@ -114,7 +117,8 @@ Context::Context() {
 
     glewExperimental = GL_TRUE;
     const GLenum err = glewInit();
-    if (err != GLEW_OK) {
+    // GLX extensions are not available for EGL contexts, core GL entry points are loaded regardless
+    if (err != GLEW_OK && !(err == GLEW_ERROR_NO_GLX_DISPLAY && parameters.context_api == GLFW_EGL_CONTEXT_API)) {
         glfwDestroyWindow(glfw_window);
         glfwTerminate();
         throw std::runtime_error(std::string("GLEWInit failed: ") + (const char*)glewGetErrorString(err));
@@ -183,9 +187,14 @@ Context::Context() {
     gpu_timer->begin();
     prim_count->begin();
     frag_count->begin();
+
+    // setup frame pacing
+    frame_pacer.set_frames_in_flight(parameters.frames_in_flight);
+    frame_pacer.set_mode(parameters.frame_pacing);
 }
 
 Context::~Context() {
+    frame_pacer.wait_idle();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -209,14 +218,28 @@ Context& Context::instance() {
 bool Context::running() { return !glfwWindowShouldClose(instance().glfw_window); }
 
 void Context::swap_buffers() {
-    if (show_gui) gui_draw();
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        TraceScope trace("gui");
+        if (show_gui) gui_draw();
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
     instance().cpu_timer->end();
     instance().gpu_timer->end();
     instance().prim_count->end();
     instance().frag_count->end();
-    glfwSwapBuffers(instance().glfw_window);
+    {
+        TraceScope trace("present");
+        glfwSwapBuffers(instance().glfw_window);
+        instance().frame_pacer.end_frame();
+    }
+    if (TextureLoader::pending()) {
+        TraceScope trace("texture uploads");
+        TextureLoader::update();
+    }
+    if (ShaderImpl::hot_reload)
+        reload_modified_shaders();
+    Tracer::frame();
     instance().frame_timer->end();
     instance().frame_timer->begin();
     instance().cpu_timer->begin();
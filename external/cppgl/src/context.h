@@ -6,6 +6,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include "query.h"
+#include "frame_pacer.h"
 
 CPPGL_NAMESPACE_BEGIN
 
@@ -21,7 +22,10 @@ struct ContextParameters {
     int floating = GLFW_FALSE;
     int maximised = GLFW_FALSE;
     int gl_debug_context = GLFW_TRUE;
+    int context_api = GLFW_NATIVE_CONTEXT_API; // GLFW_EGL_CONTEXT_API for offscreen use (e.g. Mesa llvmpipe)
     uint32_t swap_interval = 1; // 0 = no vsync, 1 = 60fps, 2 = 30fps, etc
+    uint32_t frames_in_flight = 2; // frames the CPU may record ahead of the GPU + 1 (see FramePacer)
+    FramePacing frame_pacing = FramePacing::MAX_THROUGHPUT;
     std::filesystem::path font_ttf_filename;
     uint32_t font_size_pixels = 13; // unused if no font is provided. use font scale instead
     float global_font_scale = 1.f;
@@ -44,7 +48,7 @@ public:
 
     // query if window should be closed (for use in main loop)
     static bool running();
-    // finish current frame
+    // finish current frame (paced by frame_pacer, see ContextParameters::frame_pacing)
     static void swap_buffers();
     // get last frame's time in ms
     static double frame_time();
@@ -79,6 +83,7 @@ public:
     TimerQueryGL gpu_timer;
     PrimitiveQueryGL prim_count;
     FragmentQueryGL frag_count;
+    FramePacer frame_pacer;
 };
 
 CPPGL_NAMESPACE_END
@@ -6,19 +6,29 @@
 #include "buffer.h"
 #include "camera.h"
 #include "context.h"
+#include "culling.h"
 #include "debug.h"
 #include "drawelement.h"
+#include "frame_pacer.h"
+#include "frame_recorder.h"
 #include "framebuffer.h"
 #include "geometry.h"
+#include "geometry_arena.h"
 #include "gui.h"
+#include "hash.h"
 #include "image_load_store.h"
 #include "material.h"
 #include "mesh.h"
+#include "mesh_cache.h"
 #include "named_handle.h"
 #include "quad.h"
 #include "query.h"
 #include "shader.h"
+#include "shared_frames.h"
 #include "texture.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 #ifndef __CUDACC__
 //glm to string with <<operators
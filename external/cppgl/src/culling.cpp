@@ -0,0 +1,187 @@
+#include "culling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------
+// Frustum
+
+Frustum::Frustum(const glm::mat4& m) {
+    // Gribb/Hartmann: rows of the matrix combined, valid for any (off-axis, sheared) projection
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[0] = row3 + row0;    // left
+    planes[1] = row3 - row0;    // right
+    planes[2] = row3 + row1;    // bottom
+    planes[3] = row3 - row1;    // top
+    planes[4] = row3 + row2;    // near
+    planes[5] = row3 - row2;    // far
+}
+
+// -1: outside, 0: intersecting, 1: inside
+static int classify_box(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent) {
+    int result = 1;
+    for (const auto& plane : frustum.planes) {
+        const float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+        const float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (dist < -radius) return -1;
+        if (dist < radius) result = 0;
+    }
+    return result;
+}
+
+// interleave the lower 10 bits of x, y and z
+static uint32_t morton_code(uint32_t x, uint32_t y, uint32_t z) {
+    const auto spread = [](uint32_t v) {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+// -------------------------------------------
+// FrustumCuller
+
+FrustumCuller::FrustumCuller() : dirty(false) {}
+
+void FrustumCuller::clear() {
+    centers.clear();
+    extents.clear();
+    empty.clear();
+    dirty = true;
+}
+
+uint32_t FrustumCuller::add(const glm::vec3& bb_min, const glm::vec3& bb_max, const glm::mat4& model) {
+    // Arvo: the extent of the transformed box is the extent multiplied with the absolute linear part of the transform
+    const glm::vec3 center = (bb_min + bb_max) * .5f;
+    const glm::vec3 extent = (bb_max - bb_min) * .5f;
+    const glm::mat3 linear = glm::mat3(model);
+    const glm::mat3 abs_linear = glm::mat3(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+    centers.push_back(glm::vec3(model * glm::vec4(center, 1)));
+    extents.push_back(abs_linear * extent);
+    empty.push_back(glm::any(glm::greaterThan(bb_min, bb_max)));
+    dirty = true;
+    return uint32_t(centers.size() - 1);
+}
+
+void FrustumCuller::build() {
+    dirty = false;
+    std::vector<uint32_t> order;
+    glm::vec3 scene_min(FLT_MAX), scene_max(-FLT_MAX);
+    for (uint32_t i = 0; i < centers.size(); i++) {
+        if (empty[i]) continue;
+        order.push_back(i);
+        scene_min = glm::min(scene_min, centers[i]);
+        scene_max = glm::max(scene_max, centers[i]);
+    }
+
+    // sort along a Morton curve of the box centers, so neighbouring boxes end up in the same cluster
+    const glm::vec3 scale = 1023.f / glm::max(scene_max - scene_min, glm::vec3(FLT_MIN));
+    std::vector<uint32_t> codes(centers.size());
+    for (const uint32_t i : order) {
+        const glm::uvec3 cell = glm::uvec3(glm::clamp((centers[i] - scene_min) * scale, glm::vec3(0), glm::vec3(1023)));
+        codes[i] = morton_code(cell.x, cell.y, cell.z);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+
+    // padding lanes are never reported, their values only need to be finite
+    const size_t padded = (order.size() + 7) / 8 * 8;
+    for (auto* array : { &cx, &cy, &cz, &ex, &ey, &ez })
+        array->assign(padded, 0.f);
+    ids.assign(padded, UINT32_MAX);
+    cluster_centers.clear();
+    cluster_extents.clear();
+    cluster_sizes.clear();
+    for (size_t base = 0; base < order.size(); base += 8) {
+        glm::vec3 cluster_min(FLT_MAX), cluster_max(-FLT_MAX);
+        const size_t end = std::min(base + 8, order.size());
+        for (size_t j = base; j < end; j++) {
+            const glm::vec3& c = centers[order[j]];
+            const glm::vec3& e = extents[order[j]];
+            cx[j] = c.x; cy[j] = c.y; cz[j] = c.z;
+            ex[j] = e.x; ey[j] = e.y; ez[j] = e.z;
+            ids[j] = order[j];
+            cluster_min = glm::min(cluster_min, c - e);
+            cluster_max = glm::max(cluster_max, c + e);
+        }
+        cluster_centers.push_back((cluster_min + cluster_max) * .5f);
+        cluster_extents.push_back((cluster_max - cluster_min) * .5f);
+        cluster_sizes.push_back(uint32_t(end - base));
+    }
+}
+
+void FrustumCuller::cull(const std::vector<glm::mat4>& view_proj, std::vector<std::vector<uint32_t>>& visible) {
+    const auto start = std::chrono::steady_clock::now();
+    if (dirty) build();
+
+    stats = CullingStats();
+    stats.views = uint32_t(view_proj.size());
+    visible.resize(view_proj.size());
+    std::vector<bool> seen(centers.size(), false);
+    for (size_t i = 0; i < view_proj.size(); i++) {
+        visible[i].clear();
+        cull_frustum(Frustum(view_proj[i]), visible[i]);
+        stats.visible += visible[i].size();
+        for (const uint32_t id : visible[i])
+            seen[id] = true;
+    }
+    stats.objects = uint32_t(centers.size());
+    stats.culled = uint32_t(std::count(seen.begin(), seen.end(), false));
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrustumCuller::cull_frustum(const Frustum& frustum, std::vector<uint32_t>& visible) {
+    for (size_t cluster = 0; cluster < cluster_sizes.size(); cluster++) {
+        const size_t base = cluster * 8;
+        stats.cluster_tests++;
+        const int cluster_class = classify_box(frustum, cluster_centers[cluster], cluster_extents[cluster]);
+        if (cluster_class < 0) continue;
+        if (cluster_class > 0) {
+            visible.insert(visible.end(), ids.begin() + base, ids.begin() + base + cluster_sizes[cluster]);
+            continue;
+        }
+
+        // a box is outside if it is entirely behind any plane
+        stats.box_tests += cluster_sizes[cluster];
+        uint32_t inside_mask = (1u << cluster_sizes[cluster]) - 1;
+#if defined(__AVX__)
+        const __m256 c_x = _mm256_loadu_ps(&cx[base]), c_y = _mm256_loadu_ps(&cy[base]), c_z = _mm256_loadu_ps(&cz[base]);
+        const __m256 e_x = _mm256_loadu_ps(&ex[base]), e_y = _mm256_loadu_ps(&ey[base]), e_z = _mm256_loadu_ps(&ez[base]);
+        __m256 outside = _mm256_setzero_ps();
+        for (const auto& plane : frustum.planes) {
+            const glm::vec4 abs_plane = glm::abs(plane);
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), c_x), _mm256_set1_ps(plane.w));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(plane.y), c_y));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(plane.z), c_z));
+            __m256 radius = _mm256_mul_ps(_mm256_set1_ps(abs_plane.x), e_x);
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(abs_plane.y), e_y));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(abs_plane.z), e_z));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        inside_mask &= ~uint32_t(_mm256_movemask_ps(outside));
+#else
+        for (uint32_t lane = 0; lane < cluster_sizes[cluster]; lane++) {
+            const glm::vec3 center(cx[base + lane], cy[base + lane], cz[base + lane]);
+            const glm::vec3 extent(ex[base + lane], ey[base + lane], ez[base + lane]);
+            if (classify_box(frustum, center, extent) < 0)
+                inside_mask &= ~(1u << lane);
+        }
+#endif
+        for (uint32_t lane = 0; lane < 8; lane++)
+            if (inside_mask & (1u << lane))
+                visible.push_back(ids[base + lane]);
+    }
+}
+
+CPPGL_NAMESPACE_END
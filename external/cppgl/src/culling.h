@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "platform.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// ------------------------------------------
+// Frustum culling
+// World space AABBs of many objects are tested against many frusta at once. The boxes are sorted along a Morton curve
+// into clusters of 8 with bounds of their own (a two level BVH): clusters entirely inside or outside a frustum skip the
+// per box tests, the boxes of the remaining clusters are tested 8 at a time (AVX if available, scalar otherwise).
+
+// planes (a, b, c, d) of the view volume of a view-projection matrix, a*x + b*y + c*z + d >= 0 inside
+struct Frustum {
+    Frustum(const glm::mat4& view_proj);
+    glm::vec4 planes[6];
+};
+
+struct CullingStats {
+    uint32_t objects = 0;           // boxes tested against each frustum
+    uint32_t views = 0;             // frusta
+    uint32_t culled = 0;            // objects outside of all frusta
+    uint64_t visible = 0;           // visible object-frustum pairs
+    uint64_t cluster_tests = 0;     // cluster-frustum tests
+    uint64_t box_tests = 0;         // box-frustum tests
+    double ms = 0;                  // CPU time of the last cull()
+};
+
+class FrustumCuller {
+public:
+    FrustumCuller();
+
+    // remove all boxes
+    void clear();
+    // add an object space box transformed by model, returns the object index used in the visible lists
+    // boxes with bb_min > bb_max are empty and never visible
+    uint32_t add(const glm::vec3& bb_min, const glm::vec3& bb_max, const glm::mat4& model = glm::mat4(1));
+    inline size_t size() const { return centers.size(); }
+
+    // per frustum, the indices of all objects intersecting it (in cluster order)
+    void cull(const std::vector<glm::mat4>& view_proj, std::vector<std::vector<uint32_t>>& visible);
+
+    // data
+    CullingStats stats;
+
+private:
+    // sort the boxes into clusters (on the first cull() after changes)
+    void build();
+    void cull_frustum(const Frustum& frustum, std::vector<uint32_t>& visible);
+
+    // world space boxes in insertion order
+    std::vector<glm::vec3> centers, extents;
+    std::vector<bool> empty;
+    bool dirty;
+    // sorted boxes in structure of arrays layout, padded to a multiple of 8
+    std::vector<float> cx, cy, cz, ex, ey, ez;
+    std::vector<uint32_t> ids;
+    // bounds and box count of each cluster of 8
+    std::vector<glm::vec3> cluster_centers, cluster_extents;
+    std::vector<uint32_t> cluster_sizes;
+};
+
+CPPGL_NAMESPACE_END
@@ -5,7 +5,7 @@
 CPPGL_NAMESPACE_BEGIN
 
 DrawelementImpl::DrawelementImpl(const std::string& name, const Shader& shader, const Mesh& mesh)
-    : name(name), model(glm::mat4(1)), shader(shader), mesh(mesh) {}
+    : name(name), model(glm::mat4(1)), shader(shader), mesh(mesh), normal_source(glm::mat4(1)), normal_matrix(glm::mat4(1)) {}
 
 DrawelementImpl::~DrawelementImpl() {}
 
@@ -14,13 +14,21 @@ void DrawelementImpl::bind() const {
         shader->bind();
         if (mesh) mesh->bind(shader);
         shader->uniform("model", model);
-        shader->uniform("model_normal", glm::transpose(glm::inverse(model)));
+        shader->uniform("model_normal", model_normal());
         shader->uniform("view", current_camera()->view);
         shader->uniform("view_normal", current_camera()->view_normal);
         shader->uniform("proj", current_camera()->proj);
     }
 }
 
+const glm::mat4& DrawelementImpl::model_normal() const {
+    if (model != normal_source) {
+        normal_matrix = glm::transpose(glm::inverse(model));
+        normal_source = model;
+    }
+    return normal_matrix;
+}
+
 void DrawelementImpl::unbind() const {
     if (mesh) mesh->unbind();
     if (shader) shader->unbind();
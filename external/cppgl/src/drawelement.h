@@ -18,11 +18,18 @@ public:
     void draw() const;
     void unbind() const;
 
+    // transpose(inverse(model)), only recomputed after model changed
+    const glm::mat4& model_normal() const;
+
     // data
     const std::string name;
     glm::mat4 model;
     Shader shader;
     Mesh mesh;
+
+private:
+    mutable glm::mat4 normal_source;    // model matrix normal_matrix was computed from
+    mutable glm::mat4 normal_matrix;
 };
 
 using Drawelement = NamedHandle<DrawelementImpl>;
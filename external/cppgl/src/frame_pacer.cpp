@@ -0,0 +1,58 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+CPPGL_NAMESPACE_BEGIN
+
+FramePacer::FramePacer(uint32_t frames_in_flight, FramePacing mode) : fences(std::max(1u, frames_in_flight), nullptr), mode(mode), frame_count(0), wait_ms(0) {}
+
+FramePacer::~FramePacer() {
+    // the GL context may already be gone, so only release fences that were left (see wait_idle)
+    for (auto& fence : fences)
+        if (fence) glDeleteSync(fence);
+}
+
+void FramePacer::end_frame() {
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t current = slot();
+    if (fences[current]) glDeleteSync(fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame_count++;
+    // low latency: the frame just submitted has to finish before the next one starts
+    // max throughput: only the frame that last used the next slot has to finish
+    wait(mode == FramePacing::LOW_LATENCY ? current : slot());
+    wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FramePacer::wait_idle() {
+    // fences signal in order, so waiting for the newest one suffices
+    const uint32_t newest = uint32_t((frame_count + fences.size() - 1) % fences.size());
+    wait(newest);
+    for (auto& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void FramePacer::set_frames_in_flight(uint32_t frames_in_flight) {
+    wait_idle();
+    fences.assign(std::max(1u, frames_in_flight), nullptr);
+}
+
+void FramePacer::wait(uint32_t slot) {
+    if (!fences[slot]) return;
+    // flush once, then keep waiting in chunks of one second
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        const GLenum result = glClientWaitSync(fences[slot], flags, 1000000000);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) break;
+        if (result == GL_WAIT_FAILED)
+            throw std::runtime_error("FramePacer: glClientWaitSync failed!");
+        flags = 0;
+    }
+    glDeleteSync(fences[slot]);
+    fences[slot] = nullptr;
+}
+
+CPPGL_NAMESPACE_END
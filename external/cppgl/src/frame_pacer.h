@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include "platform.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// Frame pacing with fence syncs
+
+enum class FramePacing {
+    LOW_LATENCY,    // wait for the GPU after every frame, input for the next frame is polled once the frame is done
+    MAX_THROUGHPUT  // the CPU may record up to frames_in_flight - 1 frames ahead of the GPU
+};
+
+class FramePacer {
+public:
+    FramePacer(uint32_t frames_in_flight = 2, FramePacing mode = FramePacing::MAX_THROUGHPUT);
+    virtual ~FramePacer();
+
+    // prevent copies and moves, since GL sync objects aren't reference counted
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // fence all commands of the current frame (call after swapping buffers) and wait until the GPU is close enough
+    void end_frame();
+    // wait for all fenced frames
+    void wait_idle();
+
+    // modify (changing the number of frames in flight waits for the GPU)
+    void set_frames_in_flight(uint32_t frames_in_flight);
+    void set_mode(FramePacing mode) { this->mode = mode; }
+
+    // access
+    uint32_t frames_in_flight() const { return uint32_t(fences.size()); }
+    FramePacing get_mode() const { return mode; }
+    // number of ended frames
+    uint64_t frame() const { return frame_count; }
+    // ring index of the current frame for per-frame resources (e.g. uniform buffer ranges),
+    // the GPU has finished all commands issued the last time this slot was current
+    uint32_t slot() const { return uint32_t(frame_count % fences.size()); }
+    // time the CPU waited for the GPU in the last end_frame() in ms
+    double wait_time() const { return wait_ms; }
+
+private:
+    // wait for and release the fence of the given slot
+    void wait(uint32_t slot);
+
+    // data
+    std::vector<GLsync> fences;
+    FramePacing mode;
+    uint64_t frame_count;
+    double wait_ms;
+};
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,169 @@
+#include "frame_recorder.h"
+#include "image_load_store.h"
+#include "query.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+CPPGL_NAMESPACE_BEGIN
+
+static RecordingFormat recording_format(const std::filesystem::path& path) {
+    const std::string ext = path.extension().string();
+    if (ext.empty()) return RecordingFormat::PNG;
+    if (ext == ".y4m") return RecordingFormat::Y4M;
+    if (ext == ".raw" || ext == ".rgba") return RecordingFormat::RAW;
+    throw std::runtime_error("FrameRecorder: unsupported format: " + ext + " (expected .y4m, .raw, .rgba or a directory)");
+}
+
+FrameRecorder::FrameRecorder(const std::filesystem::path& path, uint32_t w, uint32_t h, uint32_t fps, uint32_t delay, uint32_t buffers, size_t writers)
+    : path(path), format(recording_format(path)), w(w), h(h), fps(fps), frames_captured(0), stall_ms(0),
+    pbos(delay + 1), staging(std::max(1u, buffers)), frames_retired(0), stream_next(0), writers(std::max(size_t(1), writers)) {
+    // all memory is allocated upfront, recording does not allocate per frame
+    const size_t size = size_t(w) * h * 4;
+    glGenBuffers(GLsizei(pbos.size()), pbos.data());
+    for (const GLuint pbo : pbos) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, 0, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    for (auto& frame : staging) {
+        frame.pixels.resize(size);
+        if (format != RecordingFormat::RAW)
+            frame.planes.resize(size_t(w) * h * 3);
+    }
+
+    if (format == RecordingFormat::PNG) {
+        std::filesystem::create_directories(path);
+        return;
+    }
+    stream.open(path, std::ios::binary);
+    if (!stream)
+        throw std::runtime_error("FrameRecorder: unable to write " + path.string());
+    if (format == RecordingFormat::Y4M)
+        stream << "YUV4MPEG2 W" << w << " H" << h << " F" << fps << ":1 Ip A1:1 C444\n";
+}
+
+FrameRecorder::~FrameRecorder() {
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    glDeleteBuffers(GLsizei(pbos.size()), pbos.data());
+}
+
+void FrameRecorder::capture() {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, next_pbo());
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frames_captured++;
+}
+
+void FrameRecorder::capture(const Texture2D& texture) {
+    if (uint32_t(texture->w) != w || uint32_t(texture->h) != h)
+        throw std::runtime_error("FrameRecorder: texture " + texture->name + " does not match the recording resolution");
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, next_pbo());
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frames_captured++;
+}
+
+void FrameRecorder::flush() {
+    while (frames_retired < frames_captured)
+        retire(frames_retired);
+    for (auto& frame : staging)
+        if (frame.written.valid()) frame.written.get();
+    if (stream.is_open()) stream.flush();
+}
+
+GLuint FrameRecorder::next_pbo() {
+    // the slot still holds the readback issued delay frames ago
+    if (frames_captured - frames_retired == pbos.size())
+        retire(frames_retired);
+    return pbos[frames_captured % pbos.size()];
+}
+
+void FrameRecorder::retire(uint64_t frame) {
+    // backpressure: wait for the writer of the frame that last used this staging buffer
+    Staging& target = staging[frame % staging.size()];
+    if (target.written.valid()) {
+        Timer timer;
+        target.written.get();
+        stall_ms += timer.look();
+    }
+
+    const size_t row = size_t(w) * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[frame % pbos.size()]);
+    const uint8_t* mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row * h, GL_MAP_READ_BIT);
+    if (mapped) {
+        // GL rows start at the bottom, all output formats start at the top
+        for (uint32_t y = 0; y < h; y++)
+            std::memcpy(target.pixels.data() + (h - 1 - y) * row, mapped + y * row, row);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frames_retired++;
+
+    // queued even if mapping failed, later frames of a stream wait for this one
+    target.written = writers.enqueue([this, &target, frame]() { write(target, frame); });
+    if (!mapped)
+        throw std::runtime_error("FrameRecorder: unable to map pixel pack buffer");
+}
+
+void FrameRecorder::write(Staging& buffer, uint64_t frame) {
+    const size_t pixels = size_t(w) * h;
+    const uint8_t* rgba = buffer.pixels.data();
+
+    if (format == RecordingFormat::PNG) {
+        // drop alpha, the default framebuffer's alpha is not meant to be displayed
+        for (size_t i = 0; i < pixels; i++)
+            std::memcpy(&buffer.planes[i * 3], &rgba[i * 4], 3);
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.png", (unsigned long long)frame);
+        image_store_ldr(path / name, buffer.planes.data(), w, h, 3, false);
+        return;
+    }
+
+    const uint8_t* data = rgba;
+    size_t size = pixels * 4;
+    if (format == RecordingFormat::Y4M) {
+        uint8_t* Y = buffer.planes.data();
+        uint8_t* U = Y + pixels;
+        uint8_t* V = U + pixels;
+        for (size_t i = 0; i < pixels; i++) {
+            const int r = rgba[i * 4 + 0], g = rgba[i * 4 + 1], b = rgba[i * 4 + 2];
+            // BT.601 studio range, chroma offset before the shift to stay non-negative
+            Y[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            U[i] = uint8_t((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+            V[i] = uint8_t((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+        }
+        data = buffer.planes.data();
+        size = pixels * 3;
+    }
+
+    // converted in parallel, appended in frame order
+    std::unique_lock<std::mutex> lock(stream_mutex);
+    stream_cv.wait(lock, [&]() { return stream_next == frame; });
+    if (format == RecordingFormat::Y4M)
+        stream << "FRAME\n";
+    stream.write((const char*)data, size);
+    const bool ok = bool(stream);
+    stream_next++;
+    lock.unlock();
+    stream_cv.notify_all();
+    if (!ok)
+        throw std::runtime_error("FrameRecorder: unable to write " + path.string());
+}
+
+CPPGL_NAMESPACE_END
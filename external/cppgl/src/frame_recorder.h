@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include "texture.h"
+#include "thread_pool.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// Asynchronous frame capture into a ring of pixel pack buffers, written by a bounded pool of writer threads
+
+enum class RecordingFormat {
+    RAW,    // RGBA8 frames appended to a single file (.raw, .rgba)
+    Y4M,    // YUV 4:4:4 stream with BT.601 studio range (.y4m)
+    PNG     // numbered images frame_000000.png, ... in a directory
+};
+
+class FrameRecorder {
+public:
+    // record w x h frames to path, the format is derived from the extension (a path without one is a PNG directory)
+    // delay: frames a readback may take on the GPU before it is mapped
+    // buffers: frames held for the writers, capture() waits for a writer once all are in use
+    FrameRecorder(const std::filesystem::path& path, uint32_t w, uint32_t h, uint32_t fps = 60, uint32_t delay = 2, uint32_t buffers = 4, size_t writers = 2);
+    // writes all pending frames
+    virtual ~FrameRecorder();
+
+    // prevent copies and moves, since GL buffers aren't reference counted
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    // start the readback of the lower left w x h pixels of the bound read framebuffer
+    void capture();
+    // start the readback of level 0 of the texture (must be w x h, converted to RGBA8)
+    void capture(const Texture2D& texture);
+    // hand all started readbacks to the writers and wait until they are written
+    void flush();
+
+    // data
+    const std::filesystem::path path;
+    const RecordingFormat format;
+    const uint32_t w, h, fps;
+    uint64_t frames_captured;   // readbacks started
+    double stall_ms;            // total time capture() waited for writers
+
+private:
+    struct Staging {
+        std::vector<uint8_t> pixels;    // RGBA8, top row first
+        std::vector<uint8_t> planes;    // Y, U and V planes (Y4M) or RGB8 (PNG)
+        std::future<void> written;
+    };
+
+    // reserve the next ring slot, retiring the readback it holds
+    GLuint next_pbo();
+    // map the readback of the given frame, copy it to a staging buffer and queue it for writing
+    void retire(uint64_t frame);
+    void write(Staging& buffer, uint64_t frame);
+
+    std::vector<GLuint> pbos;
+    std::vector<Staging> staging;
+    uint64_t frames_retired;
+    std::ofstream stream;
+    // sequential streams are written in frame order
+    std::mutex stream_mutex;
+    std::condition_variable stream_cv;
+    uint64_t stream_next;
+    ThreadPool writers;
+};
+
+CPPGL_NAMESPACE_END
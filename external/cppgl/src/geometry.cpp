@@ -1,10 +1,350 @@
 #include <geometry.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 CPPGL_NAMESPACE_BEGIN
 
-GeometryImpl::GeometryImpl(const std::string& name) : name(name), bb_min(FLT_MAX), bb_max(FLT_MIN) {}
+// ------------------------------------------
+// vertex transform helpers
+
+// vertices per task of transform_vertices(), a multiple of the SIMD width
+static const size_t transform_grain = 16384;
+
+// affine transform of vec3s: rows of the 3x4 matrix, the translation is only added to points
+struct VertexTransform {
+    float m[12];
+    bool point;
+    bool normalize;
+    VertexTransform(const glm::mat4& model, bool point, bool normalize) : point(point), normalize(normalize) {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                m[r * 4 + c] = model[c][r];
+    }
+};
+
+#if defined(__AVX__)
+// 8 vec3 (24 floats) to 8 x, y and z
+static inline void load_soa(const float* p, __m256& x, __m256& y, __m256& z) {
+    __m256 m03 = _mm256_castps128_ps256(_mm_loadu_ps(p + 0));
+    __m256 m14 = _mm256_castps128_ps256(_mm_loadu_ps(p + 4));
+    __m256 m25 = _mm256_castps128_ps256(_mm_loadu_ps(p + 8));
+    m03 = _mm256_insertf128_ps(m03, _mm_loadu_ps(p + 12), 1);
+    m14 = _mm256_insertf128_ps(m14, _mm_loadu_ps(p + 16), 1);
+    m25 = _mm256_insertf128_ps(m25, _mm_loadu_ps(p + 20), 1);
+    const __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    const __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// inverse of load_soa
+static inline void store_soa(float* p, const __m256& x, const __m256& y, const __m256& z) {
+    const __m256 rxy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m256 ryz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+    const __m256 rzx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+    const __m256 r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m256 r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+    const __m256 r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(p + 0, _mm256_castps256_ps128(r03));
+    _mm_storeu_ps(p + 4, _mm256_castps256_ps128(r14));
+    _mm_storeu_ps(p + 8, _mm256_castps256_ps128(r25));
+    _mm_storeu_ps(p + 12, _mm256_extractf128_ps(r03, 1));
+    _mm_storeu_ps(p + 16, _mm256_extractf128_ps(r14, 1));
+    _mm_storeu_ps(p + 20, _mm256_extractf128_ps(r25, 1));
+}
+
+// transform 8 vec3 in place (if t is given) and extend the bounds, no FMA so every lane rounds the same way
+static inline void transform_block(float* p, const VertexTransform* t, __m256 bounds[6]) {
+    __m256 x, y, z;
+    load_soa(p, x, y, z);
+    if (t) {
+        __m256 r[3];
+        for (int i = 0; i < 3; i++) {
+            r[i] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t->m[i * 4 + 0]), x),
+                        _mm256_mul_ps(_mm256_set1_ps(t->m[i * 4 + 1]), y)), _mm256_mul_ps(_mm256_set1_ps(t->m[i * 4 + 2]), z));
+            if (t->point) r[i] = _mm256_add_ps(r[i], _mm256_set1_ps(t->m[i * 4 + 3]));
+        }
+        if (t->normalize) {
+            const __m256 length_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], r[0]), _mm256_mul_ps(r[1], r[1])), _mm256_mul_ps(r[2], r[2]));
+            const __m256 inv_length = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(length_sq));
+            for (int i = 0; i < 3; i++)
+                r[i] = _mm256_mul_ps(r[i], inv_length);
+        }
+        x = r[0]; y = r[1]; z = r[2];
+        store_soa(p, x, y, z);
+    }
+    if (bounds) {
+        bounds[0] = _mm256_min_ps(bounds[0], x); bounds[1] = _mm256_min_ps(bounds[1], y); bounds[2] = _mm256_min_ps(bounds[2], z);
+        bounds[3] = _mm256_max_ps(bounds[3], x); bounds[4] = _mm256_max_ps(bounds[4], y); bounds[5] = _mm256_max_ps(bounds[5], z);
+    }
+}
+#endif
+
+// transform count vec3 in place (if t is given) and extend bb_min/bb_max by the results (if given)
+static void transform_range(glm::vec3* data, size_t count, const VertexTransform* t, glm::vec3* bb_min, glm::vec3* bb_max) {
+#if defined(__AVX__)
+    __m256 bounds[6];
+    for (int i = 0; i < 3; i++) {
+        bounds[i] = _mm256_set1_ps(FLT_MAX);
+        bounds[i + 3] = _mm256_set1_ps(-FLT_MAX);
+    }
+    __m256* block_bounds = bb_min ? bounds : nullptr;
+    const size_t blocks = count / 8;
+    for (size_t b = 0; b < blocks; b++)
+        transform_block(&data[b * 8].x, t, block_bounds);
+    // the remainder goes through the same block code, padded with copies of its last vector (neutral for the bounds)
+    const size_t rest = count - blocks * 8;
+    if (rest) {
+        glm::vec3 tail[8];
+        for (size_t i = 0; i < 8; i++)
+            tail[i] = data[blocks * 8 + std::min(i, rest - 1)];
+        transform_block(&tail[0].x, t, block_bounds);
+        std::copy(tail, tail + rest, data + blocks * 8);
+    }
+    if (bb_min) {
+        float lanes[8];
+        for (int i = 0; i < 3; i++) {
+            _mm256_storeu_ps(lanes, bounds[i]);
+            (*bb_min)[i] = std::min((*bb_min)[i], *std::min_element(lanes, lanes + 8));
+            _mm256_storeu_ps(lanes, bounds[i + 3]);
+            (*bb_max)[i] = std::max((*bb_max)[i], *std::max_element(lanes, lanes + 8));
+        }
+    }
+#else
+    // locals, the compiler can not tell that data does not alias the transform or the bounds
+    if (t) {
+        const glm::mat3 linear(t->m[0], t->m[4], t->m[8], t->m[1], t->m[5], t->m[9], t->m[2], t->m[6], t->m[10]);
+        const glm::vec3 translation = t->point ? glm::vec3(t->m[3], t->m[7], t->m[11]) : glm::vec3(0);
+        const bool normalize = t->normalize;
+        for (size_t v = 0; v < count; v++) {
+            glm::vec3 r = linear * data[v] + translation;
+            if (normalize)
+                r *= 1.f / std::sqrt(r.x * r.x + r.y * r.y + r.z * r.z);
+            data[v] = r;
+        }
+    }
+    if (bb_min) {
+        glm::vec3 range_min = *bb_min, range_max = *bb_max;
+        for (size_t v = 0; v < count; v++) {
+            range_min = glm::min(range_min, data[v]);
+            range_max = glm::max(range_max, data[v]);
+        }
+        *bb_min = range_min;
+        *bb_max = range_max;
+    }
+#endif
+}
+
+// transform the positions (and normals) of all geometries by model and recompute their AABBs, only the AABBs without model
+// the vertices of all geometries are split into ranges that run on the pool, every vertex is computed the same way
+// regardless of its range, so the results do not depend on the pool
+static void transform_vertices(const std::vector<GeometryImpl*>& geometries, const glm::mat4* model, ThreadPool* pool) {
+    struct Range {
+        GeometryImpl* geometry;
+        size_t begin, end;
+        glm::vec3 bb_min, bb_max;
+    };
+    std::vector<Range> ranges;
+    for (GeometryImpl* geometry : geometries)
+        for (size_t begin = 0; begin < geometry->positions.size(); begin += transform_grain)
+            ranges.push_back({ geometry, begin, std::min(geometry->positions.size(), begin + transform_grain), glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) });
+
+    // normals keep their length if the linear part is the identity (translations)
+    const glm::mat3 linear = model ? glm::mat3(*model) : glm::mat3(1);
+    const bool transform_normals = linear != glm::mat3(1);
+    const VertexTransform position_transform(model ? *model : glm::mat4(1), true, false);
+    const VertexTransform normal_transform(glm::mat4(glm::transpose(glm::inverse(linear))), false, true);
+    const auto work = [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; r++) {
+            Range& range = ranges[r];
+            std::vector<glm::vec3>& positions = range.geometry->positions;
+            transform_range(&positions[range.begin], range.end - range.begin, model ? &position_transform : nullptr, &range.bb_min, &range.bb_max);
+            std::vector<glm::vec3>& normals = range.geometry->normals;
+            if (transform_normals && range.begin < normals.size())
+                transform_range(&normals[range.begin], std::min(range.end, normals.size()) - range.begin, &normal_transform, nullptr, nullptr);
+        }
+    };
+    if (pool && ranges.size() > 1)
+        pool->parallel_for(ranges.size(), work);
+    else
+        work(0, ranges.size());
+
+    for (GeometryImpl* geometry : geometries) {
+        geometry->bb_min = glm::vec3(FLT_MAX);
+        geometry->bb_max = glm::vec3(-FLT_MAX);
+    }
+    for (const Range& range : ranges) {
+        range.geometry->bb_min = glm::min(range.geometry->bb_min, range.bb_min);
+        range.geometry->bb_max = glm::max(range.geometry->bb_max, range.bb_max);
+    }
+}
+
+void transform_geometries(const std::vector<Geometry>& geometries, const glm::mat4& model, ThreadPool* pool) {
+    std::vector<GeometryImpl*> impls;
+    for (const Geometry& geometry : geometries)
+        impls.push_back(geometry.ptr.get());
+    transform_vertices(impls, &model, pool);
+}
+
+// ------------------------------------------
+// mesh optimization helpers
+
+// vertices transformed by a FIFO post-transform cache of cache_size vertices
+static uint32_t simulate_fifo_cache(const std::vector<uint32_t>& indices, size_t num_vertices, uint32_t cache_size = 16) {
+    std::vector<uint32_t> inserted(num_vertices, 0);    // miss count after the vertex entered the cache, 0: never
+    uint32_t misses = 0;
+    for (const uint32_t index : indices) {
+        if (inserted[index] && misses - inserted[index] < cache_size) continue;
+        inserted[index] = ++misses;
+    }
+    return misses;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation": vertices score by their position in a simulated LRU cache and their
+// number of remaining triangles, the triangle with the highest score among those of cached vertices is emitted next
+static const int forsyth_cache_size = 32;
+
+static float forsyth_score(int cache_position, uint32_t remaining) {
+    if (remaining == 0) return -1.f;
+    float score = 0.f;
+    if (cache_position >= 0)
+        score = cache_position < 3 ? 0.75f : std::pow(1.f - float(cache_position - 3) / float(forsyth_cache_size - 3), 1.5f);
+    return score + 2.f * std::pow(float(remaining), -0.5f);
+}
+
+static std::vector<uint32_t> optimize_vertex_cache(const std::vector<uint32_t>& indices, size_t num_vertices) {
+    const size_t num_triangles = indices.size() / 3;
+    // triangles of each vertex, the first remaining[v] entries are not emitted yet
+    std::vector<uint32_t> offsets(num_vertices + 1, 0), remaining(num_vertices, 0);
+    for (const uint32_t index : indices)
+        remaining[index]++;
+    for (size_t v = 0; v < num_vertices; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size()), cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[cursor[indices[i]]++] = uint32_t(i / 3);
+
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; v++)
+        vertex_score[v] = forsyth_score(-1, remaining[v]);
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<bool> emitted(num_triangles, false);
+    uint32_t best = 0;
+    for (size_t t = 0; t < num_triangles; t++) {
+        triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+        if (triangle_score[t] > triangle_score[best]) best = uint32_t(t);
+    }
+
+    std::vector<uint32_t> result, cache, next_cache;
+    result.reserve(indices.size());
+    size_t next_unemitted = 0;
+    while (result.size() < indices.size()) {
+        // no cached vertex has triangles left: continue with the next triangle in input order
+        if (best == UINT32_MAX) {
+            while (emitted[next_unemitted]) next_unemitted++;
+            best = uint32_t(next_unemitted);
+        }
+        emitted[best] = true;
+        const uint32_t* triangle = &indices[3 * best];
+        for (int k = 0; k < 3; k++) {
+            const uint32_t v = triangle[k];
+            result.push_back(v);
+            uint32_t* begin = &adjacency[offsets[v]];
+            std::swap(*std::find(begin, begin + remaining[v], best), begin[remaining[v] - 1]);
+            remaining[v]--;
+        }
+
+        // move the vertices of the triangle to the front of the cache
+        next_cache.assign(triangle, triangle + 3);
+        for (const uint32_t v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next_cache.push_back(v);
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            const uint32_t v = next_cache[i];
+            cache_position[v] = i < size_t(forsyth_cache_size) ? int(i) : -1;
+            vertex_score[v] = forsyth_score(cache_position[v], remaining[v]);
+        }
+        next_cache.resize(std::min(next_cache.size(), size_t(forsyth_cache_size)));
+        std::swap(cache, next_cache);
+
+        // rescore the triangles of the cached vertices and pick the best
+        best = UINT32_MAX;
+        float best_score = -1.f;
+        for (const uint32_t v : cache) {
+            for (uint32_t i = 0; i < remaining[v]; i++) {
+                const uint32_t t = adjacency[offsets[v] + i];
+                triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (simplified): the cache optimized
+// triangles are split into clusters where the cache runs cold, clusters facing away from the center are drawn first
+static void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, uint32_t cache_size = 16) {
+    std::vector<uint32_t> cluster_starts;
+    std::vector<uint32_t> inserted(positions.size(), 0);
+    uint32_t misses = 0;
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        int triangle_misses = 0;
+        for (int k = 0; k < 3; k++) {
+            const uint32_t index = indices[3 * t + k];
+            if (inserted[index] && misses - inserted[index] < cache_size) continue;
+            inserted[index] = ++misses;
+            triangle_misses++;
+        }
+        if (t == 0 || triangle_misses == 3) cluster_starts.push_back(uint32_t(t));
+    }
+    if (cluster_starts.size() < 2) return;
+    cluster_starts.push_back(uint32_t(indices.size() / 3));
+
+    glm::vec3 center(0);
+    for (const auto& position : positions)
+        center += position / float(positions.size());
+    std::vector<std::pair<float, uint32_t>> order;     // (facing, cluster)
+    for (uint32_t c = 0; c + 1 < cluster_starts.size(); c++) {
+        glm::vec3 centroid(0), normal(0);
+        float area = 0.f;
+        for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+            const glm::vec3& a = positions[indices[3 * t]];
+            const glm::vec3& b = positions[indices[3 * t + 1]];
+            const glm::vec3& d = positions[indices[3 * t + 2]];
+            const glm::vec3 cross = glm::cross(b - a, d - a);   // length: twice the area
+            const float triangle_area = glm::length(cross);
+            centroid += (a + b + d) / 3.f * triangle_area;
+            normal += cross;
+            area += triangle_area;
+        }
+        const float normal_length = glm::length(normal);
+        const float facing = area > 0.f && normal_length > 0.f ? glm::dot(centroid / area - center, normal / normal_length) : 0.f;
+        order.emplace_back(-facing, c);
+    }
+    std::stable_sort(order.begin(), order.end());
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto& [facing, c] : order)
+        result.insert(result.end(), indices.begin() + 3 * cluster_starts[c], indices.begin() + 3 * cluster_starts[c + 1]);
+    indices.swap(result);
+}
+
+// ------------------------------------------
+// GeometryImpl
+
+GeometryImpl::GeometryImpl(const std::string& name) : name(name), bb_min(FLT_MAX), bb_max(-FLT_MAX) {}
 
 GeometryImpl::GeometryImpl(const std::string& name, const aiMesh* mesh_ai) : GeometryImpl(name) {
     add(mesh_ai);
@@ -20,20 +360,22 @@ GeometryImpl::~GeometryImpl() {}
 void GeometryImpl::add(const aiMesh* mesh_ai) {
     // conversion helper
     const auto to_glm = [](const aiVector3D& v) { return glm::vec3(v.x, v.y, v.z); };
-    // extract vertices, normals and texture coords
-    positions.reserve(positions.size() + mesh_ai->mNumVertices);
-    normals.reserve(normals.size() + mesh_ai->HasNormals() ? mesh_ai->mNumVertices : 0);
-    texcoords.reserve(texcoords.size() + mesh_ai->HasTextureCoords(0) ? mesh_ai->mNumVertices : 0);
-    for (uint32_t i = 0; i < mesh_ai->mNumVertices; ++i) {
-        positions.emplace_back(to_glm(mesh_ai->mVertices[i]));
-        if (mesh_ai->HasNormals())
-            normals.emplace_back(to_glm(mesh_ai->mNormals[i]));
-        if (mesh_ai->HasTextureCoords(0))
+    // extract vertices and normals (same layout as glm::vec3 in single precision builds of assimp) and texture coords
+    static_assert(sizeof(aiVector3D) == sizeof(glm::vec3), "aiVector3D does not match glm::vec3");
+    const size_t offset = positions.size();
+    positions.resize(offset + mesh_ai->mNumVertices);
+    std::memcpy(&positions[offset], mesh_ai->mVertices, mesh_ai->mNumVertices * sizeof(glm::vec3));
+    if (mesh_ai->HasNormals()) {
+        normals.resize(offset + mesh_ai->mNumVertices);
+        std::memcpy(&normals[offset], mesh_ai->mNormals, mesh_ai->mNumVertices * sizeof(glm::vec3));
+    }
+    if (mesh_ai->HasTextureCoords(0)) {
+        texcoords.reserve(offset + mesh_ai->mNumVertices);
+        for (uint32_t i = 0; i < mesh_ai->mNumVertices; ++i)
             texcoords.emplace_back(glm::vec2(to_glm(mesh_ai->mTextureCoords[0][i])));
-        // update AABB
-        bb_min = glm::min(bb_min, to_glm(mesh_ai->mVertices[i]));
-        bb_max = glm::max(bb_max, to_glm(mesh_ai->mVertices[i]));
     }
+    // update AABB
+    transform_range(positions.data() + offset, positions.size() - offset, nullptr, &bb_min, &bb_max);
     // extract faces
     indices.reserve(indices.size() + mesh_ai->mNumFaces*3);
     for (uint32_t i = 0; i < mesh_ai->mNumFaces; ++i) {
@@ -81,49 +423,74 @@ void GeometryImpl::clear() {
     texcoords.clear();
 }
 
-void GeometryImpl::recompute_aabb() {
-    bb_min = glm::vec3(FLT_MAX);
-    bb_max = glm::vec3(FLT_MIN);;
-    for (const auto& pos : positions) {
-        bb_min = glm::min(bb_min, pos);
-        bb_max = glm::max(bb_max, pos);
-    }
+void GeometryImpl::recompute_aabb(ThreadPool* pool) {
+    transform_vertices({ this }, nullptr, pool);
 }
 
-void GeometryImpl::fit_into_aabb(const glm::vec3& aabb_min, const glm::vec3& aabb_max) {
+void GeometryImpl::fit_into_aabb(const glm::vec3& aabb_min, const glm::vec3& aabb_max, ThreadPool* pool) {
     // compute offset to origin and scale factor
     const glm::vec3 center = (bb_min + bb_max) * .5f;
     const glm::vec3 scale_v = (aabb_max - aabb_min) / (bb_max - bb_min);
     const float scale_f = std::min(scale_v.x, std::min(scale_v.y, scale_v.z));
     // apply
-    for (uint32_t i = 0; i < positions.size(); ++i)
-        positions[i] = (positions[i] - center) * scale_f;
-}
-
-void GeometryImpl::translate(const glm::vec3& by) {
-    for (uint32_t i = 0; i < positions.size(); ++i)
-        positions[i] += by;
-}
-
-void GeometryImpl::scale(const glm::vec3& by) {
-    // scale positions
-    for (uint32_t i = 0; i < positions.size(); ++i)
-        positions[i] *= by;
-    // scale normals
-    const glm::mat4 mat_norm = glm::transpose(glm::inverse(glm::scale(glm::mat4(1), by)));
-    for (uint32_t i = 0; i < normals.size(); ++i)
-        normals[i] = glm::normalize(glm::vec3(mat_norm * glm::vec4(normals[i], 0)));
-}
-
-void GeometryImpl::rotate(float angle_degrees, const glm::vec3& axis) {
-    // rotate positions
-    const glm::mat4 rot = glm::rotate(glm::mat4(1), glm::radians(angle_degrees), axis);
-    for (uint32_t i = 0; i < positions.size(); ++i)
-        positions[i] = glm::vec3(rot * glm::vec4(positions[i], 1));
-    // rotate normals
-    const glm::mat4 rot_inv_tra = glm::transpose(glm::inverse(rot));
-    for (uint32_t i = 0; i < normals.size(); ++i)
-        normals[i] = glm::normalize(glm::vec3(rot_inv_tra * glm::vec4(normals[i], 0)));
+    transform(glm::scale(glm::mat4(1), glm::vec3(scale_f)) * glm::translate(glm::mat4(1), -center), pool);
+}
+
+void GeometryImpl::translate(const glm::vec3& by, ThreadPool* pool) {
+    transform(glm::translate(glm::mat4(1), by), pool);
+}
+
+void GeometryImpl::scale(const glm::vec3& by, ThreadPool* pool) {
+    transform(glm::scale(glm::mat4(1), by), pool);
+}
+
+void GeometryImpl::rotate(float angle_degrees, const glm::vec3& axis, ThreadPool* pool) {
+    transform(glm::rotate(glm::mat4(1), glm::radians(angle_degrees), axis), pool);
+}
+
+void GeometryImpl::transform(const glm::mat4& model, ThreadPool* pool) {
+    transform_vertices({ this }, &model, pool);
+}
+
+GeometryOptimizationReport GeometryImpl::optimize() {
+    GeometryOptimizationReport report;
+    if (positions.empty() || indices.size() < 3 || indices.size() % 3 != 0) return report;
+    const float num_triangles = float(indices.size() / 3);
+    const uint32_t misses_before = simulate_fifo_cache(indices, positions.size());
+    report.acmr_before = misses_before / num_triangles;
+    report.atvr_before = misses_before / float(positions.size());
+    // vertices are renumbered for all attributes or not at all, so partial normals or texcoords keep the vertex order
+    if ((!normals.empty() && normals.size() != positions.size()) || (!texcoords.empty() && texcoords.size() != positions.size())) {
+        report.acmr_after = report.acmr_before;
+        report.atvr_after = report.atvr_before;
+        return report;
+    }
+
+    indices = optimize_vertex_cache(indices, positions.size());
+    optimize_overdraw(indices, positions);
+
+    // number the vertices in order of first use, so they are fetched sequentially
+    std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+    uint32_t num_used = 0;
+    for (auto& index : indices) {
+        if (remap[index] == UINT32_MAX) remap[index] = num_used++;
+        index = remap[index];
+    }
+    const auto reorder = [&](auto& attribute) {
+        if (attribute.empty()) return;
+        std::remove_reference_t<decltype(attribute)> reordered(num_used);
+        for (size_t v = 0; v < remap.size(); v++)
+            if (remap[v] != UINT32_MAX) reordered[remap[v]] = attribute[v];
+        attribute.swap(reordered);
+    };
+    reorder(positions);
+    reorder(normals);
+    reorder(texcoords);
+
+    const uint32_t misses_after = simulate_fifo_cache(indices, positions.size());
+    report.acmr_after = misses_after / num_triangles;
+    report.atvr_after = misses_after / float(positions.size());
+    return report;
 }
 
 CPPGL_NAMESPACE_END
@@ -0,0 +1,182 @@
+#include "geometry_arena.h"
+#include <numeric>
+#include <algorithm>
+
+CPPGL_NAMESPACE_BEGIN
+
+static uint32_t index_size(GLenum index_type) {
+    return index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+static void copy_buffer(GLuint source, GLuint target, size_t target_offset, size_t size_bytes) {
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, target_offset, size_bytes);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+// ------------------------------------------
+// GeometryArena
+
+GeometryArena::GeometryArena(const std::string& name)
+    : name(name), multi_draw_indirect(GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance)),
+      num_meshes(0), num_vertices(0), num_indices(0), vao(0), index_type(GL_UNSIGNED_INT), indirect_offset(0), transforms_texture(0) {
+    ibo = IBO(name + "_index_buffer");
+    if (multi_draw_indirect) {
+        draw_ids = VBO(name + "_draw_ids");
+        indirect = DIBO(name + "_commands");
+    }
+    transforms = TBO(name + "_transforms");
+    glGenTextures(1, &transforms_texture);
+
+    // setup vao, the vertex buffers are attached by build(), all buffers keep their names when they are resized
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    if (multi_draw_indirect) {
+        // instanced attribute, so the base instance of a draw selects its index
+        draw_ids->bind();
+        glEnableVertexAttribArray(ARENA_DRAW_ATTRIB);
+        glVertexAttribIPointer(ARENA_DRAW_ATTRIB, 1, GL_UNSIGNED_INT, 0, 0);
+        glVertexAttribDivisor(ARENA_DRAW_ATTRIB, 1);
+    }
+    ibo->bind();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::~GeometryArena() {
+    glDeleteTextures(1, &transforms_texture);
+    glDeleteVertexArrays(1, &vao);
+}
+
+bool GeometryArena::packable(const MeshImpl* mesh) const {
+    return mesh && mesh->ibo && mesh->primitive_type == GL_TRIANGLES && mesh->index_type == index_type && mesh->vbo_layouts == layouts;
+}
+
+bool GeometryArena::outdated(const std::vector<const MeshImpl*>& meshes) const {
+    if (meshes.size() != sources.size()) return true;
+    for (size_t i = 0; i < meshes.size(); i++)
+        if (meshes[i] != sources[i].first || meshes[i]->revision != sources[i].second)
+            return true;
+    return false;
+}
+
+void GeometryArena::build(const std::vector<const MeshImpl*>& meshes) {
+    sources.clear();
+    for (const MeshImpl* mesh : meshes)
+        sources.emplace_back(mesh, mesh->revision);
+
+    // adopt the most common layout of the indexed triangle meshes
+    const MeshImpl* reference = nullptr;
+    size_t reference_count = 0;
+    for (const MeshImpl* candidate : meshes) {
+        if (!candidate->ibo || candidate->primitive_type != GL_TRIANGLES) continue;
+        const size_t count = std::count_if(meshes.begin(), meshes.end(), [&](const MeshImpl* mesh) {
+            return mesh->index_type == candidate->index_type && mesh->vbo_layouts == candidate->vbo_layouts; });
+        if (count > reference_count) {
+            reference = candidate;
+            reference_count = count;
+        }
+    }
+    glBindVertexArray(vao);
+    for (const auto& layout : layouts)
+        for (const auto& attribute : layout.attributes)
+            glDisableVertexAttribArray(attribute.location);
+    layouts = reference ? reference->vbo_layouts : std::vector<VertexLayout>();
+    index_type = reference ? reference->index_type : GL_UNSIGNED_INT;
+    while (vbos.size() < layouts.size())
+        vbos.push_back(VBO(name + "_vertex_buffer_" + std::to_string(vbos.size())));
+    for (size_t i = 0; i < layouts.size(); i++) {
+        vbos[i]->bind();
+        layouts[i].setup();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    ranges.clear();
+    num_meshes = num_vertices = num_indices = 0;
+    for (const MeshImpl* mesh : meshes) {
+        if (!packable(mesh) || ranges.count(mesh)) continue;
+        ArenaRange& range = ranges[mesh];
+        range.first_index = num_indices;
+        range.index_count = mesh->num_indices;
+        range.base_vertex = int32_t(num_vertices);
+        range.revision = mesh->revision;
+        num_meshes++;
+        num_vertices += mesh->num_vertices;
+        num_indices += mesh->num_indices;
+    }
+
+    // copy on the GPU, indices stay relative to their mesh
+    for (size_t i = 0; i < layouts.size(); i++)
+        vbos[i]->resize(size_t(num_vertices) * layouts[i].stride, GL_STATIC_DRAW);
+    ibo->resize(size_t(num_indices) * index_size(index_type), GL_STATIC_DRAW);
+    for (const auto& [mesh, range] : ranges) {
+        for (size_t i = 0; i < layouts.size(); i++)
+            copy_buffer(mesh->vbos[i]->id, vbos[i]->id, size_t(range.base_vertex) * layouts[i].stride, size_t(mesh->num_vertices) * layouts[i].stride);
+        copy_buffer(mesh->ibo->id, ibo->id, size_t(range.first_index) * index_size(index_type), size_t(range.index_count) * index_size(index_type));
+    }
+}
+
+const ArenaRange* GeometryArena::find(const MeshImpl* mesh) const {
+    const auto it = ranges.find(mesh);
+    return it != ranges.end() && it->second.revision == mesh->revision ? &it->second : nullptr;
+}
+
+void GeometryArena::set_transforms(const std::vector<glm::mat4>& models) {
+    transforms->upload_data(models.data(), models.size() * sizeof(glm::mat4));
+    glBindTexture(GL_TEXTURE_BUFFER, transforms_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transforms->id);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    // one index per transform for the base instances of indirect draws
+    if (multi_draw_indirect && draw_ids->size_bytes != models.size() * sizeof(uint32_t)) {
+        std::vector<uint32_t> ids(models.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        draw_ids->upload_data(ids.data(), ids.size() * sizeof(uint32_t), GL_STATIC_DRAW);
+    }
+}
+
+void GeometryArena::bind(const Shader& shader) const {
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0 + ARENA_TRANSFORM_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, transforms_texture);
+    glActiveTexture(GL_TEXTURE0);
+    shader->uniform("arena_models", int(ARENA_TRANSFORM_UNIT));
+}
+
+void GeometryArena::draw(const std::vector<ArenaDraw>& draws) {
+    if (draws.empty()) return;
+    if (!multi_draw_indirect) {
+        for (const ArenaDraw& draw : draws) {
+            glVertexAttribI1ui(ARENA_DRAW_ATTRIB, draw.draw);
+            glDrawElementsBaseVertex(GL_TRIANGLES, draw.range->index_count, index_type,
+                    (const void*)(size_t(draw.range->first_index) * index_size(index_type)), draw.range->base_vertex);
+        }
+        return;
+    }
+    commands.resize(draws.size());
+    for (size_t i = 0; i < draws.size(); i++)
+        commands[i] = { draws[i].range->index_count, 1, draws[i].range->first_index, draws[i].range->base_vertex, draws[i].draw };
+    // append to the command buffer, orphan it when full: earlier draws keep reading the previous storage
+    const size_t size_bytes = commands.size() * sizeof(DrawCommand);
+    if (indirect_offset + size_bytes > indirect->size_bytes) {
+        indirect->resize(std::max(size_bytes, std::max(indirect->size_bytes, size_t(64 << 10))), GL_STREAM_DRAW);
+        indirect_offset = 0;
+    }
+    indirect->bind();
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, indirect_offset, size_bytes, commands.data());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, index_type, (const void*)indirect_offset, GLsizei(commands.size()), 0);
+    indirect->unbind();
+    indirect_offset += size_bytes;
+}
+
+void GeometryArena::unbind() const {
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0 + ARENA_TRANSFORM_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include "buffer.h"
+#include "mesh.h"
+#include "shader.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// ------------------------------------------
+// Geometry arena
+// The vertex and index data of many meshes copied into shared buffers with a single vertex array, so that meshes are
+// drawn without switching vertex arrays: each mesh is a range (first index, base vertex) of the shared buffers.
+// All packed meshes share the vertex layouts and index type of the arena, which are taken from the most common
+// combination among the meshes it is built from.
+// Draws are submitted with one glMultiDrawElementsIndirect if available (GL 4.3 or ARB_multi_draw_indirect with
+// ARB_base_instance), otherwise with one glDrawElementsBaseVertex per mesh.
+// Every draw passes an index (e.g. of its drawelement) to the vertex shader as the integer attribute ARENA_DRAW_ATTRIB,
+// which selects its model matrix from the transforms bound to the samplerBuffer "arena_models" (see draw.vs, ARENA).
+
+// vertex attribute of the draw index and texture unit of the transforms
+const GLuint ARENA_DRAW_ATTRIB = 3;
+const uint32_t ARENA_TRANSFORM_UNIT = 15;
+
+// a packed mesh
+struct ArenaRange {
+    uint32_t first_index = 0;   // into the shared index buffer
+    uint32_t index_count = 0;
+    int32_t base_vertex = 0;    // added to every index
+    uint64_t revision = 0;      // MeshImpl::revision the range was copied from
+};
+
+struct ArenaDraw {
+    const ArenaRange* range;
+    uint32_t draw;              // passed to the vertex shader
+};
+
+class GeometryArena {
+public:
+    GeometryArena(const std::string& name = "geometry_arena");
+    ~GeometryArena();
+
+    // prevent copies, since GL objects aren't reference counted
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copy the GPU data of the given meshes into the shared buffers, replacing the previous content
+    // meshes that are not packable are skipped
+    void build(const std::vector<const MeshImpl*>& meshes);
+    // whether meshes or their revisions differ from the last build()
+    bool outdated(const std::vector<const MeshImpl*>& meshes) const;
+    // indexed triangle mesh with the vertex layouts and index type of the arena
+    bool packable(const MeshImpl* mesh) const;
+    // range of a packed mesh, nullptr if it was not packed or changed since
+    const ArenaRange* find(const MeshImpl* mesh) const;
+
+    // upload the model matrix of every draw index, draws may only use indices below models.size()
+    void set_transforms(const std::vector<glm::mat4>& models);
+
+    // call in this order to draw, shader has to read its model matrix from "arena_models"
+    void bind(const Shader& shader) const;
+    void draw(const std::vector<ArenaDraw>& draws);
+    void unbind() const;
+
+    // data
+    const std::string name;
+    const bool multi_draw_indirect;
+    uint32_t num_meshes, num_vertices, num_indices;
+
+private:
+    GLuint vao;
+    std::vector<VertexLayout> layouts;  // of each vertex buffer
+    GLenum index_type;
+    std::vector<VBO> vbos;
+    IBO ibo;
+    VBO draw_ids;               // 0, 1, 2, ... selected by the base instance of indirect draws
+    DIBO indirect;
+    size_t indirect_offset;     // next free byte of indirect, orphaned when full
+    TBO transforms;
+    GLuint transforms_texture;
+    std::unordered_map<const MeshImpl*, ArenaRange> ranges;
+    std::vector<std::pair<const MeshImpl*, uint64_t>> sources;     // meshes and revisions of the last build()
+    struct DrawCommand {
+        uint32_t count, instance_count, first_index;
+        int32_t base_vertex;
+        uint32_t base_instance;
+    };
+    std::vector<DrawCommand> commands;
+};
+
+CPPGL_NAMESPACE_END
@@ -115,7 +115,9 @@ void gui_draw() {
             for (auto& [name, shader] : Shader::map)
                 if (ImGui::CollapsingHeader(name.c_str()))
                     gui_display_shader(shader);
-            if (ImGui::Button("Reload modified")) reload_modified_shaders();
+            if (ImGui::Button("Reload modified")) reload_modified_shaders(true);
+            ImGui::SameLine();
+            ImGui::Checkbox("Hot reload", &ShaderImpl::hot_reload);
         }
         ImGui::End();
     }
@@ -245,39 +247,39 @@ void gui_display_material(const Material& mat) {
     ImGui::Indent();
     ImGui::Text("name: %s", mat->name.c_str());
 
-    ImGui::Text("int params: %lu", mat->int_map.size());
+    ImGui::Text("int params: %lu", mat->ints().size());
     ImGui::Indent();
-    for (const auto& entry : mat->int_map)
+    for (const auto& entry : mat->ints())
         ImGui::Text("%s: %i", entry.first.c_str(), entry.second);
     ImGui::Unindent();
 
-    ImGui::Text("float params: %lu", mat->float_map.size());
+    ImGui::Text("float params: %lu", mat->floats().size());
     ImGui::Indent();
-    for (const auto& entry : mat->float_map)
+    for (const auto& entry : mat->floats())
         ImGui::Text("%s: %f", entry.first.c_str(), entry.second);
     ImGui::Unindent();
 
-    ImGui::Text("vec2 params: %lu", mat->vec2_map.size());
+    ImGui::Text("vec2 params: %lu", mat->vec2s().size());
     ImGui::Indent();
-    for (const auto& entry : mat->vec2_map)
+    for (const auto& entry : mat->vec2s())
         ImGui::Text("%s: (%f, %f)", entry.first.c_str(), entry.second.x, entry.second.y);
     ImGui::Unindent();
 
-    ImGui::Text("vec3 params: %lu", mat->vec3_map.size());
+    ImGui::Text("vec3 params: %lu", mat->vec3s().size());
     ImGui::Indent();
-    for (const auto& entry : mat->vec3_map)
+    for (const auto& entry : mat->vec3s())
         ImGui::Text("%s: (%f, %f, %f)", entry.first.c_str(), entry.second.x, entry.second.y, entry.second.z);
     ImGui::Unindent();
 
-    ImGui::Text("vec4 params: %lu", mat->vec4_map.size());
+    ImGui::Text("vec4 params: %lu", mat->vec4s().size());
     ImGui::Indent();
-    for (const auto& entry : mat->vec4_map)
+    for (const auto& entry : mat->vec4s())
         ImGui::Text("%s: (%f, %f, %f, %.f)", entry.first.c_str(), entry.second.x, entry.second.y, entry.second.z, entry.second.w);
     ImGui::Unindent();
 
-    ImGui::Text("textures: %lu", mat->texture_map.size());
+    ImGui::Text("textures: %lu", mat->textures().size());
     ImGui::Indent();
-    for (const auto& entry : mat->texture_map) {
+    for (const auto& entry : mat->textures()) {
         ImGui::Text("%s:", entry.first.c_str());
         gui_display_texture(entry.second);
     }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "platform.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// FNV-1a hash of raw bytes, pass the previous result as hash to continue it over further data
+// fast and stable across runs and platforms (e.g. for cache keys), not collision resistant against deliberate attacks
+
+constexpr uint64_t HASH_BYTES_SEED = 14695981039346656037ull;
+
+inline uint64_t hash_bytes(const void* data, size_t size_bytes, uint64_t hash = HASH_BYTES_SEED) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size_bytes; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+CPPGL_NAMESPACE_END
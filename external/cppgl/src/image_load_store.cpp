@@ -4,45 +4,43 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stbi/stb_image_write.h"
 #include <algorithm>
-#include <thread>
+#include "thread_pool.h"
 
 CPPGL_NAMESPACE_BEGIN
 
 ///////////////////////
 //load
 
-std::tuple<std::vector<uint8_t>, int, int, int, bool> image_load(const std::filesystem::path& path) {
-    stbi_set_flip_vertically_on_load(1); // important: the default value for this is different on windows and linux
-
-    uint8_t* data = 0;
-    int w_out, h_out, channels_out;
-    bool is_hdr_out = stbi_is_hdr(path.string().c_str());
-    size_t size_of_buffer = 0;
-
-    // load image from disk
-    if (is_hdr_out) {
-        data = (uint8_t*)stbi_loadf(path.string().c_str(), &w_out, &h_out, &channels_out, 0);
-        size_of_buffer = w_out * h_out * channels_out * sizeof(float);
-    } else {
-        data = stbi_load(path.string().c_str(), &w_out, &h_out, &channels_out, 0);
-        size_of_buffer = w_out * h_out * channels_out;
-    }
-    if (!data)
-        throw std::runtime_error("Failed to load image file: " + path.string());
+Image image_decode(const std::filesystem::path& path) {
+    stbi_set_flip_vertically_on_load_thread(1); // important: the default value for this is different on windows and linux
 
-    // copy array to output
-    std::vector<uint8_t> data_out;
-    data_out.insert(data_out.end(), &data[0], &data[size_of_buffer]);
-    
-    // free data
-    stbi_image_free(data);
+    Image image;
+    image.is_hdr = stbi_is_hdr(path.string().c_str());
+    if (image.is_hdr)
+        image.data = { (uint8_t*)stbi_loadf(path.string().c_str(), &image.w, &image.h, &image.channels, 0), stbi_image_free };
+    else
+        image.data = { stbi_load(path.string().c_str(), &image.w, &image.h, &image.channels, 0), stbi_image_free };
+    if (!image.data)
+        throw std::runtime_error("Failed to load image file: " + path.string());
+    image.size_bytes = size_t(image.w) * image.h * image.channels * (image.is_hdr ? sizeof(float) : 1);
+    return image;
+}
 
-    return { data_out, w_out, h_out, channels_out, is_hdr_out };
+std::tuple<std::vector<uint8_t>, int, int, int, bool> image_load(const std::filesystem::path& path) {
+    Image image = image_decode(path);
+    std::vector<uint8_t> data_out(image.data.get(), image.data.get() + image.size_bytes);
+    return { data_out, image.w, image.h, image.channels, image.is_hdr };
 }
 
 ///////////////////////
 //save
 
+// asynchronous stores share a few writer threads instead of one detached thread per image
+static ThreadPool& image_store_pool() {
+    static ThreadPool pool(2);
+    return pool;
+}
+
 void image_store_ldr_impl(const std::filesystem::path& path, const uint8_t* image_data, int w, int h, int channels, bool flip) {
     stbi_flip_vertically_on_write(flip);
 
@@ -65,8 +63,7 @@ void image_store_ldr_thread(const std::filesystem::path& path, const std::shared
 void image_store_ldr(const std::filesystem::path& path, const uint8_t* image_data, int w, int h, int channels, bool flip, bool async) {
     if (async) {
         std::shared_ptr<std::vector<uint8_t>> image_data_vector = std::make_shared<std::vector<uint8_t>>(image_data, image_data + size_t(w) * h * channels);
-        std::thread worker(image_store_ldr_thread, path, image_data_vector, w, h, channels, flip);
-        worker.detach();
+        image_store_pool().enqueue([=]() { image_store_ldr_thread(path, image_data_vector, w, h, channels, flip); });
     } else
         image_store_ldr_impl(path, image_data, w, h, channels, flip);
 }
@@ -87,8 +84,7 @@ void image_store_hdr_thread(const std::filesystem::path& path, const std::shared
 void image_store_hdr(const std::filesystem::path& path, const float* image_data, int w, int h, int channels, bool flip, bool async) {
     if (async) {
         std::shared_ptr<std::vector<float>> image_data_vector = std::make_shared<std::vector<float>>(image_data, image_data + size_t(w) * h * channels);
-        std::thread worker(image_store_hdr_thread, path, image_data_vector, w, h, channels, flip);
-        worker.detach();
+        image_store_pool().enqueue([=]() { image_store_hdr_thread(path, image_data_vector, w, h, channels, flip); });
     } else
         image_store_hdr_impl(path, image_data, w, h, channels, flip);
 }
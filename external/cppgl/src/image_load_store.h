@@ -1,10 +1,23 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include <filesystem>
 #include "platform.h"
 
 CPPGL_NAMESPACE_BEGIN
 
+// Decoded image in the buffer allocated by the decoder (rows bottom to top, as expected by OpenGL)
+// Note: if is_hdr is set, data holds floats
+struct Image {
+    std::unique_ptr<uint8_t, void (*)(void*)> data = { nullptr, nullptr };
+    int w = 0, h = 0, channels = 0;
+    bool is_hdr = false;
+    size_t size_bytes = 0;
+};
+
+// Decode without copying the result, safe to call from multiple threads
+Image image_decode(const std::filesystem::path& path);
+
 // Return values: image data, width, height, channels, is_hdr
 // Usage: auto [data, w, h, c, is_hdr] = load_image(path);
 // Note: if is_hdr is set, image data is of type float stored as byte array
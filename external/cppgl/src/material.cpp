@@ -1,11 +1,15 @@
 #include "material.h"
+#include "texture_loader.h"
 #include <iostream>
+#include <cstring>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
 
 CPPGL_NAMESPACE_BEGIN
 
-MaterialImpl::MaterialImpl(const std::string& name) : name(name) {}
+MaterialImpl::MaterialImpl(const std::string& name) : name(name), revision(0), bound(nullptr) {}
 
-MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, const aiMaterial* mat_ai) : name(name) {
+MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, const aiMaterial* mat_ai) : name(name), revision(0), bound(nullptr) {
     // TODO include more (useful) assimp params?
     // ambient, diffuse, specular and emissive color are handled via fallback 1x1 textures
     // parse assimp material parameters (http://assimp.sourceforge.net/lib_html/materials.html)
@@ -44,7 +48,7 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
     if (mat_ai->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_DIFFUSE, 0, &path_ai);
-        texture_map["diffuse"] = Texture2D(name + "_diffuse_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["diffuse"] = TextureLoader::load(name + "_diffuse_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     } else if (mat_ai->Get(AI_MATKEY_COLOR_DIFFUSE, vec3_value) == AI_SUCCESS) {
         // 1x1 fallback texture
         texture_map["diffuse"] = Texture2D(name + "_diffuse_" + name_ai.C_Str(), 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT, &vec3_value.r);
@@ -53,7 +57,7 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
     if (mat_ai->GetTextureCount(aiTextureType_SPECULAR) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_SPECULAR, 0, &path_ai);
-        texture_map["specular"] = Texture2D(name + "_specular_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["specular"] = TextureLoader::load(name + "_specular_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     } else if (mat_ai->Get(AI_MATKEY_COLOR_SPECULAR, vec3_value) == AI_SUCCESS) {
         // 1x1 fallback texture
         texture_map["specular"] = Texture2D(name + "_specular_" + name_ai.C_Str(), 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT, &vec3_value.r);
@@ -62,7 +66,7 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
     if (mat_ai->GetTextureCount(aiTextureType_AMBIENT) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_AMBIENT, 0, &path_ai);
-        texture_map["ambient"] = Texture2D(name + "_ambient_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["ambient"] = TextureLoader::load(name + "_ambient_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     } else if (mat_ai->Get(AI_MATKEY_COLOR_AMBIENT, vec3_value) == AI_SUCCESS) {
         // 1x1 fallback texture
         texture_map["ambient"] = Texture2D(name + "_ambient_" + name_ai.C_Str(), 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT, &vec3_value.r);
@@ -71,7 +75,7 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
     if (mat_ai->GetTextureCount(aiTextureType_EMISSIVE) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_EMISSIVE, 0, &path_ai);
-        texture_map["emissive"] = Texture2D(name + "_emissive_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["emissive"] = TextureLoader::load(name + "_emissive_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     } else if (mat_ai->Get(AI_MATKEY_COLOR_EMISSIVE, vec3_value) == AI_SUCCESS) {
         // 1x1 fallback texture
         texture_map["emissive"] = Texture2D(name + "_emissive_" + name_ai.C_Str(), 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT, &vec3_value.r);
@@ -81,31 +85,31 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
     if (mat_ai->GetTextureCount(aiTextureType_HEIGHT) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_HEIGHT, 0, &path_ai);
-        texture_map["normalmap"] = Texture2D(name + "_normal_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["normalmap"] = TextureLoader::load(name + "_normal_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     }
     // alphamap (TODO how to handle alphamap vs opacity parameter, or alpha channel of diffuse texture such as in SMG?)
     if (mat_ai->GetTextureCount(aiTextureType_OPACITY) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_OPACITY, 0, &path_ai);
-        texture_map["alphamap"] = Texture2D(name + "_alpha_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["alphamap"] = TextureLoader::load(name + "_alpha_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     }
     // roughness texture (TODO do we want this, or just the static roughness param?)
     if (mat_ai->GetTextureCount(aiTextureType_SHININESS) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_SHININESS, 0, &path_ai);
-        texture_map["roughness"] = Texture2D(name + "_roughness_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["roughness"] = TextureLoader::load(name + "_roughness_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     }
     // displacement map
     if (mat_ai->GetTextureCount(aiTextureType_DISPLACEMENT) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_DISPLACEMENT, 0, &path_ai);
-        texture_map["displacement"] = Texture2D(name + "_displacement_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["displacement"] = TextureLoader::load(name + "_displacement_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     }
     // lightmap (baked AO or something)
     if (mat_ai->GetTextureCount(aiTextureType_LIGHTMAP) > 0) {
         aiString path_ai;
         mat_ai->GetTexture(aiTextureType_LIGHTMAP, 0, &path_ai);
-        texture_map["lightmap"] = Texture2D(name + "_light_" + name_ai.C_Str(), base_path / path_ai.C_Str());
+        texture_map["lightmap"] = TextureLoader::load(name + "_light_" + name_ai.C_Str(), base_path / path_ai.C_Str());
     }
     // whatever
     if (mat_ai->GetTextureCount(aiTextureType_UNKNOWN) > 0)
@@ -114,28 +118,97 @@ MaterialImpl::MaterialImpl(const std::string& name, const fs::path& base_path, c
 
 MaterialImpl::~MaterialImpl() {}
 
-void MaterialImpl::bind(const Shader& shader) const {
-    // bind parameters as uniforms
-    for (const auto& entry : int_map)
-        shader->uniform(entry.first, entry.second);
-    for (const auto& entry : float_map)
-        shader->uniform(entry.first, entry.second);
-    for (const auto& entry : vec2_map)
-        shader->uniform(entry.first, entry.second);
-    for (const auto& entry : vec3_map)
-        shader->uniform(entry.first, entry.second);
-    for (const auto& entry : vec4_map)
-        shader->uniform(entry.first, entry.second);
-    // bind textures as sampler2Ds
+// write a parameter into the std140 block data at the reflected member offset, if the types match
+static void write_block_member(std::vector<uint8_t>& data, const ShaderImpl::UniformInfo& member, GLenum type, const void* value, size_t size) {
+    if (member.type != type || member.offset < 0 || member.offset + size > data.size()) return;
+    std::memcpy(data.data() + member.offset, value, size);
+}
+
+MaterialState MaterialImpl::compile(const ShaderImpl& shader, const MaterialState* previous) const {
+    MaterialState state;
+    state.shader = &shader;
+    state.link_serial = shader.link_serial;
+    state.revision = revision;
+
+    // parameters go into the "Material" uniform block if the shader declares one, into plain uniforms otherwise
+    const ShaderImpl::UniformBlockInfo* block = shader.find_uniform_block("Material");
+    std::vector<uint8_t> block_data(block ? block->size_bytes : 0);
+    const auto add = [&](const std::string& name, GLenum type, int i, const glm::vec4& f, size_t size) {
+        const ShaderImpl::UniformInfo* info = shader.find_uniform(name);
+        if (!info && block) info = shader.find_uniform("Material." + name);
+        if (!info) return;
+        if (block && info->block == GLint(block->index))
+            write_block_member(block_data, *info, type, type == GL_INT ? (const void*)&i : (const void*)glm::value_ptr(f), size);
+        else if (info->location >= 0)
+            state.values.push_back(MaterialState::Value{ info->location, type, i, f });
+    };
+    for (const auto& [key, value] : int_map)
+        add(key, GL_INT, value, glm::vec4(0), sizeof(int));
+    for (const auto& [key, value] : float_map)
+        add(key, GL_FLOAT, 0, glm::vec4(value, 0, 0, 0), sizeof(float));
+    for (const auto& [key, value] : vec2_map)
+        add(key, GL_FLOAT_VEC2, 0, glm::vec4(value, 0, 0), sizeof(glm::vec2));
+    for (const auto& [key, value] : vec3_map)
+        add(key, GL_FLOAT_VEC3, 0, glm::vec4(value, 0), sizeof(glm::vec3));
+    for (const auto& [key, value] : vec4_map)
+        add(key, GL_FLOAT_VEC4, 0, value, sizeof(glm::vec4));
+    if (block) {
+        // the buffer is private to the state: not registered by name, kept across recompiles
+        if (previous && previous->block)
+            state.block = previous->block;
+        else
+            state.block.ptr = std::make_shared<GLBufferImpl<GL_UNIFORM_BUFFER>>(name + "_" + shader.name + "_block");
+        state.block->upload_data(block_data.data(), block_data.size(), GL_STATIC_DRAW);
+    }
+
+    // textures keep their unit from the map order, samplers the shader does not use are skipped
     uint32_t unit = 0;
-    for (const auto& entry : texture_map)
-        shader->uniform(entry.first, entry.second, unit++);
+    for (const auto& [key, texture] : texture_map) {
+        const GLint location = shader.uniform_location(key);
+        if (location >= 0)
+            state.textures.push_back(MaterialState::TextureBinding{ location, unit, texture });
+        unit++;
+    }
+    return state;
+}
+
+void MaterialImpl::bind(const Shader& shader) const {
+    // find (or compile) the state for the current program of the shader
+    const ShaderImpl* impl = shader.ptr.get();
+    if (!impl) return;
+    MaterialState* state = nullptr;
+    for (auto& entry : states)
+        if (entry.shader == impl) state = &entry;
+    if (!state) state = &states.emplace_back();
+    if (state->link_serial != impl->link_serial || state->revision != revision)
+        *state = compile(*impl, state);
+    bound = state;
+
+    for (const auto& value : state->values) {
+        switch (value.type) {
+            case GL_INT: glUniform1i(value.location, value.i); break;
+            case GL_FLOAT: glUniform1f(value.location, value.f.x); break;
+            case GL_FLOAT_VEC2: glUniform2f(value.location, value.f.x, value.f.y); break;
+            case GL_FLOAT_VEC3: glUniform3f(value.location, value.f.x, value.f.y, value.f.z); break;
+            case GL_FLOAT_VEC4: glUniform4f(value.location, value.f.x, value.f.y, value.f.z, value.f.w); break;
+        }
+    }
+    if (state->block)
+        shader->uniform("Material", state->block, MATERIAL_BLOCK_BINDING);
+    for (const auto& binding : state->textures) {
+        binding.texture->bind(binding.unit);
+        glUniform1i(binding.location, binding.unit);
+    }
 }
 
 void MaterialImpl::unbind() const {
     // unbind textures
-    for (const auto& entry : texture_map)
-        entry.second->unbind();
+    if (!bound) return;
+    for (const auto& binding : bound->textures) {
+        glActiveTexture(GL_TEXTURE0 + binding.unit);
+        binding.texture->unbind();
+    }
+    bound = nullptr;
 }
 
 CPPGL_NAMESPACE_END
@@ -2,6 +2,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <memory>
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -12,33 +13,83 @@ namespace fs = std::filesystem;
 #include "named_handle.h"
 #include "shader.h"
 #include "texture.h"
+#include "buffer.h"
 
 CPPGL_NAMESPACE_BEGIN
 
 // ------------------------------------------
 // Material
 
+// binding point of the optional "Material" uniform block, above the points used by the application
+const uint32_t MATERIAL_BLOCK_BINDING = 8;
+
+// material parameters resolved against the reflected uniforms of one shader program, see MaterialImpl::bind
+struct MaterialState {
+    struct Value {
+        GLint location;
+        GLenum type;
+        int i;
+        glm::vec4 f;
+    };
+    struct TextureBinding {
+        GLint location;
+        uint32_t unit;
+        Texture2D texture;
+    };
+    const ShaderImpl* shader = nullptr;
+    uint64_t link_serial = 0;       // program the state was compiled for
+    uint64_t revision = 0;          // material revision the state was compiled from
+    UBO block;                      // parameters of the "Material" uniform block, if declared (not registered by name)
+    std::vector<Value> values;      // parameters set as plain uniforms
+    std::vector<TextureBinding> textures;
+};
+
 class MaterialImpl {
 public:
     MaterialImpl(const std::string& name);
     MaterialImpl(const std::string& name, const fs::path& base_path, const aiMaterial* mat_ai);
     virtual ~MaterialImpl();
 
+    // binds the state compiled for the shader, compiling it on first use or after changes
     void bind(const Shader& shader) const;
     void unbind() const;
 
+    // resolve the parameters and textures against the active uniforms of the shader, reusing the block buffer of previous
+    MaterialState compile(const ShaderImpl& shader, const MaterialState* previous = nullptr) const;
+
+    // parameters, passed as uniforms (or members of the "Material" uniform block) of the same name
+    // all changes go through the setters, so compiled states notice them
+    inline void set_int(const std::string& uniform_name, int value) { int_map[uniform_name] = value; revision++; }
+    inline void set_float(const std::string& uniform_name, float value) { float_map[uniform_name] = value; revision++; }
+    inline void set_vec2(const std::string& uniform_name, const glm::vec2& value) { vec2_map[uniform_name] = value; revision++; }
+    inline void set_vec3(const std::string& uniform_name, const glm::vec3& value) { vec3_map[uniform_name] = value; revision++; }
+    inline void set_vec4(const std::string& uniform_name, const glm::vec4& value) { vec4_map[uniform_name] = value; revision++; }
+    inline const std::map<std::string, int>& ints() const { return int_map; }
+    inline const std::map<std::string, float>& floats() const { return float_map; }
+    inline const std::map<std::string, glm::vec2>& vec2s() const { return vec2_map; }
+    inline const std::map<std::string, glm::vec3>& vec3s() const { return vec3_map; }
+    inline const std::map<std::string, glm::vec4>& vec4s() const { return vec4_map; }
+
     inline bool has_texture(const std::string& uniform_name) const { return texture_map.count(uniform_name); }
     inline Texture2D get_texture(const std::string& uniform_name) const { return texture_map.at(uniform_name); }
-    inline void add_texture(const std::string& uniform_name, const Texture2D& texture) { texture_map[uniform_name] = texture; }
+    inline void add_texture(const std::string& uniform_name, const Texture2D& texture) { texture_map[uniform_name] = texture; revision++; }
+    inline const std::map<std::string, Texture2D>& textures() const { return texture_map; }
 
     // data
     const std::string name;
+
+private:
     std::map<std::string, int> int_map;
     std::map<std::string, float> float_map;
     std::map<std::string, glm::vec2> vec2_map;
     std::map<std::string, glm::vec3> vec3_map;
     std::map<std::string, glm::vec4> vec4_map;
     std::map<std::string, Texture2D> texture_map;
+    uint64_t revision;              // bumped by every change of the parameters or textures
+
+    // compiled states, one per shader the material is used with
+    mutable std::vector<MaterialState> states;
+    mutable const MaterialState* bound;
 };
 
 using Material = NamedHandle<MaterialImpl>;
@@ -1,5 +1,10 @@
 #include "mesh.h"
 #include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include "platform.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -7,6 +12,7 @@
 #include <assimp/mesh.h>
 #include <assimp/material.h>
 #include "buffer.h"
+#include "mesh_cache.h"
 
 CPPGL_NAMESPACE_BEGIN
 
@@ -34,13 +40,108 @@ inline uint32_t type_to_bytes(GLenum type) {
     }
 }
 
+static bool is_integer_type(GLenum type) {
+    return type == GL_BYTE || type == GL_UNSIGNED_BYTE || type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_INT || type == GL_UNSIGNED_INT;
+}
+
+// ------------------------------------------
+// VertexLayout
+
+bool VertexAttribute::operator==(const VertexAttribute& other) const {
+    return location == other.location && dim == other.dim && type == other.type && normalized == other.normalized && offset == other.offset;
+}
+
+bool VertexLayout::operator==(const VertexLayout& other) const {
+    return stride == other.stride && attributes == other.attributes;
+}
+
+void VertexLayout::setup() const {
+    for (const auto& attribute : attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        const void* offset = (const void*)size_t(attribute.offset);
+        if (is_integer_type(attribute.type) && !attribute.normalized)
+            glVertexAttribIPointer(attribute.location, attribute.dim, attribute.type, stride, offset);
+        else if (attribute.type == GL_DOUBLE)
+            glVertexAttribLPointer(attribute.location, attribute.dim, attribute.type, stride, offset);
+        else
+            glVertexAttribPointer(attribute.location, attribute.dim, attribute.type, attribute.normalized, stride, offset);
+    }
+}
+
+void CompactFormat::include(uint32_t num_vertices, const glm::vec2* texcoords) {
+    if (num_vertices > 65536)
+        index_type = GL_UNSIGNED_INT;
+    if (!texcoords || texcoord_type == GL_FLOAT) return;
+    float min_tc = 0.f, max_tc = 1.f;
+    for (uint32_t i = 0; i < num_vertices; ++i) {
+        min_tc = std::min(min_tc, std::min(texcoords[i].x, texcoords[i].y));
+        max_tc = std::max(max_tc, std::max(texcoords[i].x, texcoords[i].y));
+    }
+    // halfs step by 2^-11 below 1, 2^-10 above (several texels of a 4K texture), so repeated textures keep floats
+    if (min_tc < -1.f || max_tc > 1.f)
+        texcoord_type = GL_FLOAT;
+    else if (min_tc < 0.f)
+        texcoord_type = GL_HALF_FLOAT;
+}
+
+VertexLayout compact_vertex_layout(const CompactFormat& format, bool normals, bool texcoords) {
+    VertexLayout layout = { 12, { { 0, 3, GL_FLOAT, GL_FALSE, 0 } } };
+    // attributes keep the locations of the float layout (position, normal, texcoord)
+    GLuint location = 1;
+    if (normals) {
+        layout.attributes.push_back({ location++, 4, GL_INT_2_10_10_10_REV, GL_TRUE, layout.stride });
+        layout.stride += 4;
+    }
+    if (texcoords) {
+        const bool unorm = format.texcoord_type == GL_UNSIGNED_SHORT;
+        layout.attributes.push_back({ location, 2, format.texcoord_type, GLboolean(unorm ? GL_TRUE : GL_FALSE), layout.stride });
+        layout.stride += format.texcoord_type == GL_FLOAT ? 8 : 4;
+    }
+    return layout;
+}
+
+VertexLayout compact_vertex_layout(uint32_t num_vertices, const glm::vec3* normals, const glm::vec2* texcoords) {
+    CompactFormat format;
+    format.include(num_vertices, texcoords);
+    return compact_vertex_layout(format, normals != nullptr, texcoords != nullptr);
+}
+
+std::vector<uint8_t> pack_compact_vertices(const VertexLayout& layout, uint32_t num_vertices, const glm::vec3* positions,
+        const glm::vec3* normals, const glm::vec2* texcoords) {
+    std::vector<uint8_t> data(size_t(layout.stride) * num_vertices);
+    const auto snorm10 = [](float v) { return uint32_t(int32_t(std::round(glm::clamp(v, -1.f, 1.f) * 511.f))) & 0x3FF; };
+    for (uint32_t i = 0; i < num_vertices; ++i) {
+        uint8_t* vertex = data.data() + size_t(layout.stride) * i;
+        for (const auto& attribute : layout.attributes) {
+            uint8_t* target = vertex + attribute.offset;
+            if (attribute.location == 0)
+                std::memcpy(target, &positions[i], sizeof(glm::vec3));
+            else if (attribute.type == GL_INT_2_10_10_10_REV) {
+                const uint32_t packed = snorm10(normals[i].x) | (snorm10(normals[i].y) << 10) | (snorm10(normals[i].z) << 20);
+                std::memcpy(target, &packed, sizeof(packed));
+            } else if (attribute.type == GL_UNSIGNED_SHORT) {
+                const uint16_t packed[2] = { glm::packUnorm1x16(texcoords[i].x), glm::packUnorm1x16(texcoords[i].y) };
+                std::memcpy(target, packed, sizeof(packed));
+            } else if (attribute.type == GL_HALF_FLOAT) {
+                const uint16_t packed[2] = { glm::packHalf1x16(texcoords[i].x), glm::packHalf1x16(texcoords[i].y) };
+                std::memcpy(target, packed, sizeof(packed));
+            } else
+                std::memcpy(target, &texcoords[i], sizeof(glm::vec2));
+        }
+    }
+    return data;
+}
+
 // ------------------------------------------
 // MeshImpl
 
-MeshImpl::MeshImpl(const std::string& name, const Geometry& geometry, const Material& material)
-    : name(name), geometry(geometry), material(material), vao(0), num_vertices(0), num_indices(0), primitive_type(GL_TRIANGLES) {
+bool MeshImpl::compact_vertex_format = true;
+
+MeshImpl::MeshImpl(const std::string& name, const Geometry& geometry, const Material& material, const CompactFormat* format)
+    : name(name), geometry(geometry), material(material), vao(0), num_vertices(0), num_indices(0), index_type(GL_UNSIGNED_INT),
+      primitive_type(GL_TRIANGLES), revision(0) {
     glGenVertexArrays(1, &vao);
-    upload_gpu();
+    upload_gpu(format);
 }
 
 MeshImpl::~MeshImpl() {
@@ -51,16 +152,23 @@ MeshImpl::~MeshImpl() {
 void MeshImpl::clear_gpu() {
     ibo = IBO();
     vbos.clear();
-    vbo_types.clear();
-    vbo_dims.clear();
+    vbo_layouts.clear();
     num_vertices = num_indices = 0;
+    index_type = GL_UNSIGNED_INT;
+    revision++;
 }
 
-void MeshImpl::upload_gpu() {
+void MeshImpl::upload_gpu(const CompactFormat* format) {
     if (!geometry) return;
     // free gpu resources
     clear_gpu();
     // (re-)upload data to GL
+    if (compact_vertex_format) {
+        add_compact_buffers(uint32_t(geometry->positions.size()), geometry->positions.data(),
+                geometry->has_normals() ? geometry->normals.data() : nullptr, geometry->has_texcoords() ? geometry->texcoords.data() : nullptr,
+                uint32_t(geometry->indices.size()), geometry->indices.data(), format);
+        return;
+    }
     add_vertex_buffer(GL_FLOAT, 3, uint32_t(geometry->positions.size()), geometry->positions.data());
     if (geometry->has_normals())
         add_vertex_buffer(GL_FLOAT, 3, uint32_t(geometry->normals.size()), geometry->normals.data());
@@ -77,11 +185,18 @@ void MeshImpl::bind(const Shader& shader) const {
 
 void MeshImpl::draw() const {
     if (ibo)
-        glDrawElements(primitive_type, num_indices, GL_UNSIGNED_INT, 0);
+        glDrawElements(primitive_type, num_indices, index_type, 0);
     else
         glDrawArrays(primitive_type, 0, num_vertices);
 }
 
+void MeshImpl::draw_instanced(uint32_t instances) const {
+    if (ibo)
+        glDrawElementsInstanced(primitive_type, num_indices, index_type, 0, instances);
+    else
+        glDrawArraysInstanced(primitive_type, 0, num_vertices, instances);
+}
+
 void MeshImpl::unbind() const {
     glBindVertexArray(0);
     if (material)
@@ -89,6 +204,12 @@ void MeshImpl::unbind() const {
 }
 
 uint32_t MeshImpl::add_vertex_buffer(GLenum type, uint32_t element_dim, uint32_t num_vertices, const void* data, GLenum hint) {
+    // one attribute per buffer, located at the buffer index
+    const VertexLayout layout = { type_to_bytes(type) * element_dim, { { GLuint(vbos.size()), GLint(element_dim), type, GL_FALSE, 0 } } };
+    return add_vertex_buffer(layout, num_vertices, data, hint);
+}
+
+uint32_t MeshImpl::add_vertex_buffer(const VertexLayout& layout, uint32_t num_vertices, const void* data, GLenum hint) {
     if (this->num_vertices && this->num_vertices != num_vertices)
         throw std::runtime_error("Mesh::add_vertex_buffer: vertex buffer size mismatch!");
     // setup vbo
@@ -96,28 +217,21 @@ uint32_t MeshImpl::add_vertex_buffer(GLenum type, uint32_t element_dim, uint32_t
 
     const uint32_t buf_id = vbos.size();
     vbos.emplace_back(name + "_vertex_buffer_" + std::to_string(buf_id));
-    vbos[buf_id]->upload_data(data, type_to_bytes(type) * element_dim * num_vertices, hint);
-    vbo_types.push_back(type);
-    vbo_dims.push_back(element_dim);
+    vbos[buf_id]->upload_data(data, size_t(layout.stride) * num_vertices, hint);
+    vbo_layouts.push_back(layout);
     // setup vertex attributes
     glBindVertexArray(vao);
-    vbos[buf_id]->bind();;
-    glEnableVertexAttribArray(buf_id);
-    if (type == GL_BYTE || type == GL_UNSIGNED_BYTE ||
-            type == GL_SHORT || type == GL_UNSIGNED_SHORT ||
-            type == GL_INT || type == GL_UNSIGNED_INT)
-        glVertexAttribIPointer(buf_id, element_dim, type, 0, 0);
-    else if (type == GL_DOUBLE)
-        glVertexAttribLPointer(buf_id, element_dim, type, 0, 0);
-    else
-        glVertexAttribPointer(buf_id, element_dim, type, GL_FALSE, 0, 0);
+    vbos[buf_id]->bind();
+    layout.setup();
     glBindVertexArray(0);
     vbos[buf_id]->unbind();
+    revision++;
     return buf_id;
 }
 
 void MeshImpl::add_index_buffer(uint32_t num_indices, const uint32_t* data, GLenum hint) {
     this->num_indices = num_indices;
+    index_type = GL_UNSIGNED_INT;
     ibo = IBO(name + "_index_buffer");
     ibo->upload_data(data, sizeof(uint32_t) * num_indices, hint);
     // setup vao+ibo
@@ -125,16 +239,53 @@ void MeshImpl::add_index_buffer(uint32_t num_indices, const uint32_t* data, GLen
     ibo->bind();
     glBindVertexArray(0);
     ibo->unbind();
+    revision++;
+}
+
+void MeshImpl::add_index_buffer(uint32_t num_indices, const uint16_t* data, GLenum hint) {
+    this->num_indices = num_indices;
+    index_type = GL_UNSIGNED_SHORT;
+    ibo = IBO(name + "_index_buffer");
+    ibo->upload_data(data, sizeof(uint16_t) * num_indices, hint);
+    // setup vao+ibo
+    glBindVertexArray(vao);
+    ibo->bind();
+    glBindVertexArray(0);
+    ibo->unbind();
+    revision++;
+}
+
+void MeshImpl::add_compact_buffers(uint32_t num_vertices, const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texcoords,
+        uint32_t num_indices, const uint32_t* indices, const CompactFormat* format) {
+    CompactFormat own_format;
+    if (!format) {
+        own_format.include(num_vertices, texcoords);
+        format = &own_format;
+    }
+    // a shared format must fit this mesh, e.g. after the geometry changed
+    CompactFormat fitting = *format;
+    fitting.include(num_vertices, texcoords);
+    if (fitting.texcoord_type != format->texcoord_type || fitting.index_type != format->index_type)
+        throw std::runtime_error("Mesh::add_compact_buffers: " + name + " does not fit the given compact format!");
+    const VertexLayout layout = compact_vertex_layout(*format, normals != nullptr, texcoords != nullptr);
+    add_vertex_buffer(layout, num_vertices, pack_compact_vertices(layout, num_vertices, positions, normals, texcoords).data());
+    if (format->index_type == GL_UNSIGNED_SHORT) {
+        const std::vector<uint16_t> short_indices(indices, indices + num_indices);
+        add_index_buffer(num_indices, short_indices.data());
+    } else
+        add_index_buffer(num_indices, indices);
 }
 
 void MeshImpl::update_vertex_buffer(uint32_t buf_id, const void* data) {
     if (buf_id >= vbos.size())
         throw std::runtime_error("Mesh::update_vertex_buffer: buffer id out of range!");
-    vbos[buf_id]->upload_subdata(data, 0, type_to_bytes(vbo_types[buf_id]) * vbo_dims[buf_id] * num_vertices);
+    vbos[buf_id]->upload_subdata(data, 0, size_t(vbo_layouts[buf_id].stride) * num_vertices);
+    revision++;
 }
 
 void MeshImpl::set_primitive_type(GLenum primitive_type) {
     this->primitive_type = primitive_type;
+    revision++;
 }
 
 void* MeshImpl::map_vbo(uint32_t buf_id, GLenum access) const {
@@ -147,6 +298,7 @@ void MeshImpl::unmap_vbo(uint32_t buf_id) const {
     if (buf_id >= vbos.size())
         throw std::runtime_error("Mesh::map_vbo: buffer id out of range!");
     vbos[buf_id]->unmap();
+    revision++;
 }
 
 void* MeshImpl::map_ibo(GLenum access) const {
@@ -157,16 +309,28 @@ void* MeshImpl::map_ibo(GLenum access) const {
 
 void MeshImpl::unmap_ibo() const {
     ibo->unmap();
+    revision++;
 }
 
 // ------------------------------------------
 // Mesh loader (Ass-Imp)
 
-std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path, bool normalize) {
+static const uint32_t import_flags = aiProcess_Triangulate | aiProcess_GenNormals;// | aiProcess_FlipUVs;
+
+// write the cache, failures only cost the speedup of the next load
+static void store_cache(const fs::path& path, bool normalize, const std::vector<std::pair<Geometry, Material>>& meshes) {
+    try {
+        mesh_cache_store(path, import_flags, normalize, meshes);
+    } catch (const std::exception& e) {
+        std::cerr << "WARN: unable to cache " << path << ": " << e.what() << std::endl;
+    }
+}
+
+static std::vector<std::pair<Geometry, Material>> load_meshes_assimp(const fs::path& path, bool normalize) {
     // load from disk
     Assimp::Importer importer;
     std::cout << "Loading: " << path << "..." << std::endl;
-    const aiScene* scene_ai = importer.ReadFile(path.string(), aiProcess_Triangulate | aiProcess_GenNormals);// | aiProcess_FlipUVs);
+    const aiScene* scene_ai = importer.ReadFile(path.string(), import_flags);
     if (!scene_ai) // handle error
         throw std::runtime_error("ERROR: Failed to load file: " + path.string() + "!");
     const std::string base_name = path.filename().replace_extension("").string();
@@ -176,9 +340,11 @@ std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path,
         const aiMesh* ai_mesh = scene_ai->mMeshes[i];
         geometries.push_back(Geometry(base_name + "_" + ai_mesh->mName.C_Str() + "_" + std::to_string(i), ai_mesh));
     }
+    // geometry passes run in parallel across meshes and vertex ranges
+    ThreadPool pool;
     // move and scale geometry to fit into [-1, 1]^3?
     if (normalize) {
-        glm::vec3 bb_min(FLT_MAX), bb_max(FLT_MIN);
+        glm::vec3 bb_min(FLT_MAX), bb_max(-FLT_MAX);
         for (const auto& geom : geometries) {
             bb_min = glm::min(bb_min, geom->bb_min);
             bb_max = glm::max(bb_max, geom->bb_max);
@@ -187,11 +353,51 @@ std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path,
         const glm::vec3 max = glm::vec3(1), min = glm::vec3(-1);
         const glm::vec3 scale_v = (max - min) / (bb_max - bb_min);
         const float scale_f = std::min(scale_v.x, std::min(scale_v.y, scale_v.z));
-        for (auto& geom : geometries) {
-            geom->translate(-center);
-            geom->scale(glm::vec3(scale_f));
-        }
+        transform_geometries(geometries, glm::scale(glm::mat4(1), glm::vec3(scale_f)) * glm::translate(glm::mat4(1), -center), &pool);
+    }
+    // optimize for the vertex cache and fetch, report the whole file
+    const bool compact = MeshImpl::compact_vertex_format;
+    double misses_before = 0, misses_after = 0, triangles = 0, vertices_before = 0, vertices_after = 0;
+    double vertex_bytes_before = 0, vertex_bytes_after = 0, index_bytes_after = 0;
+    std::vector<size_t> vertex_counts(geometries.size());
+    std::vector<GeometryOptimizationReport> reports(geometries.size());
+    for (size_t i = 0; i < geometries.size(); i++)
+        vertex_counts[i] = geometries[i]->positions.size();
+    pool.parallel_for(geometries.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            reports[i] = geometries[i]->optimize();
+    });
+    // one compact format for the file, so its meshes share a layout
+    CompactFormat format;
+    for (const auto& geom : geometries)
+        format.include(uint32_t(geom->positions.size()), geom->has_texcoords() ? geom->texcoords.data() : nullptr);
+    std::vector<VertexLayout> layouts;
+    for (size_t i = 0; i < geometries.size(); i++) {
+        const Geometry& geom = geometries[i];
+        const GeometryOptimizationReport& report = reports[i];
+        const double num_vertices = double(vertex_counts[i]), num_triangles = double(geom->indices.size() / 3);
+        const uint32_t float_stride = 12 + (geom->has_normals() ? 12 : 0) + (geom->has_texcoords() ? 8 : 0);
+        layouts.push_back(compact ? compact_vertex_layout(format, geom->has_normals(), geom->has_texcoords()) : VertexLayout{ float_stride, {} });
+        const uint32_t stride = layouts.back().stride;
+        misses_before += report.acmr_before * num_triangles;
+        misses_after += report.acmr_after * num_triangles;
+        triangles += num_triangles;
+        vertices_before += num_vertices;
+        vertices_after += double(geom->positions.size());
+        vertex_bytes_before += num_vertices * float_stride;
+        vertex_bytes_after += double(geom->positions.size()) * stride;
+        index_bytes_after += num_triangles * 3 * (compact && format.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
     }
+    // a GeometryArena batches the meshes with the most common layout, the others are drawn one by one
+    size_t batchable = 0;
+    for (const auto& layout : layouts)
+        batchable = std::max(batchable, size_t(std::count(layouts.begin(), layouts.end(), layout)));
+    if (triangles > 0 && vertices_after > 0)
+        std::cout << "Optimized: ACMR " << misses_before / triangles << " -> " << misses_after / triangles
+            << ", ATVR " << misses_before / vertices_before << " -> " << misses_after / vertices_after
+            << ", bytes per vertex " << vertex_bytes_before / vertices_before << " -> " << vertex_bytes_after / vertices_after
+            << ", per index 4 -> " << index_bytes_after / (triangles * 3)
+            << ", " << layouts.size() - batchable << " of " << layouts.size() << " meshes with another layout than the rest (not batched)" << std::endl;
     // load materials
     std::vector<Material> materials;
     for (uint32_t i = 0; i < scene_ai->mNumMaterials; ++i) {
@@ -206,11 +412,37 @@ std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path,
     return result;
 }
 
-std::vector<Mesh> load_meshes_gpu(const fs::path& path, bool normalize) {
+std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path, bool normalize, bool use_cache) {
+    if (use_cache) {
+        const MeshCache cache(path, import_flags, normalize);
+        if (cache) {
+            std::cout << "Loading: " << path << " (cached)..." << std::endl;
+            return cache.load_cpu();
+        }
+    }
+    const auto meshes = load_meshes_assimp(path, normalize);
+    if (use_cache) store_cache(path, normalize, meshes);
+    return meshes;
+}
+
+std::vector<Mesh> load_meshes_gpu(const fs::path& path, bool normalize, bool use_cache) {
+    // upload straight from the mapped cache
+    if (use_cache) {
+        const MeshCache cache(path, import_flags, normalize);
+        if (cache) {
+            std::cout << "Loading: " << path << " (cached)..." << std::endl;
+            return cache.load_gpu();
+        }
+    }
     // build meshes from cpu data
+    const auto loaded = load_meshes_assimp(path, normalize);
+    if (use_cache) store_cache(path, normalize, loaded);
     std::vector<Mesh> meshes;
-    for (const auto& [geometry, material] : load_meshes_cpu(path, normalize))
-        meshes.push_back(Mesh(geometry->name + "/" + material->name, geometry, material));
+    CompactFormat format;
+    for (const auto& [geometry, material] : loaded)
+        format.include(uint32_t(geometry->positions.size()), geometry->has_texcoords() ? geometry->texcoords.data() : nullptr);
+    for (const auto& [geometry, material] : loaded)
+        meshes.push_back(Mesh(geometry->name + "/" + material->name, geometry, material, &format));
     return meshes;
 }
 
@@ -14,12 +14,52 @@ namespace fs = std::filesystem;
 
 CPPGL_NAMESPACE_BEGIN
 
+// ------------------------------------------
+// Vertex layout of a vertex buffer
+
+struct VertexAttribute {
+    GLuint location;
+    GLint dim;
+    GLenum type;
+    GLboolean normalized;   // for integer types read as float
+    uint32_t offset;        // bytes from the start of a vertex
+    bool operator==(const VertexAttribute& other) const;
+};
+
+struct VertexLayout {
+    uint32_t stride;        // bytes per vertex
+    std::vector<VertexAttribute> attributes;
+    bool operator==(const VertexLayout& other) const;
+    inline bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+    // set the attribute pointers of the bound vertex array to the bound GL_ARRAY_BUFFER
+    void setup() const;
+};
+
+// Compact layout: one interleaved buffer with the position (3 float), the normal (GL_INT_2_10_10_10_REV, normalized)
+// and the texcoord (2 normalized unsigned shorts if all texcoords are in [0, 1], 2 half floats if within [-1, 1],
+// else 2 floats); normals and texcoords are optional (null)
+// the texcoord and index types are chosen once for all meshes of a file, so they share the vertex layout and index type
+// and can be batched in a GeometryArena
+struct CompactFormat {
+    GLenum texcoord_type = GL_UNSIGNED_SHORT;   // GL_UNSIGNED_SHORT, GL_HALF_FLOAT or GL_FLOAT
+    GLenum index_type = GL_UNSIGNED_SHORT;      // GL_UNSIGNED_SHORT while all meshes have at most 65536 vertices
+    // widen the types to fit the mesh
+    void include(uint32_t num_vertices, const glm::vec2* texcoords);
+};
+VertexLayout compact_vertex_layout(const CompactFormat& format, bool normals, bool texcoords);
+// layout with the narrowest types for a single mesh
+VertexLayout compact_vertex_layout(uint32_t num_vertices, const glm::vec3* normals, const glm::vec2* texcoords);
+// interleave and quantize vertices into the given compact layout
+std::vector<uint8_t> pack_compact_vertices(const VertexLayout& layout, uint32_t num_vertices, const glm::vec3* positions,
+        const glm::vec3* normals, const glm::vec2* texcoords);
+
 // ------------------------------------------
 // Mesh
 
 class MeshImpl {
 public:
-    MeshImpl(const std::string& name, const Geometry& geometry = Geometry(), const Material& material = Material());
+    // format: compact format of the upload (only used with compact_vertex_format), null for the narrowest types of this mesh
+    MeshImpl(const std::string& name, const Geometry& geometry = Geometry(), const Material& material = Material(), const CompactFormat* format = nullptr);
     virtual ~MeshImpl();
 
     // prevent copies and moves, since GL buffers aren't reference counted
@@ -28,16 +68,22 @@ public:
     MeshImpl& operator=(const MeshImpl&&) = delete;
 
     void clear_gpu(); // free gpu resources
-    void upload_gpu(); // cpu -> gpu transfer
+    void upload_gpu(const CompactFormat* format = nullptr); // cpu -> gpu transfer
 
     // call in this order to draw
     void bind(const Shader& shader) const;
     void draw() const;
+    void draw_instanced(uint32_t instances) const;
     void unbind() const;
 
     // GL vertex and index buffer operations
     uint32_t add_vertex_buffer(GLenum type, uint32_t element_dim, uint32_t num_vertices, const void* data, GLenum hint = GL_STATIC_DRAW);
+    uint32_t add_vertex_buffer(const VertexLayout& layout, uint32_t num_vertices, const void* data, GLenum hint = GL_STATIC_DRAW);
     void add_index_buffer(uint32_t num_indices, const uint32_t* data, GLenum hint = GL_STATIC_DRAW);
+    void add_index_buffer(uint32_t num_indices, const uint16_t* data, GLenum hint = GL_STATIC_DRAW);
+    // add the vertices in the compact layout (see above) and the indices as 16 bit if all fit, or as given by format
+    void add_compact_buffers(uint32_t num_vertices, const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texcoords,
+            uint32_t num_indices, const uint32_t* indices, const CompactFormat* format = nullptr);
     void update_vertex_buffer(uint32_t buf_id, const void* data); // assumes matching size for buffer buf_id from add_vertex_buffer()
     void set_primitive_type(GLenum type); // default: GL_TRIANGLES
 
@@ -57,9 +103,14 @@ public:
     uint32_t num_vertices;
     uint32_t num_indices;
     std::vector<VBO> vbos;
-    std::vector<GLenum> vbo_types;
-    std::vector<uint32_t> vbo_dims;
+    std::vector<VertexLayout> vbo_layouts;
+    GLenum index_type;      // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
     GLenum primitive_type;
+    // incremented on every change of the GPU data, allows to detect changes (mutable: unmapping counts as a change as well)
+    mutable uint64_t revision;
+
+    // upload_gpu() and the mesh loaders use the compact layout instead of one float buffer per attribute (default: true)
+    static bool compact_vertex_format;
 };
 
 using Mesh = NamedHandle<MeshImpl>;
@@ -67,8 +118,11 @@ template class _API NamedHandle<MeshImpl>; //needed for Windows DLL export
 
 // ------------------------------------------
 // Mesh loader (Ass-Imp)
+// Assimp loads the source and the geometry is optimized (see GeometryImpl::optimize)
+// with use_cache (opt-in, writes files), meshes are loaded from a binary cache next to the source or in the directory of
+// set_mesh_cache_directory if it is up to date (see mesh_cache.h), otherwise the cache is (re-)written after loading
 
-std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path, bool normalize = false);
-std::vector<Mesh> load_meshes_gpu(const fs::path& path, bool normalize = false);
+std::vector<std::pair<Geometry, Material>> load_meshes_cpu(const fs::path& path, bool normalize = false, bool use_cache = false);
+std::vector<Mesh> load_meshes_gpu(const fs::path& path, bool normalize = false, bool use_cache = false);
 
 CPPGL_NAMESPACE_END
@@ -0,0 +1,349 @@
+#include "mesh_cache.h"
+#include "texture_loader.h"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CPPGL_NAMESPACE_BEGIN
+
+// ------------------------------------------
+// file layout helpers
+
+static const char mesh_cache_magic[8] = { 'C', 'P', 'P', 'G', 'L', 'M', 'S', 'H' };
+// vertex and index arrays start at multiples of this (relative to the page aligned mapping)
+static const size_t mesh_cache_alignment = 16;
+
+static fs::path mesh_cache_dir;
+
+struct MeshCacheKey {
+    std::string source;
+    int64_t mtime;
+    uint64_t size;
+};
+
+static MeshCacheKey mesh_cache_key(const fs::path& source) {
+    return MeshCacheKey{ fs::absolute(source).lexically_normal().string(),
+        int64_t(fs::last_write_time(source).time_since_epoch().count()), uint64_t(fs::file_size(source)) };
+}
+
+class CacheWriter {
+public:
+    CacheWriter(const fs::path& path) : out(path, std::ios::binary), offset(0) {
+        if (!out) throw std::runtime_error("MeshCache: unable to write " + path.string());
+    }
+    void bytes(const void* data, size_t size) {
+        out.write((const char*)data, size);
+        offset += size;
+    }
+    template <typename T> void value(const T& v) { bytes(&v, sizeof(T)); }
+    void string(const std::string& str) {
+        value(uint32_t(str.size()));
+        bytes(str.data(), str.size());
+    }
+    void array(const void* data, size_t size) {
+        static const char zeros[mesh_cache_alignment] = { 0 };
+        bytes(zeros, (mesh_cache_alignment - offset % mesh_cache_alignment) % mesh_cache_alignment);
+        bytes(data, size);
+    }
+    bool good() const { return bool(out); }
+
+private:
+    std::ofstream out;
+    size_t offset;
+};
+
+class CacheReader {
+public:
+    CacheReader(const uint8_t* data, size_t size) : data(data), size(size), offset(0) {}
+    const void* bytes(size_t count) {
+        if (count > size - offset) throw std::runtime_error("MeshCache: truncated file");
+        const void* ptr = data + offset;
+        offset += count;
+        return ptr;
+    }
+    template <typename T> T value() {
+        T v;
+        std::memcpy(&v, bytes(sizeof(T)), sizeof(T));
+        return v;
+    }
+    std::string string() {
+        const uint32_t length = value<uint32_t>();
+        return std::string((const char*)bytes(length), length);
+    }
+    const void* array(size_t size) {
+        bytes((mesh_cache_alignment - offset % mesh_cache_alignment) % mesh_cache_alignment);
+        return bytes(size);
+    }
+
+private:
+    const uint8_t* data;
+    const size_t size;
+    size_t offset;
+};
+
+// ------------------------------------------
+// store
+
+void set_mesh_cache_directory(const fs::path& dir) {
+    mesh_cache_dir = dir;
+}
+
+fs::path mesh_cache_path(const fs::path& source) {
+    return (mesh_cache_dir.empty() ? source.parent_path() : mesh_cache_dir) / (source.filename().string() + ".meshcache");
+}
+
+// color of a 1x1 fallback texture (see MaterialImpl)
+static glm::vec3 texture_color(const Texture2D& texture) {
+    glm::vec3 color(0);
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, &color.x);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return color;
+}
+
+void mesh_cache_store(const fs::path& source, uint32_t import_flags, bool normalize, const std::vector<std::pair<Geometry, Material>>& meshes) {
+    const MeshCacheKey key = mesh_cache_key(source);
+    std::vector<Material> materials;
+    std::vector<uint32_t> material_index;
+    for (const auto& [geometry, material] : meshes) {
+        const auto it = std::find_if(materials.begin(), materials.end(), [&](const Material& m) { return m.ptr == material.ptr; });
+        material_index.push_back(uint32_t(it - materials.begin()));
+        if (it == materials.end()) materials.push_back(material);
+    }
+
+    // write to a temporary file first, so an interrupted write never leaves a corrupt cache behind
+    const fs::path path = mesh_cache_path(source);
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        CacheWriter out(tmp);
+        out.bytes(mesh_cache_magic, sizeof(mesh_cache_magic));
+        out.value(MESH_CACHE_VERSION);
+        out.value(import_flags);
+        out.value(uint32_t(normalize));
+        out.value(uint32_t(materials.size()));
+        out.value(uint32_t(meshes.size()));
+        out.value(key.mtime);
+        out.value(key.size);
+        out.string(key.source);
+
+        for (const auto& material : materials) {
+            out.string(material->name);
+            out.value(uint32_t(material->ints().size()));
+            for (const auto& [name, v] : material->ints()) { out.string(name); out.value(v); }
+            out.value(uint32_t(material->floats().size()));
+            for (const auto& [name, v] : material->floats()) { out.string(name); out.value(v); }
+            out.value(uint32_t(material->vec2s().size()));
+            for (const auto& [name, v] : material->vec2s()) { out.string(name); out.value(v); }
+            out.value(uint32_t(material->vec3s().size()));
+            for (const auto& [name, v] : material->vec3s()) { out.string(name); out.value(v); }
+            out.value(uint32_t(material->vec4s().size()));
+            for (const auto& [name, v] : material->vec4s()) { out.string(name); out.value(v); }
+            out.value(uint32_t(material->textures().size()));
+            for (const auto& [uniform, texture] : material->textures()) {
+                out.string(uniform);
+                out.string(texture->name);
+                out.string(texture->loaded_from_path.empty() ? std::string() : fs::absolute(texture->loaded_from_path).string());
+                out.value(texture->loaded_from_path.empty() ? texture_color(texture) : glm::vec3(0));
+            }
+        }
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Geometry& geometry = meshes[i].first;
+            const uint32_t num_vertices = uint32_t(geometry->positions.size());
+            const bool normals = geometry->normals.size() == num_vertices && num_vertices > 0;
+            const bool texcoords = geometry->texcoords.size() == num_vertices && num_vertices > 0;
+            out.string(geometry->name);
+            out.value(geometry->bb_min);
+            out.value(geometry->bb_max);
+            out.value(num_vertices);
+            out.value(uint32_t(geometry->indices.size()));
+            out.value(uint32_t(normals) | uint32_t(texcoords) << 1);
+            out.value(material_index[i]);
+            out.array(geometry->positions.data(), num_vertices * sizeof(glm::vec3));
+            if (normals) out.array(geometry->normals.data(), num_vertices * sizeof(glm::vec3));
+            if (texcoords) out.array(geometry->texcoords.data(), num_vertices * sizeof(glm::vec2));
+            out.array(geometry->indices.data(), geometry->indices.size() * sizeof(uint32_t));
+        }
+        if (!out.good())
+            throw std::runtime_error("MeshCache: unable to write " + tmp.string());
+    }
+    fs::rename(tmp, path);
+}
+
+// ------------------------------------------
+// MeshCache
+
+MeshCache::MeshCache(const fs::path& source, uint32_t import_flags, bool normalize)
+    : valid(false), data(nullptr), size(0), mapping(nullptr) {
+    const fs::path path = mesh_cache_path(source);
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return;
+
+    // map the whole file read-only
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER file_size;
+    HANDLE map = GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (map) {
+        mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(map);
+    }
+    CloseHandle(file);
+    if (!mapping) return;
+    size = size_t(file_size.QuadPart);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) mapping = nullptr;
+        else madvise(mapping, size_t(st.st_size), MADV_WILLNEED);
+    }
+    close(fd);
+    if (!mapping) return;
+    size = size_t(st.st_size);
+#endif
+    data = (const uint8_t*)mapping;
+
+    try {
+        // check the key
+        CacheReader in(data, size);
+        const MeshCacheKey key = mesh_cache_key(source);
+        if (std::memcmp(in.bytes(sizeof(mesh_cache_magic)), mesh_cache_magic, sizeof(mesh_cache_magic)) != 0) return;
+        if (in.value<uint32_t>() != MESH_CACHE_VERSION) return;
+        if (in.value<uint32_t>() != import_flags) return;
+        if (in.value<uint32_t>() != uint32_t(normalize)) return;
+        const uint32_t num_materials = in.value<uint32_t>();
+        const uint32_t num_meshes = in.value<uint32_t>();
+        if (in.value<int64_t>() != key.mtime || in.value<uint64_t>() != key.size || in.string() != key.source) return;
+
+        // index contents, vertex data stays in the mapping
+        materials.resize(num_materials);
+        for (auto& material : materials) {
+            material.name = in.string();
+            material.ints.resize(in.value<uint32_t>());
+            for (auto& [name, v] : material.ints) { name = in.string(); v = in.value<int>(); }
+            material.floats.resize(in.value<uint32_t>());
+            for (auto& [name, v] : material.floats) { name = in.string(); v = in.value<float>(); }
+            material.vec2s.resize(in.value<uint32_t>());
+            for (auto& [name, v] : material.vec2s) { name = in.string(); v = in.value<glm::vec2>(); }
+            material.vec3s.resize(in.value<uint32_t>());
+            for (auto& [name, v] : material.vec3s) { name = in.string(); v = in.value<glm::vec3>(); }
+            material.vec4s.resize(in.value<uint32_t>());
+            for (auto& [name, v] : material.vec4s) { name = in.string(); v = in.value<glm::vec4>(); }
+            material.textures.resize(in.value<uint32_t>());
+            for (auto& texture : material.textures) {
+                texture.uniform = in.string();
+                texture.name = in.string();
+                texture.path = in.string();
+                texture.color = in.value<glm::vec3>();
+            }
+        }
+        meshes.resize(num_meshes);
+        for (auto& mesh : meshes) {
+            mesh.name = in.string();
+            mesh.bb_min = in.value<glm::vec3>();
+            mesh.bb_max = in.value<glm::vec3>();
+            mesh.num_vertices = in.value<uint32_t>();
+            mesh.num_indices = in.value<uint32_t>();
+            const uint32_t flags = in.value<uint32_t>();
+            mesh.material = in.value<uint32_t>();
+            if (mesh.material >= num_materials) return;
+            mesh.positions = (const glm::vec3*)in.array(size_t(mesh.num_vertices) * sizeof(glm::vec3));
+            mesh.normals = flags & 1 ? (const glm::vec3*)in.array(size_t(mesh.num_vertices) * sizeof(glm::vec3)) : nullptr;
+            mesh.texcoords = flags & 2 ? (const glm::vec2*)in.array(size_t(mesh.num_vertices) * sizeof(glm::vec2)) : nullptr;
+            mesh.indices = (const uint32_t*)in.array(size_t(mesh.num_indices) * sizeof(uint32_t));
+        }
+        valid = true;
+    } catch (const std::exception& e) {
+        std::cerr << "WARN: ignoring mesh cache " << path << ": " << e.what() << std::endl;
+    }
+}
+
+MeshCache::~MeshCache() {
+    if (!mapping) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
+std::vector<Material> MeshCache::load_materials() const {
+    std::vector<Material> result;
+    for (const auto& entry : materials) {
+        Material material = Material(entry.name);
+        for (const auto& [key, value] : entry.ints) material->set_int(key, value);
+        for (const auto& [key, value] : entry.floats) material->set_float(key, value);
+        for (const auto& [key, value] : entry.vec2s) material->set_vec2(key, value);
+        for (const auto& [key, value] : entry.vec3s) material->set_vec3(key, value);
+        for (const auto& [key, value] : entry.vec4s) material->set_vec4(key, value);
+        for (const auto& texture : entry.textures) {
+            if (texture.path.empty())
+                material->add_texture(texture.uniform, Texture2D(texture.name, 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT, &texture.color.x));
+            else
+                material->add_texture(texture.uniform, TextureLoader::load(texture.name, texture.path));
+        }
+        result.push_back(material);
+    }
+    return result;
+}
+
+std::vector<std::pair<Geometry, Material>> MeshCache::load_cpu() const {
+    const std::vector<Material> materials = load_materials();
+    std::vector<std::pair<Geometry, Material>> result;
+    for (const auto& mesh : meshes) {
+        Geometry geometry = Geometry(mesh.name);
+        geometry->positions.assign(mesh.positions, mesh.positions + mesh.num_vertices);
+        if (mesh.normals) geometry->normals.assign(mesh.normals, mesh.normals + mesh.num_vertices);
+        if (mesh.texcoords) geometry->texcoords.assign(mesh.texcoords, mesh.texcoords + mesh.num_vertices);
+        geometry->indices.assign(mesh.indices, mesh.indices + mesh.num_indices);
+        geometry->bb_min = mesh.bb_min;
+        geometry->bb_max = mesh.bb_max;
+        result.push_back(std::make_pair(geometry, materials[mesh.material]));
+    }
+    return result;
+}
+
+std::vector<Mesh> MeshCache::load_gpu() const {
+    const std::vector<Material> materials = load_materials();
+    // one compact format for the file, so its meshes share a layout (see load_meshes_gpu)
+    CompactFormat format;
+    for (const auto& entry : meshes)
+        format.include(entry.num_vertices, entry.texcoords);
+    std::vector<Mesh> result;
+    for (const auto& entry : meshes) {
+        Geometry geometry = Geometry(entry.name);
+        geometry->bb_min = entry.bb_min;
+        geometry->bb_max = entry.bb_max;
+        const Material& material = materials[entry.material];
+        // the geometry holds no vertices, so the constructor uploads nothing
+        Mesh mesh = Mesh(entry.name + "/" + material->name, geometry, material);
+        // the compact layout is packed from the mapping, the float layout is uploaded from it directly
+        if (MeshImpl::compact_vertex_format)
+            mesh->add_compact_buffers(entry.num_vertices, entry.positions, entry.normals, entry.texcoords, entry.num_indices, entry.indices, &format);
+        else {
+            mesh->add_vertex_buffer(GL_FLOAT, 3, entry.num_vertices, entry.positions);
+            if (entry.normals) mesh->add_vertex_buffer(GL_FLOAT, 3, entry.num_vertices, entry.normals);
+            if (entry.texcoords) mesh->add_vertex_buffer(GL_FLOAT, 2, entry.num_vertices, entry.texcoords);
+            mesh->add_index_buffer(entry.num_indices, entry.indices);
+        }
+        result.push_back(mesh);
+    }
+    return result;
+}
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+namespace fs = std::filesystem;
+#include "mesh.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// ------------------------------------------
+// Binary mesh cache
+// Stores the (normalized) geometry and materials loaded by Assimp, keyed on the absolute source path, its modification
+// time and size, the Assimp import flags and normalization. Caches are memory-mapped and uploaded from the mapping
+// (packed into the compact vertex layout on the way if MeshImpl::compact_vertex_format is set).
+// Note: only the source file is part of the key, changes to referenced files (e.g. .mtl) require deleting the cache.
+
+// bump on every change of the file layout or of the stored geometry (2: optimized vertex and triangle order, 3: fixed bounds)
+const uint32_t MESH_CACHE_VERSION = 3;
+
+// directory for cache files, default (empty): next to the source file
+void set_mesh_cache_directory(const fs::path& dir);
+fs::path mesh_cache_path(const fs::path& source);
+
+// write the cache for meshes loaded from source (replaces the file atomically)
+void mesh_cache_store(const fs::path& source, uint32_t import_flags, bool normalize, const std::vector<std::pair<Geometry, Material>>& meshes);
+
+class MeshCache {
+public:
+    // map the cache of source, evaluates to false if it is missing, outdated or corrupt
+    MeshCache(const fs::path& source, uint32_t import_flags, bool normalize);
+    virtual ~MeshCache();
+
+    // prevent copies and moves, since mappings aren't reference counted
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    explicit inline operator bool() const { return valid; }
+
+    // geometry with CPU data
+    std::vector<std::pair<Geometry, Material>> load_cpu() const;
+    // meshes uploaded straight from the mapping, their geometry only holds name and AABB
+    std::vector<Mesh> load_gpu() const;
+
+private:
+    struct TextureEntry {
+        std::string uniform, name;
+        fs::path path;          // empty for 1x1 fallback textures
+        glm::vec3 color;        // color of 1x1 fallback textures
+    };
+    struct MaterialEntry {
+        std::string name;
+        std::vector<std::pair<std::string, int>> ints;
+        std::vector<std::pair<std::string, float>> floats;
+        std::vector<std::pair<std::string, glm::vec2>> vec2s;
+        std::vector<std::pair<std::string, glm::vec3>> vec3s;
+        std::vector<std::pair<std::string, glm::vec4>> vec4s;
+        std::vector<TextureEntry> textures;
+    };
+    struct MeshEntry {
+        std::string name;
+        glm::vec3 bb_min, bb_max;
+        uint32_t num_vertices, num_indices;
+        const glm::vec3* positions;
+        const glm::vec3* normals;       // null if not present
+        const glm::vec2* texcoords;     // null if not present
+        const uint32_t* indices;
+        uint32_t material;
+    };
+
+    std::vector<Material> load_materials() const;
+
+    // data
+    bool valid;
+    const uint8_t* data;
+    size_t size;
+    void* mapping;
+    std::vector<MaterialEntry> materials;
+    std::vector<MeshEntry> meshes;
+};
+
+CPPGL_NAMESPACE_END
@@ -2,8 +2,11 @@
 
 #include <map>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
@@ -15,6 +18,22 @@ CPPGL_NAMESPACE_BEGIN
 template <typename T, typename = int> struct HasName : std::false_type {};
 template <typename T> struct HasName <T, decltype((void) T::name, 0)> : std::true_type {};
 
+// stable id of a registered object: its slot in the registry and the generation of the slot at registration
+// ids of erased (or replaced) objects go stale instead of referring to whatever reuses the slot
+struct HandleId {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+    inline explicit operator bool() const { return index != UINT32_MAX; }
+    inline bool operator==(const HandleId& other) const { return index == other.index && generation == other.generation; }
+    inline bool operator!=(const HandleId& other) const { return !(*this == other); }
+};
+
+// Objects are registered twice: by name in map (slow path for tooling and setup) and in a slot registry, which hands out
+// HandleIds for O(1) lookups (get) and keeps all objects in a dense array for iteration (all).
+// Creating and erasing objects is locked. get() does not lock: slots live in pages that never move, so it is safe
+// while other objects are created, but not while they are erased or replaced (erasing drops the registry's references,
+// which may destroy the object get() returns). Debug builds assert this. all(), begin() and end() are not locked and
+// only for use while no other thread creates or erases objects.
 template <typename T> class NamedHandle {
 public:
     // "default" construct
@@ -24,10 +43,15 @@ public:
     template <class... Args> NamedHandle(const std::string& name, Args&&... args) : ptr(std::make_shared<T>(name, args...)) {
         static_assert(HasName<T>::value, "Template type T is required to have a member \"name\"!");
         static_assert(std::is_same<decltype(T::name), std::string>::value || std::is_same<decltype(T::name), const std::string>::value, "bad type bro");
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto replaced = map.find(ptr->name);
+        const EraseScope scope(replaced != map.end());
 #ifndef NDEBUG
-        if (map.count(ptr->name)) std::cerr << "Warning: Name \"" << ptr->name << "\" is not unique!" << std::endl;
+        if (replaced != map.end()) std::cerr << "Warning: Name \"" << ptr->name << "\" is not unique!" << std::endl;
 #endif
-        const std::lock_guard<std::mutex> lock(mutex);
+        if (replaced != map.end()) release(replaced->second.id);
+        id = acquire(ptr.get());
+        dense.push_back(*this);
         map[ptr->name] = *this;
     }
 
@@ -56,27 +80,116 @@ public:
         const std::lock_guard<std::mutex> lock(mutex);
         return map[name];
     }
+    // return registered object for given id, nullptr if it was erased or replaced
+    // the pointer is not owning: it stays valid until the object is erased or replaced, which must not happen concurrently
+    // (keep a NamedHandle copy, e.g. from find(), to use an object across erasures)
+    static T* get(const HandleId& id) {
+        assert(erasing.load(std::memory_order_relaxed) == 0 && "NamedHandle::get() while an object is erased");
+        if (id.index >= SLOT_PAGE_SIZE * SLOT_PAGES) return nullptr;
+        const Slot* page = slot_pages[id.index / SLOT_PAGE_SIZE].get();
+        if (!page) return nullptr;
+        const Slot& slot = page[id.index % SLOT_PAGE_SIZE];
+        // release() bumps the generation before clearing the object, so check the generation after loading it
+        T* object = slot.object.load(std::memory_order_acquire);
+        const bool current = slot.generation.load(std::memory_order_acquire) == id.generation;
+        assert(erasing.load(std::memory_order_relaxed) == 0 && "NamedHandle::get() while an object is erased");
+        return current ? object : nullptr;
+    }
+    // all registered objects, contiguous in creation order until something is erased (erasing moves the last object
+    // into the gap), unlike begin()/end() not sorted by name. Not locked: only while no other thread creates or erases
+    static const std::vector<NamedHandle<T>>& all() { return dense; }
     // remove element from map for given name
     static void erase(const std::string& name) {
-        map.erase(name);
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto it = map.find(name);
+        if (it == map.end()) return;
+        const EraseScope scope;
+        release(it->second.id);
+        map.erase(it);
     }
     // clear saved handles and free unsused memory
     static void clear() {
         const std::lock_guard<std::mutex> lock(mutex);
+        const EraseScope scope;
+        while (!dense.empty())
+            release(dense.back().id);
         map.clear();
     }
 
-    // iterators to iterate over all entries
+    // iterators to iterate over all entries by name. Not locked: only while no other thread creates or erases
     static typename std::map<std::string, NamedHandle<T>>::iterator begin() { return map.begin(); }
     static typename std::map<std::string, NamedHandle<T>>::iterator end() { return map.end(); }
 
     std::shared_ptr<T> ptr;
+    HandleId id;
     static std::mutex mutex;
     static std::map<std::string, NamedHandle<T>> map;
+
+private:
+    struct Slot {
+        std::atomic<T*> object { nullptr };
+        std::atomic<uint32_t> generation { 0 };
+        uint32_t dense = 0;     // index into dense while occupied
+    };
+    static constexpr uint32_t SLOT_PAGE_SIZE = 1024, SLOT_PAGES = 1024;
+
+    // occupy a free slot (mutex held)
+    static HandleId acquire(T* object) {
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            if (slot_count == SLOT_PAGE_SIZE * SLOT_PAGES)
+                throw std::runtime_error("NamedHandle: too many objects");
+            index = slot_count++;
+            auto& page = slot_pages[index / SLOT_PAGE_SIZE];
+            if (!page) page.reset(new Slot[SLOT_PAGE_SIZE]);
+        }
+        Slot& slot = slot_pages[index / SLOT_PAGE_SIZE][index % SLOT_PAGE_SIZE];
+        slot.dense = uint32_t(dense.size());
+        slot.object.store(object, std::memory_order_release);
+        dense_slots.push_back(index);
+        return HandleId{ index, slot.generation.load(std::memory_order_relaxed) };
+    }
+    // free the slot of id and remove its object from dense (mutex held), ignores stale ids
+    static void release(const HandleId& id) {
+        if (!id || id.index >= slot_count) return;
+        Slot& slot = slot_pages[id.index / SLOT_PAGE_SIZE][id.index % SLOT_PAGE_SIZE];
+        if (slot.generation.load(std::memory_order_relaxed) != id.generation || !slot.object.load(std::memory_order_relaxed)) return;
+        slot.generation.store(id.generation + 1, std::memory_order_release);
+        slot.object.store(nullptr, std::memory_order_release);
+        const uint32_t gap = slot.dense;
+        dense[gap] = std::move(dense.back());
+        dense_slots[gap] = dense_slots.back();
+        slot_pages[dense_slots[gap] / SLOT_PAGE_SIZE][dense_slots[gap] % SLOT_PAGE_SIZE].dense = gap;
+        dense.pop_back();
+        dense_slots.pop_back();
+        free_slots.push_back(id.index);
+    }
+    // counts an erasure or replacement while the registry drops its references to the object (mutex held)
+    struct EraseScope {
+        const bool active;
+        EraseScope(bool active = true) : active(active) { if (active) erasing.fetch_add(1, std::memory_order_relaxed); }
+        ~EraseScope() { if (active) erasing.fetch_sub(1, std::memory_order_relaxed); }
+    };
+
+    static std::unique_ptr<Slot[]> slot_pages[SLOT_PAGES];     // allocated on demand, never moved
+    static uint32_t slot_count;                                 // slots handed out so far
+    static std::vector<uint32_t> free_slots;
+    static std::vector<NamedHandle<T>> dense;                   // registered objects
+    static std::vector<uint32_t> dense_slots;                   // slot of each entry of dense
+    static std::atomic<uint32_t> erasing;                       // erasures in progress, checked by get() in debug builds
 };
 
 // definition of static members (compiler magic)
 template <typename T> std::mutex NamedHandle<T>::mutex;
 template <typename T> std::map<std::string, NamedHandle<T>> NamedHandle<T>::map;
+template <typename T> std::unique_ptr<typename NamedHandle<T>::Slot[]> NamedHandle<T>::slot_pages[NamedHandle<T>::SLOT_PAGES];
+template <typename T> uint32_t NamedHandle<T>::slot_count = 0;
+template <typename T> std::vector<uint32_t> NamedHandle<T>::free_slots;
+template <typename T> std::vector<NamedHandle<T>> NamedHandle<T>::dense;
+template <typename T> std::vector<uint32_t> NamedHandle<T>::dense_slots;
+template <typename T> std::atomic<uint32_t> NamedHandle<T>::erasing { 0 };
 
 CPPGL_NAMESPACE_END
@@ -18,86 +18,114 @@ void TimerQueryImpl::end() {
 }
 
 // -------------------------------------------------------
-// (GPU) TimerQueryGL (in ms)
+// QueryRingGL
+
+QueryRingGL::QueryRingGL(size_t slots, size_t queries_per_slot) : ids(slots * queries_per_slot), slots(slots), queries_per_slot(queries_per_slot), head(0), tail(0), pending(0) {
+    glGenQueries(GLsizei(ids.size()), ids.data());
+}
+
+QueryRingGL::~QueryRingGL() {
+    glDeleteQueries(GLsizei(ids.size()), ids.data());
+}
+
+GLuint* QueryRingGL::acquire() {
+    return pending < slots ? &ids[head * queries_per_slot] : nullptr;
+}
+
+void QueryRingGL::submit() {
+    head = (head + 1) % slots;
+    pending++;
+}
 
-TimerQueryGLImpl::TimerQueryGLImpl(const std::string& name, size_t samples) : Query(name, samples), start_time(0), stop_time(0){
-    glGenQueries(2, query_ids[0]);
-    glGenQueries(2, query_ids[1]);
-    glQueryCounter(query_ids[1][0], GL_TIMESTAMP);
-    glQueryCounter(query_ids[1][1], GL_TIMESTAMP);
+GLuint* QueryRingGL::available() {
+    if (pending == 0) return nullptr;
+    // queries complete in order, so the last one of the slot covers all of them
+    GLuint ready = GL_FALSE;
+    glGetQueryObjectuiv(ids[tail * queries_per_slot + queries_per_slot - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+    return ready ? &ids[tail * queries_per_slot] : nullptr;
 }
 
-TimerQueryGLImpl::~TimerQueryGLImpl() {
-    glDeleteQueries(2, query_ids[0]);
-    glDeleteQueries(2, query_ids[1]);
+void QueryRingGL::pop() {
+    tail = (tail + 1) % slots;
+    pending--;
 }
 
+// -------------------------------------------------------
+// (GPU) TimerQueryGL (in ms)
+
+TimerQueryGLImpl::TimerQueryGLImpl(const std::string& name, size_t samples, size_t latency) : Query(name, samples), ring(latency, 2), issued(nullptr), start_time(0), stop_time(0) {}
+
+TimerQueryGLImpl::~TimerQueryGLImpl() {}
+
 void TimerQueryGLImpl::begin() {
-    glQueryCounter(query_ids[0][0], GL_TIMESTAMP);
+    issued = ring.acquire();
+    if (issued) glQueryCounter(issued[0], GL_TIMESTAMP);
 }
 
 void TimerQueryGLImpl::end() {
-    glQueryCounter(query_ids[0][1], GL_TIMESTAMP);
-    std::swap(query_ids[0], query_ids[1]); // switch front/back buffer
-    glGetQueryObjectui64v(query_ids[0][0], GL_QUERY_RESULT, &start_time);
-    glGetQueryObjectui64v(query_ids[0][1], GL_QUERY_RESULT, &stop_time);
-    put(float((stop_time - start_time) / 1000000.0));
+    if (issued) {
+        glQueryCounter(issued[1], GL_TIMESTAMP);
+        ring.submit();
+        issued = nullptr;
+    }
+    for (GLuint* ids = ring.available(); ids; ids = ring.available()) {
+        glGetQueryObjectui64v(ids[0], GL_QUERY_RESULT, &start_time);
+        glGetQueryObjectui64v(ids[1], GL_QUERY_RESULT, &stop_time);
+        put(float((stop_time - start_time) / 1000000.0));
+        ring.pop();
+    }
 }
 
 // -------------------------------------------------------
 // (GPU) PrimitiveQueryGL
 
-PrimitiveQueryGLImpl::PrimitiveQueryGLImpl(const std::string& name, size_t samples) : Query(name, samples), start_time(0), stop_time(0) {
-    glGenQueries(2, query_ids);
-    // avoid error on first run
-    glBeginQuery(GL_PRIMITIVES_GENERATED, query_ids[0]);
-    glEndQuery(GL_PRIMITIVES_GENERATED);
-    glBeginQuery(GL_PRIMITIVES_GENERATED, query_ids[1]);
-    glEndQuery(GL_PRIMITIVES_GENERATED);
-}
+PrimitiveQueryGLImpl::PrimitiveQueryGLImpl(const std::string& name, size_t samples, size_t latency) : Query(name, samples), ring(latency, 1), issued(nullptr) {}
 
-PrimitiveQueryGLImpl::~PrimitiveQueryGLImpl() {
-    glDeleteQueries(2, query_ids);
-}
+PrimitiveQueryGLImpl::~PrimitiveQueryGLImpl() {}
 
 void PrimitiveQueryGLImpl::begin() {
-    glBeginQuery(GL_PRIMITIVES_GENERATED, query_ids[0]);
+    issued = ring.acquire();
+    if (issued) glBeginQuery(GL_PRIMITIVES_GENERATED, issued[0]);
 }
 
 void PrimitiveQueryGLImpl::end() {
-    glEndQuery(GL_PRIMITIVES_GENERATED);
-    std::swap(query_ids[0], query_ids[1]); // switch front/back buffer
-    GLuint result;
-    glGetQueryObjectuiv(query_ids[0], GL_QUERY_RESULT, &result);
-    put(float(result));
+    if (issued) {
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        ring.submit();
+        issued = nullptr;
+    }
+    for (GLuint* ids = ring.available(); ids; ids = ring.available()) {
+        GLuint result;
+        glGetQueryObjectuiv(ids[0], GL_QUERY_RESULT, &result);
+        put(float(result));
+        ring.pop();
+    }
 }
 
 // -------------------------------------------------------
 // (GPU) FragmentQueryGL
 
-FragmentQueryGLImpl::FragmentQueryGLImpl(const std::string& name, size_t samples) : Query(name, samples), start_time(0), stop_time(0) {
-    glGenQueries(2, query_ids);
-    // avoid error on first run
-    glBeginQuery(GL_SAMPLES_PASSED, query_ids[0]);
-    glEndQuery(GL_SAMPLES_PASSED);
-    glBeginQuery(GL_SAMPLES_PASSED, query_ids[1]);
-    glEndQuery(GL_SAMPLES_PASSED);
-}
+FragmentQueryGLImpl::FragmentQueryGLImpl(const std::string& name, size_t samples, size_t latency) : Query(name, samples), ring(latency, 1), issued(nullptr) {}
 
-FragmentQueryGLImpl::~FragmentQueryGLImpl() {
-    glDeleteQueries(2, query_ids);
-}
+FragmentQueryGLImpl::~FragmentQueryGLImpl() {}
 
 void FragmentQueryGLImpl::begin() {
-    glBeginQuery(GL_SAMPLES_PASSED, query_ids[0]);
+    issued = ring.acquire();
+    if (issued) glBeginQuery(GL_SAMPLES_PASSED, issued[0]);
 }
 
 void FragmentQueryGLImpl::end() {
-    glEndQuery(GL_SAMPLES_PASSED);
-    std::swap(query_ids[0], query_ids[1]); // switch front/back buffer
-    GLuint result;
-    glGetQueryObjectuiv(query_ids[0], GL_QUERY_RESULT, &result);
-    put(float(result));
+    if (issued) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        ring.submit();
+        issued = nullptr;
+    }
+    for (GLuint* ids = ring.available(); ids; ids = ring.available()) {
+        GLuint result;
+        glGetQueryObjectuiv(ids[0], GL_QUERY_RESULT, &result);
+        put(float(result));
+        ring.pop();
+    }
 }
 
 CPPGL_NAMESPACE_END
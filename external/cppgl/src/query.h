@@ -80,6 +80,32 @@ public:
     float exp_avg, last_val;
 };
 
+// -------------------------------------------------------
+// Ring of GL query slots, results are read back frames later once available (reading never stalls the pipeline)
+
+class QueryRingGL {
+public:
+    QueryRingGL(size_t slots, size_t queries_per_slot);
+    virtual ~QueryRingGL();
+
+    // prevent copies and moves, since GL queries aren't reference counted
+    QueryRingGL(const QueryRingGL&) = delete;
+    QueryRingGL& operator=(const QueryRingGL&) = delete;
+
+    // queries of the next slot to issue, nullptr if all slots still wait for their results (the sample is skipped)
+    GLuint* acquire();
+    // mark the acquired slot as issued
+    void submit();
+    // queries of the oldest issued slot if all of its results are available, nullptr otherwise (release with pop())
+    GLuint* available();
+    void pop();
+
+    // data
+    std::vector<GLuint> ids;
+    const size_t slots, queries_per_slot;
+    size_t head, tail, pending;
+};
+
 // -------------------------------------------------------
 // (CPU) TimerQuery (in ms)
 
@@ -103,7 +129,8 @@ template class _API NamedHandle<TimerQueryImpl>; //needed for Windows DLL export
 
 class TimerQueryGLImpl : public Query {
 public:
-    TimerQueryGLImpl(const std::string& name, size_t samples = 256);
+    // latency: number of measurements whose results may be pending before further samples are skipped
+    TimerQueryGLImpl(const std::string& name, size_t samples = 256, size_t latency = 8);
     virtual ~TimerQueryGLImpl();
 
     // prevent copies and moves, since GL buffers aren't reference counted
@@ -115,7 +142,8 @@ public:
     void end();
 
     // data
-    GLuint query_ids[2][2];
+    QueryRingGL ring;
+    GLuint* issued;
     GLuint64 start_time, stop_time;
 };
 
@@ -127,7 +155,7 @@ template class _API NamedHandle<TimerQueryGLImpl>; //needed for Windows DLL expo
 
 class PrimitiveQueryGLImpl : public Query {
 public:
-    PrimitiveQueryGLImpl(const std::string& name, size_t samples = 256);
+    PrimitiveQueryGLImpl(const std::string& name, size_t samples = 256, size_t latency = 8);
     virtual ~PrimitiveQueryGLImpl();
 
     // prevent copies and moves, since GL buffers aren't reference counted
@@ -139,8 +167,8 @@ public:
     void end();
 
     // data
-    GLuint query_ids[2];
-    GLuint64 start_time, stop_time;
+    QueryRingGL ring;
+    GLuint* issued;
 };
 
 using PrimitiveQueryGL = NamedHandle<PrimitiveQueryGLImpl>;
@@ -151,7 +179,7 @@ template class _API NamedHandle<PrimitiveQueryGLImpl>; //needed for Windows DLL
 
 class FragmentQueryGLImpl : public Query {
 public:
-    FragmentQueryGLImpl(const std::string& name, size_t samples = 256);
+    FragmentQueryGLImpl(const std::string& name, size_t samples = 256, size_t latency = 8);
     virtual ~FragmentQueryGLImpl();
 
     // prevent copies and moves, since GL buffers aren't reference counted
@@ -163,8 +191,8 @@ public:
     void end();
 
     // data
-    GLuint query_ids[2];
-    GLuint64 start_time, stop_time;
+    QueryRingGL ring;
+    GLuint* issued;
 };
 
 using FragmentQueryGL = NamedHandle<FragmentQueryGLImpl>;
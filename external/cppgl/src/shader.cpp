@@ -1,14 +1,48 @@
 #include "shader.h"
+#include "hash.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <set>
 #include <glm/gtc/type_ptr.hpp>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 CPPGL_NAMESPACE_BEGIN
 
+// per user cache directory: $XDG_CACHE_HOME or ~/.cache, %LOCALAPPDATA% on Windows, empty (no cache) if none is set
+// never a shared directory like the temp directory, where other users could plant binaries for a predictable key
+static fs::path default_program_cache_dir() {
+#if defined(_WIN32)
+    const char* local = std::getenv("LOCALAPPDATA");
+    return local && *local ? fs::path(local) / "cppgl" / "program_cache" : fs::path();
+#else
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return fs::path(xdg) / "cppgl" / "program_cache";
+    const char* home = std::getenv("HOME");
+    return home && *home ? fs::path(home) / ".cache" / "cppgl" / "program_cache" : fs::path();
+#endif
+}
+
 // paths where to search for shader files  
 std::vector<fs::path> ShaderImpl::shader_search_paths = {};  
+fs::path ShaderImpl::program_cache_dir = default_program_cache_dir();
+bool ShaderImpl::hot_reload = false;
+double ShaderImpl::reload_poll_interval = 0.5;
+
+// source of ShaderImpl::link_serial
+static uint64_t shader_link_serial = 0;
 
 // ----------------------------------------------------
 // helper funcs
@@ -47,7 +81,8 @@ static std::string get_log(GLuint object) {
     return error_string;
 }
 
-static GLuint compile_shader(GLenum type, ShaderImpl& impl) {
+// source of a stage with resolved includes and inserted defines, stores the file timestamps for reloads
+static std::string preprocess_shader(GLenum type, ShaderImpl& impl) {
     std::cout << "Loading: " << impl.source_files[type] << "..." << std::endl;
     std::string source = read_file(impl.source_files[type]);
     impl.timestamps[type] = fs::last_write_time(impl.source_files[type]);
@@ -56,7 +91,6 @@ static GLuint compile_shader(GLenum type, ShaderImpl& impl) {
 
     // handle single level of #include
     std::string::size_type inc_at;
-    impl.include_timestamps.clear();
     while ((inc_at = source.find("#include")) != std::string::npos) {
         auto inc_to = source.find("\n", inc_at);
         std::string inc_str = source.substr(inc_at, inc_to - inc_at);
@@ -91,7 +125,19 @@ static GLuint compile_shader(GLenum type, ShaderImpl& impl) {
         impl.include_timestamps[p] = fs::last_write_time(p);
     }
 
-    // actually compile shader
+    // insert #defines after the #version directive
+    if (!impl.defines.empty()) {
+        std::string define_str;
+        for (const auto& [define, value] : impl.defines)
+            define_str += "#define " + define + " " + value + "\n";
+        const auto version_at = source.find("#version");
+        const auto insert_at = version_at == std::string::npos ? 0 : source.find("\n", version_at) + 1;
+        source.insert(insert_at, define_str);
+    }
+    return source;
+}
+
+static GLuint compile_shader(GLenum type, const std::string& source, const ShaderImpl& impl) {
     GLuint shader = glCreateShader(type);
     const char *src = source.c_str();
     glShaderSource(shader, 1, &src, NULL);
@@ -102,7 +148,7 @@ static GLuint compile_shader(GLenum type, ShaderImpl& impl) {
     glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
     if (shaderCompiled != GL_TRUE) {
         std::string log = get_log(shader);
-        std::string error_msg = "ERROR: Failed to compile shader: " + impl.source_files[type].string() + ".\n" + log + "\nSource:\n";
+        std::string error_msg = "ERROR: Failed to compile shader: " + impl.source_files.at(type).string() + ".\n" + log + "\nSource:\n";
         // get relevant lines
         std::string out;
         std::stringstream logstream(log);
@@ -131,7 +177,225 @@ static GLuint compile_shader(GLenum type, ShaderImpl& impl) {
     return shader;
 }
 
-bool reload_modified_shaders() {
+// fill the uniform and uniform block tables of a freshly linked program
+static void reflect_program(ShaderImpl& impl) {
+    impl.uniforms.clear();
+    impl.uniform_blocks.clear();
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(impl.id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(impl.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<char> buf(std::max(max_length, 1));
+    for (GLuint i = 0; i < GLuint(count); i++) {
+        GLsizei length = 0;
+        ShaderImpl::UniformInfo info;
+        glGetActiveUniform(impl.id, i, GLsizei(buf.size()), &length, &info.size, &info.type, buf.data());
+        glGetActiveUniformsiv(impl.id, 1, &i, GL_UNIFORM_BLOCK_INDEX, &info.block);
+        glGetActiveUniformsiv(impl.id, 1, &i, GL_UNIFORM_OFFSET, &info.offset);
+        std::string name(buf.data(), length);
+        info.location = info.block < 0 ? glGetUniformLocation(impl.id, name.c_str()) : -1;
+        // arrays are reported as name[0], address them by name
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            name.resize(name.size() - 3);
+        impl.uniforms[name] = info;
+    }
+    count = max_length = 0;
+    glGetProgramiv(impl.id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(impl.id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+    buf.resize(std::max(max_length, 1));
+    for (GLuint i = 0; i < GLuint(count); i++) {
+        GLsizei length = 0;
+        ShaderImpl::UniformBlockInfo info;
+        info.index = i;
+        glGetActiveUniformBlockName(impl.id, i, GLsizei(buf.size()), &length, buf.data());
+        glGetActiveUniformBlockiv(impl.id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &info.size_bytes);
+        GLint binding = 0;
+        glGetActiveUniformBlockiv(impl.id, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+        info.binding = GLuint(binding);
+        impl.uniform_blocks[std::string(buf.data(), length)] = info;
+    }
+}
+
+// ----------------------------------------------------
+// program binary cache
+// <program_cache_dir>/<key>.bin: magic, key, binary format, binary size, binary
+// the key hashes the preprocessed sources (includes and defines) of all stages and the driver
+
+static const char program_binary_magic[8] = { 'C', 'P', 'P', 'G', 'L', 'P', 'B', '1' };
+
+static bool program_binaries_supported() {
+    static const bool supported = []() {
+        if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }();
+    return supported;
+}
+
+static uint64_t program_key(const std::map<GLenum, std::string>& sources) {
+    static const std::string driver = [](){
+        std::string driver;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const GLubyte* str = glGetString(name);
+            driver += str ? std::string((const char*)str) + "\n" : "\n";
+        }
+        return driver;
+    }();
+    uint64_t key = hash_bytes(driver.data(), driver.size());
+    for (const auto& [type, source] : sources) {
+        key = hash_bytes(&type, sizeof(type), key);
+        key = hash_bytes(source.data(), source.size() + 1, key);
+    }
+    return key;
+}
+
+// creates the cache directory (0700) and checks that only the current user can write to it, checked once per directory
+static bool program_cache_usable() {
+    static fs::path checked_dir;
+    static bool usable = false;
+    if (ShaderImpl::program_cache_dir == checked_dir) return usable;
+    checked_dir = ShaderImpl::program_cache_dir;
+    usable = false;
+    if (checked_dir.empty()) return false;
+    std::error_code error;
+    fs::create_directories(checked_dir, error);
+    if (error) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat info;
+    if (lstat(checked_dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != geteuid()) {
+        std::cerr << "WARNING: program cache " << checked_dir << " is not a directory owned by the current user, the cache is disabled" << std::endl;
+        return false;
+    }
+    if ((info.st_mode & 0077) && chmod(checked_dir.c_str(), 0700) != 0) {
+        std::cerr << "WARNING: unable to restrict the permissions of program cache " << checked_dir << ", the cache is disabled" << std::endl;
+        return false;
+    }
+#endif
+    usable = true;
+    return true;
+}
+
+static fs::path program_binary_path(uint64_t key) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+    return ShaderImpl::program_cache_dir / (std::string(hex) + ".bin");
+}
+
+// linked program from the cache, 0 if missing or rejected by the driver
+static GLuint load_program_binary(uint64_t key) {
+    if (!program_cache_usable()) return 0;
+    const fs::path path = program_binary_path(key);
+    std::error_code error;
+    const uintmax_t file_bytes = fs::file_size(path, error);
+    if (error) return 0;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return 0;
+    char magic[8];
+    uint64_t file_key = 0;
+    uint32_t format = 0, size_bytes = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&file_key, sizeof(file_key));
+    file.read((char*)&format, sizeof(format));
+    file.read((char*)&size_bytes, sizeof(size_bytes));
+    if (!file || std::memcmp(magic, program_binary_magic, sizeof(magic)) != 0 || file_key != key) return 0;
+    // the binary has to fill the rest of the file exactly, truncated or corrupt files are compiled from source again
+    const uintmax_t header_bytes = sizeof(magic) + sizeof(file_key) + sizeof(format) + sizeof(size_bytes);
+    if (size_bytes == 0 || size_bytes > uint32_t(INT32_MAX) || header_bytes + size_bytes != file_bytes) return 0;
+    std::vector<char> binary(size_bytes);
+    if (!file.read(binary.data(), size_bytes)) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), GLsizei(size_bytes));
+    GLint link_ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &link_ok);
+    if (link_ok != GL_TRUE) {
+        // e.g. after a driver update that kept the version string
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void store_program_binary(GLuint program, uint64_t key) {
+    GLint size_bytes = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size_bytes);
+    if (size_bytes <= 0) return;
+    std::vector<char> binary(size_bytes);
+    GLenum format = 0;
+    glGetProgramBinary(program, size_bytes, nullptr, &format, binary.data());
+
+    // write to a temporary file first, so concurrent launches never read a partial binary
+    if (!program_cache_usable()) return;
+    std::error_code error;
+    const fs::path path = program_binary_path(key);
+    fs::path tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return;
+        const uint32_t format32 = format, size32 = uint32_t(size_bytes);
+        file.write(program_binary_magic, sizeof(program_binary_magic));
+        file.write((const char*)&key, sizeof(key));
+        file.write((const char*)&format32, sizeof(format32));
+        file.write((const char*)&size32, sizeof(size32));
+        file.write(binary.data(), size_bytes);
+        if (!file) return;
+    }
+    fs::rename(tmp_path, path, error);
+    if (error) fs::remove(tmp_path, error);
+}
+
+// ----------------------------------------------------
+// change detection for reload_modified_shaders()
+// on Linux the directories of all source and include files are watched with inotify, so files are only stat'ed after
+// a change was reported, elsewhere (or if inotify is not available) at most every ShaderImpl::reload_poll_interval
+
+#if defined(__linux__)
+static int shader_watch_fd = -2;    // -2: not initialized, -1: inotify not available
+static std::set<fs::path> shader_watch_dirs;
+#endif
+
+static void watch_shader_files(const ShaderImpl& impl) {
+#if defined(__linux__)
+    if (shader_watch_fd == -2)
+        shader_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (shader_watch_fd < 0) return;
+    std::vector<fs::path> files;
+    for (const auto& entry : impl.source_files) files.push_back(entry.second);
+    for (const auto& entry : impl.include_timestamps) files.push_back(entry.first);
+    for (const auto& file : files) {
+        std::error_code error;
+        fs::path dir = fs::absolute(file, error).parent_path();
+        if (error || shader_watch_dirs.count(dir)) continue;
+        // editors often save by replacing the file, so watch the directory instead of the file
+        if (inotify_add_watch(shader_watch_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB) >= 0)
+            shader_watch_dirs.insert(dir);
+    }
+#else
+    (void) impl;
+#endif
+}
+
+// whether shader files might have changed since the last call
+static bool shader_files_changed() {
+#if defined(__linux__)
+    if (shader_watch_fd >= 0) {
+        bool changed = false;
+        alignas(struct inotify_event) char buf[4096];
+        while (read(shader_watch_fd, buf, sizeof(buf)) > 0)
+            changed = true;
+        return changed;
+    }
+#endif
+    static auto last_poll = std::chrono::steady_clock::now();
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_poll).count() < ShaderImpl::reload_poll_interval) return false;
+    last_poll = now;
+    return true;
+}
+
+bool reload_modified_shaders(bool force) {
+    if (!shader_files_changed() && !force) return false;
     bool modified = false;
     for (auto& pair : Shader::map)
         modified |= pair.second->reload_if_modified();
@@ -141,20 +405,20 @@ bool reload_modified_shaders() {
 // ----------------------------------------------------
 // ShaderImpl
 
-ShaderImpl::ShaderImpl(const std::string& name) : name(name), id(0) {}
+ShaderImpl::ShaderImpl(const std::string& name) : name(name), id(0), link_serial(0) {}
 
-ShaderImpl::ShaderImpl(const std::string& name, const fs::path& compute_source) : name(name), id(0) {
+ShaderImpl::ShaderImpl(const std::string& name, const fs::path& compute_source) : name(name), id(0), link_serial(0) {
     set_compute_source(compute_source);
     compile();
 }
 
-ShaderImpl::ShaderImpl(const std::string& name, const fs::path& vertex_source, const fs::path& fragment_source) : name(name), id(0)  {
+ShaderImpl::ShaderImpl(const std::string& name, const fs::path& vertex_source, const fs::path& fragment_source) : name(name), id(0), link_serial(0)  {
     set_vertex_source(vertex_source);
     set_fragment_source(fragment_source);
     compile();
 }
 
-ShaderImpl::ShaderImpl(const std::string& name, const fs::path& vertex_source, const fs::path& geometry_source, const fs::path& fragment_source) : name(name), id(0)  {
+ShaderImpl::ShaderImpl(const std::string& name, const fs::path& vertex_source, const fs::path& geometry_source, const fs::path& fragment_source) : name(name), id(0), link_serial(0)  {
     set_vertex_source(vertex_source);
     set_geometry_source(geometry_source);
     set_fragment_source(fragment_source);
@@ -169,8 +433,12 @@ void ShaderImpl::clear() {
     if (glIsProgram(id))
         glDeleteProgram(id);
     id = 0;
+    uniforms.clear();
+    uniform_blocks.clear();
+    link_serial = 0;
     source_files.clear();
     timestamps.clear();
+    defines.clear();
 }
 
 void ShaderImpl::bind() const { glUseProgram(id); }
@@ -225,75 +493,69 @@ void ShaderImpl::set_compute_source(const fs::path& path) {
     set_source(GL_COMPUTE_SHADER, path);
 }
 
+void ShaderImpl::set_define(const std::string& name, const std::string& value) {
+    defines[name] = value;
+}
+
 void ShaderImpl::compile() {
-    // compile shaders
-    GLuint program = glCreateProgram();
-    if (source_files.count(GL_COMPUTE_SHADER)) { // is compute shader
-        GLuint shader = compile_shader(GL_COMPUTE_SHADER, *this);
-        if (!shader) {
-            glDeleteProgram(program);
-            return;
-        }
-        glAttachShader(program, shader);
-    } else { // is pipeline
-        if (source_files.count(GL_VERTEX_SHADER)) {
-            GLuint shader = compile_shader(GL_VERTEX_SHADER, *this);
-            if (!shader) {
-                glDeleteProgram(program);
-                return;
-            }
-            glAttachShader(program, shader);
-        }
-        if (source_files.count(GL_TESS_CONTROL_SHADER)) {
-            GLuint shader = compile_shader(GL_TESS_CONTROL_SHADER, *this);
-            if (!shader) {
-                glDeleteProgram(program);
-                return;
-            }
-            glAttachShader(program, shader);
-        }
-        if (source_files.count(GL_TESS_EVALUATION_SHADER)) {
-            GLuint shader = compile_shader(GL_TESS_EVALUATION_SHADER, *this);
-            if (!shader) {
-                glDeleteProgram(program);
-                return;
+    // preprocess all stages, compute shaders exclude the pipeline stages
+    std::map<GLenum, std::string> sources;
+    include_timestamps.clear();
+    const bool is_compute = source_files.count(GL_COMPUTE_SHADER);
+    for (const GLenum type : { GL_COMPUTE_SHADER, GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER })
+        if (source_files.count(type) && (type == GL_COMPUTE_SHADER) == is_compute)
+            sources[type] = preprocess_shader(type, *this);
+
+    // try the program binary cache before compiling
+    const bool use_cache = !program_cache_dir.empty() && program_binaries_supported();
+    const uint64_t key = use_cache ? program_key(sources) : 0;
+    GLuint program = use_cache ? load_program_binary(key) : 0;
+    if (program) {
+        std::cout << "Loaded cached program binary for: " << name << std::endl;
+    } else {
+        // compile shaders
+        program = glCreateProgram();
+        std::vector<GLuint> shaders;
+        try {
+            for (const auto& [type, source] : sources) {
+                shaders.push_back(compile_shader(type, source, *this));
+                glAttachShader(program, shaders.back());
             }
-            glAttachShader(program, shader);
+        } catch (const std::exception&) {
+            for (GLuint shader : shaders)
+                glDeleteShader(shader);
+            glDeleteProgram(program);
+            throw;
         }
-        if (source_files.count(GL_GEOMETRY_SHADER)) {
-            GLuint shader = compile_shader(GL_GEOMETRY_SHADER, *this);
-            if (!shader) {
-                glDeleteProgram(program);
-                return;
-            }
-            glAttachShader(program, shader);
+        // link program
+        if (use_cache)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        for (GLuint shader : shaders) {
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
         }
-        if (source_files.count(GL_FRAGMENT_SHADER)) {
-            GLuint shader = compile_shader(GL_FRAGMENT_SHADER, *this);
-            if (!shader) {
-                glDeleteProgram(program);
-                return;
-            }
-            glAttachShader(program, shader);
+        GLint link_ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &link_ok);
+        if (link_ok != GL_TRUE) {
+            std::string error_msg = "ERROR: Failed to link shader from sources:\n";
+            for (const auto& entry : source_files)
+                error_msg += entry.second.string() + "\n";
+            error_msg += "Log: " + get_log(program) + "\n";
+            glDeleteProgram(program);
+            std::cerr << error_msg << std::endl;
+            throw std::runtime_error("Shader compilation failed, see full output in std::cerr");
         }
-    }
-    // link program
-    glLinkProgram(program);
-    GLint link_ok = GL_FALSE;
-    glGetProgramiv(program, GL_LINK_STATUS, &link_ok);
-    if (link_ok != GL_TRUE) {
-        std::string error_msg = "ERROR: Failed to link shader from sources:\n";
-        for (const auto& entry : source_files)
-            error_msg += entry.second.string() + "\n";
-        error_msg += "Log: " + get_log(program) + "\n";
-        glDeleteProgram(program);
-        std::cerr << error_msg << std::endl;
-        throw std::runtime_error("Shader compilation failed, see full output in std::cerr");
+        if (use_cache)
+            store_program_binary(program, key);
     }
     // success, set new id
     if (glIsProgram(id))
         glDeleteProgram(id);
     id = program;
+    reflect_program(*this);
+    link_serial = ++shader_link_serial;
+    watch_shader_files(*this);
 }
 
 void ShaderImpl::dispatch_compute(uint32_t w, uint32_t h, uint32_t d, GLbitfield memory_barrier_bits) const {
@@ -304,103 +566,140 @@ void ShaderImpl::dispatch_compute(uint32_t w, uint32_t h, uint32_t d, GLbitfield
         glMemoryBarrier(memory_barrier_bits);
 }
 
+const ShaderImpl::UniformInfo* ShaderImpl::find_uniform(const std::string& name) const {
+    const auto it = uniforms.find(name);
+    return it == uniforms.end() ? nullptr : &it->second;
+}
+
+const ShaderImpl::UniformBlockInfo* ShaderImpl::find_uniform_block(const std::string& name) const {
+    const auto it = uniform_blocks.find(name);
+    return it == uniform_blocks.end() ? nullptr : &it->second;
+}
+
+GLint ShaderImpl::uniform_location(const std::string& name) const {
+    const auto it = uniforms.find(name);
+    if (it != uniforms.end()) return it->second.location;
+    // single array elements (name[i]) are not part of the table
+    return name.find('[') == std::string::npos ? -1 : glGetUniformLocation(id, name.c_str());
+}
+
 void ShaderImpl::uniform(const std::string& name, int val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1i(loc, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, int *val, uint32_t count) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1iv(loc, count, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, uint32_t val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1ui(loc, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, uint32_t* val, uint32_t count) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1uiv(loc, count, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, float val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1f(loc, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, float *val, uint32_t count) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform1fv(loc, count, val);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::vec2& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform2f(loc, val.x, val.y);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::vec3& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform3f(loc, val.x, val.y, val.z);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::vec4& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform4f(loc, val.x, val.y, val.z, val.w);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::ivec2& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform2i(loc, val.x, val.y);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::ivec3& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform3i(loc, val.x, val.y, val.z);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::ivec4& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform4i(loc, val.x, val.y, val.z, val.w);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::uvec2& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform2ui(loc, val.x, val.y);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::uvec3& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform3ui(loc, val.x, val.y, val.z);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::uvec4& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniform4ui(loc, val.x, val.y, val.z, val.w);
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::mat3& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
 }
 
 void ShaderImpl::uniform(const std::string& name, const glm::mat4& val) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
 }
 
 void ShaderImpl::uniform(const std::string& name, const Texture2D& tex, uint32_t unit) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     tex->bind(unit);
     glUniform1i(loc, unit);
 }
 
 void ShaderImpl::uniform(const std::string& name, const Texture3D& tex, uint32_t unit) const {
-    int loc = glGetUniformLocation(id, name.c_str());
+    const GLint loc = uniform_location(name);
     tex->bind(unit);
     glUniform1i(loc, unit);
 }
 
+void ShaderImpl::uniform(const std::string& name, const UBO& ubo, uint32_t binding) const {
+    const UniformBlockInfo* block = find_uniform_block(name);
+    if (!block) return;
+    if (block->binding != binding) {
+        glUniformBlockBinding(id, block->index, binding);
+        block->binding = binding;
+    }
+    ubo->bind_base(binding);
+}
+
+void ShaderImpl::uniform(const std::string& name, const UBO& ubo, uint32_t binding, size_t offset_bytes, size_t size_bytes) const {
+    const UniformBlockInfo* block = find_uniform_block(name);
+    if (!block) return;
+    if (block->binding != binding) {
+        glUniformBlockBinding(id, block->index, binding);
+        block->binding = binding;
+    }
+    ubo->bind_range(binding, offset_bytes, size_bytes);
+}
+
 bool ShaderImpl::reload_if_modified() {
     // check source files
     for (const auto& entry : source_files) {
@@ -4,6 +4,7 @@
 #include <filesystem>
 namespace fs = std::filesystem;
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <vector>
 #include <GL/glew.h>
@@ -11,6 +12,7 @@ namespace fs = std::filesystem;
 #include <glm/glm.hpp>
 #include "named_handle.h"
 #include "texture.h"
+#include "buffer.h"
 
 CPPGL_NAMESPACE_BEGIN
 
@@ -47,12 +49,34 @@ public:
     void set_fragment_source(const fs::path& path);
     void set_compute_source(const fs::path& path);
 
+    // add a preprocessor #define to all stages, inserted after the #version directive (applies on next compile)
+    void set_define(const std::string& name, const std::string& value = "");
+
     // compile and link shader from previously given source files
+    // linked programs are cached in program_cache_dir and loaded from there while their sources, defines and driver match
     void compile();
 
     // compute shader dispatch (call with actual amount of threads, will internally divide by workgroup size), memory_barrier_bits is option for automatic glMemoryBarrier(memory_barrier_bits)
     void dispatch_compute(uint32_t w, uint32_t h = 1, uint32_t d = 1, GLbitfield memory_barrier_bits = GL_ALL_BARRIER_BITS) const;
 
+    // reflected uniforms and uniform blocks, filled on every successful link
+    struct UniformInfo {
+        GLint location;     // -1 for members of uniform blocks
+        GLenum type;
+        GLint size;         // array length
+        GLint block;        // index of the enclosing uniform block or -1
+        GLint offset;       // byte offset in the enclosing uniform block or -1
+    };
+    struct UniformBlockInfo {
+        GLuint index;
+        GLint size_bytes;
+        mutable GLuint binding;
+    };
+    const UniformInfo* find_uniform(const std::string& name) const;
+    const UniformBlockInfo* find_uniform_block(const std::string& name) const;
+    // location from the reflected table, -1 if the uniform is not active
+    GLint uniform_location(const std::string& name) const;
+
     // uniform upload handling
     void uniform(const std::string& name, int val) const;
     void uniform(const std::string& name, int* val, uint32_t count) const;
@@ -73,6 +97,8 @@ public:
     void uniform(const std::string& name, const glm::mat4& val) const;
     void uniform(const std::string& name, const Texture2D& tex, uint32_t unit) const;
     void uniform(const std::string& name, const Texture3D& tex, uint32_t unit) const;
+    void uniform(const std::string& name, const UBO& ubo, uint32_t binding) const; // uniform block
+    void uniform(const std::string& name, const UBO& ubo, uint32_t binding, size_t offset_bytes, size_t size_bytes) const; // uniform block range
 
     // clear shader
     void clear();
@@ -88,13 +114,22 @@ public:
     std::map<GLenum, fs::path> source_files;
     std::map<GLenum, fs::file_time_type> timestamps;
     std::map<fs::path, fs::file_time_type> include_timestamps;
-    
+    std::map<std::string, std::string> defines;
+    std::unordered_map<std::string, UniformInfo> uniforms;
+    std::unordered_map<std::string, UniformBlockInfo> uniform_blocks;
+    uint64_t link_serial;   // unique across all shaders and links, identifies state derived from the current program
+
     static std::vector<fs::path> shader_search_paths;
+    static fs::path program_cache_dir;      // program binary cache, empty to disable, default: ~/.cache/cppgl/program_cache
+    static bool hot_reload;                 // reload modified shaders every frame (in Context::swap_buffers), default: off
+    static double reload_poll_interval;     // seconds between checks where file change notifications are not available
 };
 
 using Shader = NamedHandle<ShaderImpl>;
 template class _API NamedHandle<ShaderImpl>; //needed for Windows DLL export
 
-bool reload_modified_shaders();
+// reload shaders whose source or include files changed (return true if any reloaded)
+// files are only checked after a change notification or poll interval, unless force is set
+bool reload_modified_shaders(bool force = false);
 
 CPPGL_NAMESPACE_END
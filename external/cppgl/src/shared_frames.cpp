@@ -0,0 +1,325 @@
+#include "shared_frames.h"
+#include "query.h"
+#include <chrono>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#define CPPGL_POSIX_SHM
+#endif
+
+CPPGL_NAMESPACE_BEGIN
+
+static size_t align_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// POSIX names start with a slash
+static std::string shm_name(const std::string& name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+static SharedFrameSlot* slots_of(uint8_t* segment) {
+    return reinterpret_cast<SharedFrameSlot*>(segment + sizeof(SharedFrameHeader));
+}
+
+#ifdef CPPGL_POSIX_SHM
+// true if no object of that name exists, or it is a ring whose producer closed it or is no longer running
+// anything else, including a ring that is still being initialized, belongs to someone else
+static bool stale_ring(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return errno == ENOENT;
+    struct stat info;
+    bool stale = false;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(SharedFrameHeader)) {
+        void* mapping = mmap(nullptr, sizeof(SharedFrameHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            const SharedFrameHeader* other = (const SharedFrameHeader*)mapping;
+            if (other->magic == SHARED_FRAMES_MAGIC && other->state.load(std::memory_order_acquire) != uint32_t(SharedFrameState::INITIALIZING))
+                stale = other->state.load(std::memory_order_acquire) == uint32_t(SharedFrameState::CLOSED)
+                    || (kill(pid_t(other->producer_pid), 0) != 0 && errno == ESRCH);
+            munmap(mapping, sizeof(SharedFrameHeader));
+        }
+    }
+    close(fd);
+    return stale;
+}
+#endif
+
+int64_t shared_frames_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------
+// SharedFrameExporter
+
+SharedFrameExporter::SharedFrameExporter(const std::string& name, uint32_t w, uint32_t h, uint32_t slots, uint32_t delay)
+    : name(shm_name(name)), w(w), h(h), calibration_hash(0), frames_captured(0), stall_ms(0),
+    readbacks(delay + 2), delay(delay), frames_retired(0), header(nullptr), slots(nullptr), segment(nullptr), publisher(1) {
+#ifdef CPPGL_POSIX_SHM
+    // pixels of each slot start on their own page
+    const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    const uint32_t slot_count = std::max(2u, slots);
+    const size_t slot_bytes = align_up(size_t(w) * h * 4, page);
+    const size_t data_offset = align_up(sizeof(SharedFrameHeader) + slot_count * sizeof(SharedFrameSlot), page);
+    const size_t segment_bytes = data_offset + slot_count * slot_bytes;
+
+    // a ring left behind by an exited producer is replaced, readers still attached to it keep their mapping
+    if (!stale_ring(this->name))
+        throw std::runtime_error("SharedFrameExporter: shared memory " + this->name + " is in use by a running producer or not a frame ring (remove it e.g. from /dev/shm if it is left over)");
+    shm_unlink(this->name.c_str());
+    const int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error("SharedFrameExporter: unable to create shared memory " + this->name + ": " + std::strerror(errno));
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, off_t(segment_bytes)) == 0)
+        mapping = mmap(nullptr, segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(this->name.c_str());
+        throw std::runtime_error("SharedFrameExporter: unable to map shared memory " + this->name + ": " + std::strerror(errno));
+    }
+
+    // the new object is zero filled, which is a valid state for the atomics
+    segment = (uint8_t*)mapping;
+    header = reinterpret_cast<SharedFrameHeader*>(segment);
+    this->slots = slots_of(segment);
+    header->magic = SHARED_FRAMES_MAGIC;
+    header->version = SHARED_FRAMES_VERSION;
+    header->slot_count = slot_count;
+    header->slot_bytes = slot_bytes;
+    header->segment_bytes = segment_bytes;
+    header->producer_pid = int64_t(getpid());
+    for (uint32_t i = 0; i < slot_count; i++)
+        this->slots[i].data_offset = data_offset + i * slot_bytes;
+    header->state.store(uint32_t(SharedFrameState::LIVE), std::memory_order_release);
+#else
+    throw std::runtime_error("SharedFrameExporter: shared memory export requires a POSIX system");
+#endif
+
+    for (auto& readback : readbacks) {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size_t(w) * h * 4, 0, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+SharedFrameExporter::~SharedFrameExporter() {
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    // the publisher must not touch the segment or a mapped buffer anymore
+    for (auto& readback : readbacks) {
+        if (readback.published.valid()) readback.published.wait();
+        if (readback.mapped) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glDeleteBuffers(1, &readback.pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#ifdef CPPGL_POSIX_SHM
+    if (segment) {
+        header->state.store(uint32_t(SharedFrameState::CLOSED), std::memory_order_release);
+        munmap(segment, header->segment_bytes);
+        shm_unlink(name.c_str());
+    }
+#endif
+}
+
+void SharedFrameExporter::capture() {
+    Readback& readback = next_readback();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.capture_ns = shared_frames_now_ns();
+    readback.calibration_hash = calibration_hash;
+    frames_captured++;
+}
+
+void SharedFrameExporter::capture(const Texture2D& texture) {
+    if (uint32_t(texture->w) != w || uint32_t(texture->h) != h)
+        throw std::runtime_error("SharedFrameExporter: texture " + texture->name + " does not match the exported resolution");
+    Readback& readback = next_readback();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.capture_ns = shared_frames_now_ns();
+    readback.calibration_hash = calibration_hash;
+    frames_captured++;
+}
+
+void SharedFrameExporter::flush() {
+    while (frames_retired < frames_captured)
+        retire(frames_retired);
+    for (auto& readback : readbacks)
+        release(readback);
+}
+
+SharedFrameExporter::Readback& SharedFrameExporter::next_readback() {
+    // at most delay readbacks are pending on the GPU
+    while (frames_captured - frames_retired > delay)
+        retire(frames_retired);
+    // the entry held a frame that is retired by now, its copy may still be running
+    Readback& readback = readbacks[frames_captured % readbacks.size()];
+    release(readback);
+    return readback;
+}
+
+void SharedFrameExporter::retire(uint64_t frame) {
+    Readback& readback = readbacks[frame % readbacks.size()];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    readback.mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size_t(w) * h * 4, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frames_retired++;
+    if (!readback.mapped)
+        throw std::runtime_error("SharedFrameExporter: unable to map pixel pack buffer");
+    // the buffer stays mapped until the publisher copied it, the copy is the only one on the way to the readers
+    readback.published = publisher.enqueue([this, &readback, frame]() { publish(readback, frame); });
+}
+
+void SharedFrameExporter::release(Readback& readback) {
+    if (readback.published.valid()) {
+        Timer timer;
+        readback.published.wait();
+        stall_ms += timer.look();
+    }
+    if (readback.mapped) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.mapped = nullptr;
+    }
+    if (readback.published.valid()) readback.published.get();
+}
+
+void SharedFrameExporter::publish(const Readback& readback, uint64_t frame) {
+    SharedFrameSlot& slot = slots[frame % header->slot_count];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.frame = frame;
+    slot.capture_ns = readback.capture_ns;
+    slot.w = w;
+    slot.h = h;
+    slot.stride = w * 4;
+    slot.format = uint32_t(SharedFrameFormat::RGBA8);
+    slot.calibration_hash = readback.calibration_hash;
+    // GL rows start at the bottom, shared frames start at the top
+    const size_t row = size_t(w) * 4;
+    uint8_t* pixels = segment + slot.data_offset;
+    for (uint32_t y = 0; y < h; y++)
+        std::memcpy(pixels + (h - 1 - y) * row, readback.mapped + y * row, row);
+    slot.publish_ns = shared_frames_now_ns();
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    header->published.store(frame + 1, std::memory_order_release);
+}
+
+// ------------------------------------------
+// SharedFrameReader
+
+SharedFrameReader::SharedFrameReader(const std::string& name)
+    : name(shm_name(name)), header(nullptr), segment(nullptr), segment_bytes(0) {
+#ifdef CPPGL_POSIX_SHM
+    const int fd = shm_open(this->name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error("SharedFrameReader: unable to open shared memory " + this->name + ": " + std::strerror(errno));
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(SharedFrameHeader)) {
+        segment_bytes = size_t(info.st_size);
+        mapping = mmap(nullptr, segment_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("SharedFrameReader: unable to map shared memory " + this->name);
+    segment = (const uint8_t*)mapping;
+    header = reinterpret_cast<const SharedFrameHeader*>(segment);
+
+    const char* error = nullptr;
+    if (header->state.load(std::memory_order_acquire) == uint32_t(SharedFrameState::INITIALIZING))
+        error = " is not initialized yet";
+    else if (header->magic != SHARED_FRAMES_MAGIC || header->version != SHARED_FRAMES_VERSION)
+        error = " is not a compatible frame ring";
+    else if (header->segment_bytes > segment_bytes || header->slot_count == 0
+            || sizeof(SharedFrameHeader) + uint64_t(header->slot_count) * sizeof(SharedFrameSlot) > segment_bytes)
+        error = " is truncated";
+    if (error) {
+        munmap((void*)segment, segment_bytes);
+        throw std::runtime_error("SharedFrameReader: shared memory " + this->name + error);
+    }
+#else
+    throw std::runtime_error("SharedFrameReader: shared memory export requires a POSIX system");
+#endif
+}
+
+SharedFrameReader::~SharedFrameReader() {
+#ifdef CPPGL_POSIX_SHM
+    if (segment) munmap((void*)segment, segment_bytes);
+#endif
+}
+
+bool SharedFrameReader::latest(SharedFrameView& view) const {
+    const uint64_t count = header->published.load(std::memory_order_acquire);
+    if (count == 0) return false;
+    const SharedFrameSlot* slot = slots_of((uint8_t*)segment) + (count - 1) % header->slot_count;
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) return false;
+
+    // the metadata may be torn while the producer overwrites the slot, the sequence check below rejects it
+    SharedFrameView candidate;
+    candidate.slot = slot;
+    candidate.sequence = sequence;
+    candidate.frame = slot->frame;
+    candidate.capture_ns = slot->capture_ns;
+    candidate.publish_ns = slot->publish_ns;
+    candidate.w = slot->w;
+    candidate.h = slot->h;
+    candidate.stride = slot->stride;
+    candidate.format = slot->format;
+    candidate.calibration_hash = slot->calibration_hash;
+    const uint64_t data_offset = slot->data_offset;
+    if (!valid(candidate)) return false;
+    if (data_offset + uint64_t(candidate.h) * candidate.stride > segment_bytes) return false;
+
+    candidate.pixels = segment + data_offset;
+    view = candidate;
+    return true;
+}
+
+bool SharedFrameReader::valid(const SharedFrameView& view) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot && view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+uint64_t SharedFrameReader::published() const {
+    return header->published.load(std::memory_order_acquire);
+}
+
+bool SharedFrameReader::closed() const {
+    return header->state.load(std::memory_order_acquire) == uint32_t(SharedFrameState::CLOSED);
+}
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <future>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include "texture.h"
+#include "thread_pool.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// Export of frames into a POSIX shared memory ring for other processes (video encoders, monitoring viewers)
+//
+// Segment layout: SharedFrameHeader, slot_count SharedFrameSlots, then the page aligned pixels of each slot.
+// Each slot is guarded by a seqlock: its sequence is odd while the producer writes it. Readers never block the
+// producer, they use the pixels in place and check afterwards that the sequence did not change.
+// Timestamps are nanoseconds of std::chrono::steady_clock (CLOCK_MONOTONIC on Linux, comparable across processes).
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+        "shared frames require lock-free atomics");
+
+constexpr uint64_t SHARED_FRAMES_MAGIC = 0x314d524653475043ull;    // "CPGSFRM1"
+constexpr uint32_t SHARED_FRAMES_VERSION = 1;
+
+enum class SharedFrameFormat : uint32_t {
+    RGBA8 = 1       // 4 bytes per pixel, rows from top to bottom
+};
+
+enum class SharedFrameState : uint32_t {
+    INITIALIZING = 0,
+    LIVE = 1,
+    CLOSED = 2      // the producer exited, no further frames
+};
+
+struct alignas(64) SharedFrameSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;                 // index of the frame, consecutive per producer
+    int64_t capture_ns;             // readback issued, right after the frame was rendered
+    int64_t publish_ns;             // pixels complete in the slot
+    uint32_t w, h, stride;          // stride: bytes per row
+    uint32_t format;                // SharedFrameFormat
+    uint64_t calibration_hash;      // identifies the display calibration the frame was rendered for
+    uint64_t data_offset;           // of the pixels from the start of the segment
+};
+
+struct alignas(64) SharedFrameHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_bytes;            // pixel capacity of each slot
+    uint64_t segment_bytes;
+    int64_t producer_pid;
+    std::atomic<uint32_t> state;    // SharedFrameState
+    alignas(64) std::atomic<uint64_t> published;   // frames published, the newest is in slot (published - 1) % slot_count
+};
+
+// copy of the metadata of a slot and its pixels in place
+struct SharedFrameView {
+    const SharedFrameSlot* slot = nullptr;
+    uint64_t sequence = 0;
+    uint64_t frame = 0;
+    int64_t capture_ns = 0, publish_ns = 0;
+    uint32_t w = 0, h = 0, stride = 0, format = 0;
+    uint64_t calibration_hash = 0;
+    const uint8_t* pixels = nullptr;
+};
+
+int64_t shared_frames_now_ns();
+
+// -------------------------------------------------------
+// Producer: asynchronous readback into pixel pack buffers, a worker copies mapped buffers into the ring
+
+class SharedFrameExporter {
+public:
+    // create the shared memory object name (e.g. "/lfd_interlaced", replaces a stale one) for w x h frames
+    // slots: frames in the ring, the newest frame stays valid for readers for slots - 1 frames
+    // delay: frames a readback may take on the GPU before it is mapped
+    SharedFrameExporter(const std::string& name, uint32_t w, uint32_t h, uint32_t slots = 3, uint32_t delay = 1);
+    // publishes all pending frames, marks the ring closed and unlinks it
+    virtual ~SharedFrameExporter();
+
+    // prevent copies and moves, since GL buffers and the mapping aren't reference counted
+    SharedFrameExporter(const SharedFrameExporter&) = delete;
+    SharedFrameExporter& operator=(const SharedFrameExporter&) = delete;
+
+    // start the readback of the lower left w x h pixels of the bound read framebuffer
+    void capture();
+    // start the readback of level 0 of the texture (must be w x h, converted to RGBA8)
+    void capture(const Texture2D& texture);
+    // publish all started readbacks and wait until they are in the ring
+    void flush();
+
+    // data
+    const std::string name;
+    const uint32_t w, h;
+    uint64_t calibration_hash;  // stored with frames captured from now on
+    uint64_t frames_captured;   // readbacks started
+    double stall_ms;            // total time capture() waited for the copy into the ring
+
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        const uint8_t* mapped = nullptr;
+        int64_t capture_ns = 0;
+        uint64_t calibration_hash = 0;
+        std::future<void> published;
+    };
+
+    // reserve the ring entry of the next readback, retiring older ones
+    Readback& next_readback();
+    // map the readback of the given frame and queue its copy into the ring
+    void retire(uint64_t frame);
+    // wait for the copy of a readback and unmap its buffer
+    void release(Readback& readback);
+    void publish(const Readback& readback, uint64_t frame);
+
+    std::vector<Readback> readbacks;
+    const uint32_t delay;
+    uint64_t frames_retired;
+    SharedFrameHeader* header;
+    SharedFrameSlot* slots;
+    uint8_t* segment;
+    ThreadPool publisher;
+};
+
+// -------------------------------------------------------
+// Consumer: maps a ring read-only, never blocks or slows the producer
+
+class SharedFrameReader {
+public:
+    // throws if the ring does not exist (yet) or is incompatible
+    SharedFrameReader(const std::string& name);
+    virtual ~SharedFrameReader();
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    // view of the newest frame, false if nothing is published yet or the slot is being overwritten
+    bool latest(SharedFrameView& view) const;
+    // true while the slot of the view was not overwritten, call after using its pixels
+    bool valid(const SharedFrameView& view) const;
+    // frames published so far
+    uint64_t published() const;
+    bool closed() const;
+
+    // data
+    const std::string name;
+    const SharedFrameHeader* header;
+
+private:
+    const uint8_t* segment;
+    size_t segment_bytes;
+};
+
+CPPGL_NAMESPACE_END
@@ -20,42 +20,31 @@ inline GLint channels_to_float_format(uint32_t channels) {
 inline GLint channels_to_ubyte_format(uint32_t channels) {
     return channels == 4 ? GL_RGBA8 : channels == 3 ? GL_RGB8 : channels == 2 ? GL_RG8 : GL_R8;
 }
+// depth, stencil and integer textures are not filterable
+inline bool nearest_filtering(GLenum format) {
+    return format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL || format == GL_RED_INTEGER || format == GL_RG_INTEGER ||
+        format == GL_RGB_INTEGER || format == GL_RGBA_INTEGER;
+}
 
 // ----------------------------------------------------
 // Texture2D
 
 Texture2DImpl::Texture2DImpl(const std::string& name, const fs::path& path, bool mipmap) : name(name), loaded_from_path(path), id(0) {
-    // load image from disk
-    auto [data, w_out, h_out, channels, is_hdr] = image_load(path);
-    this->w = w_out;
-    this->h = h_out;
-
-    if (is_hdr) {
-        internal_format = channels_to_float_format(channels);
-        type = GL_FLOAT;
-    } else {
-        internal_format = channels_to_ubyte_format(channels);
-        type = GL_UNSIGNED_BYTE;
-    }
-    format = channels_to_format(channels);
+    // load image from disk, uploaded straight from the decoder's buffer
+    const Image image = image_decode(path);
+    glGenTextures(1, &id);
+    set_image(image.w, image.h, image.channels, image.is_hdr, image.data.get(), mipmap);
+}
 
-    // init GL texture
+Texture2DImpl::Texture2DImpl(const std::string& name, const fs::path& path, const std::array<uint8_t, 4>& placeholder_rgba)
+    : name(name), loaded_from_path(path), id(0), w(1), h(1), internal_format(GL_RGBA8), format(GL_RGBA), type(GL_UNSIGNED_BYTE) {
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-
-    //opengl by default needs 4 byte alignment after every row
-    //stbi loaded data is not aligned that way -> pixelStore attributes need to be set
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, &data[0]);
-    if (mipmap) glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, placeholder_rgba.data());
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
@@ -66,9 +55,9 @@ Texture2DImpl::Texture2DImpl(const std::string& name, uint32_t w, uint32_t h, GL
     glBindTexture(GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL) ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearest_filtering(format) ? GL_NEAREST : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-            mipmap ? GL_LINEAR_MIPMAP_LINEAR : (format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL) ? GL_NEAREST : GL_LINEAR);
+            mipmap ? GL_LINEAR_MIPMAP_LINEAR : nearest_filtering(format) ? GL_NEAREST : GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, data);
     if (mipmap && data != 0) glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -87,6 +76,36 @@ void Texture2DImpl::resize(uint32_t w, uint32_t h) {
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Texture2DImpl::set_image(int w, int h, int channels, bool is_hdr, const void* data, bool mipmap) {
+    this->w = w;
+    this->h = h;
+    if (is_hdr) {
+        internal_format = channels_to_float_format(channels);
+        type = GL_FLOAT;
+    } else {
+        internal_format = channels_to_ubyte_format(channels);
+        type = GL_UNSIGNED_BYTE;
+    }
+    format = channels_to_format(channels);
+
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    //opengl by default needs 4 byte alignment after every row
+    //stbi loaded data is not aligned that way -> pixelStore attributes need to be set
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, data);
+    if (mipmap) glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void Texture2DImpl::bind(uint32_t unit) const {
     glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, id);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -16,6 +17,8 @@ class Texture2DImpl {
 public:
     // construct from image on disk
     Texture2DImpl(const std::string& name, const fs::path& path, bool mipmap = true);
+    // construct a 1x1 placeholder for an image on disk, which is uploaded later with set_image() (see TextureLoader)
+    Texture2DImpl(const std::string& name, const fs::path& path, const std::array<uint8_t, 4>& placeholder_rgba);
     // construct empty texture or from raw data
     Texture2DImpl(const std::string& name, uint32_t w, uint32_t h, GLint internal_format, GLenum format, GLenum type,
             const void* data = 0, bool mipmap = false);
@@ -32,6 +35,10 @@ public:
     // resize (discards all data!)
     void resize(uint32_t w, uint32_t h);
 
+    // reallocate with the size and format of a decoded image and upload its data
+    // data is an offset into the pixel unpack buffer if one is bound
+    void set_image(int w, int h, int channels, bool is_hdr, const void* data, bool mipmap);
+
     // bind/unbind to/from OpenGL
     void bind(uint32_t uint) const;
     void unbind() const;
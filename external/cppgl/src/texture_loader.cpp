@@ -0,0 +1,109 @@
+#include "texture_loader.h"
+#include "image_load_store.h"
+#include "thread_pool.h"
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------
+// loader state (GL thread only, the workers only touch their own image)
+
+struct TextureRequest {
+    Texture2D texture;
+    fs::path path;
+    bool mipmap;
+    std::shared_ptr<Image> image;   // written by the worker before decoded becomes ready
+    std::future<void> decoded;
+};
+
+size_t TextureLoader::upload_budget = 16 << 20;
+std::array<uint8_t, 4> TextureLoader::placeholder = { 128, 128, 128, 255 };
+
+static std::unordered_map<std::string, Texture2D> loader_textures;     // canonical path -> texture
+static std::vector<TextureRequest> loader_requests;
+static uint64_t loader_uploads = 0;
+static GLuint loader_pbo = 0;
+
+static ThreadPool& loader_pool() {
+    // leave one hardware thread to the GL thread
+    static const unsigned threads = std::thread::hardware_concurrency();
+    static ThreadPool pool(threads > 1 ? threads - 1 : 1);
+    return pool;
+}
+
+static void upload(TextureRequest& request) {
+    const Image& image = *request.image;
+    if (!loader_pbo) glGenBuffers(1, &loader_pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, loader_pbo);
+    // orphan the previous storage, earlier uploads may still read from it
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, image.size_bytes, 0, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.size_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        std::memcpy(mapped, image.data.get(), image.size_bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        request.texture->set_image(image.w, image.h, image.channels, image.is_hdr, 0, request.mipmap);
+    } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        request.texture->set_image(image.w, image.h, image.channels, image.is_hdr, image.data.get(), request.mipmap);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    loader_uploads++;
+}
+
+// -------------------------------------------
+// TextureLoader
+
+Texture2D TextureLoader::load(const std::string& name, const fs::path& path, bool mipmap) {
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(path, error);
+    if (error) canonical = fs::absolute(path);
+    const auto it = loader_textures.find(canonical.string());
+    if (it != loader_textures.end())
+        return it->second;
+
+    TextureRequest request;
+    request.texture = Texture2D(name, path, placeholder);
+    request.path = path;
+    request.mipmap = mipmap;
+    request.image = std::make_shared<Image>();
+    request.decoded = loader_pool().enqueue([image = request.image, path]() { *image = image_decode(path); });
+    loader_textures[canonical.string()] = request.texture;
+    loader_requests.push_back(std::move(request));
+    return loader_requests.back().texture;
+}
+
+size_t TextureLoader::update(size_t budget_bytes) {
+    size_t uploaded = 0, bytes = 0;
+    for (auto it = loader_requests.begin(); it != loader_requests.end();) {
+        if (it->decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        if (uploaded > 0 && bytes + it->image->size_bytes > budget_bytes) break;
+        try {
+            it->decoded.get();
+            upload(*it);
+            uploaded++;
+            bytes += it->image->size_bytes;
+        } catch (const std::exception& e) {
+            std::cerr << "TextureLoader: " << e.what() << std::endl;
+        }
+        it = loader_requests.erase(it);
+    }
+    return uploaded;
+}
+
+void TextureLoader::finish() {
+    for (auto& request : loader_requests)
+        request.decoded.wait();
+    update(SIZE_MAX);
+}
+
+size_t TextureLoader::pending() { return loader_requests.size(); }
+
+uint64_t TextureLoader::uploads() { return loader_uploads; }
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <filesystem>
+namespace fs = std::filesystem;
+#include "texture.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------
+// Asynchronous texture loading
+// Images are decoded on worker threads and uploaded through a pixel unpack buffer on the GL thread, a bounded amount of
+// bytes per frame (see update(), called by Context::swap_buffers). Requests for the same file share one texture, which
+// holds a 1x1 placeholder until its upload finished. Files that fail to decode keep the placeholder and are reported on std::cerr.
+
+class TextureLoader {
+public:
+    // texture for the image at path, decoded and uploaded in the background
+    // the texture of the first request of a file is returned for all later ones, regardless of name
+    static Texture2D load(const std::string& name, const fs::path& path, bool mipmap = true);
+    // upload decoded images up to budget_bytes (but at least one), returns the number of uploaded images
+    static size_t update(size_t budget_bytes = upload_budget);
+    // wait until all requested images are decoded and uploaded
+    static void finish();
+    // requested images not uploaded yet
+    static size_t pending();
+    // images uploaded so far, changes whenever a texture received its image
+    static uint64_t uploads();
+
+    static size_t upload_budget;                    // default bytes per update(), 16 MiB
+    static std::array<uint8_t, 4> placeholder;      // RGBA8 color of textures still loading
+};
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,51 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+CPPGL_NAMESPACE_BEGIN
+
+ThreadPool::ThreadPool(size_t threads) : stop(false) {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t, size_t)>& func, size_t grain) {
+    if (count == 0) return;
+    // a few chunks per worker to balance uneven work
+    const size_t chunk = std::max(std::max(grain, size_t(1)), (count + 4 * workers.size() - 1) / (4 * workers.size()));
+    std::vector<std::future<void>> chunks;
+    for (size_t begin = 0; begin < count; begin += chunk)
+        chunks.push_back(enqueue([&func, begin, end = std::min(count, begin + chunk)]() { func(begin, end); }));
+    // all chunks reference func, so wait for every chunk before rethrowing
+    for (auto& c : chunks)
+        c.wait();
+    for (auto& c : chunks)
+        c.get();
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+            if (stop && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include "platform.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// Fixed size pool of worker threads
+
+class ThreadPool {
+public:
+    // 0 threads: one per hardware thread
+    ThreadPool(size_t threads = 0);
+    virtual ~ThreadPool();
+
+    // prevent copies and moves, workers reference this pool
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // queue a task, its result (or exception) is available through the returned future
+    template <typename F> auto enqueue(F&& task) -> std::future<decltype(task())> {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        cv.notify_one();
+        return future;
+    }
+
+    // split [0, count) into chunks of at least grain elements, call func(begin, end) for each chunk on the workers and wait
+    // exceptions thrown by func are rethrown in the calling thread
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)>& func, size_t grain = 1);
+
+    size_t size() const { return workers.size(); }
+
+private:
+    void work();
+
+    // data
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop;
+};
+
+CPPGL_NAMESPACE_END
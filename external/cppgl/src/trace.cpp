@@ -0,0 +1,202 @@
+#include "trace.h"
+#include <deque>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------
+// recording state
+
+// cap on timestamp queries in use, markers beyond it are only traced on the CPU
+static const size_t trace_max_queries = 1 << 16;
+
+struct OpenMarker {
+    std::string name;
+    double start_us;
+    GLuint queries[2];
+    bool gpu;
+};
+
+struct PendingMarker {
+    TraceEvent event;
+    GLuint queries[2];
+};
+
+static bool trace_enabled = false;
+static size_t trace_max_events = 0;
+static uint64_t trace_frame = 0;
+static std::vector<TraceEvent> trace_events;
+static std::vector<OpenMarker> trace_stack;
+static std::deque<PendingMarker> trace_pending;
+static std::vector<GLuint> trace_free_queries;
+static size_t trace_queries = 0;
+static std::chrono::steady_clock::time_point trace_cpu_epoch;
+static GLint64 trace_gpu_epoch = 0;
+
+static double trace_now_us() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - trace_cpu_epoch).count();
+}
+
+static void trace_record(TraceEvent&& event) {
+    if (trace_events.size() < trace_max_events)
+        trace_events.push_back(std::move(event));
+}
+
+static bool trace_acquire_queries(GLuint* queries) {
+    if (trace_free_queries.size() < 2) {
+        if (trace_queries + 64 > trace_max_queries) return false;
+        GLuint ids[64];
+        glGenQueries(64, ids);
+        trace_free_queries.insert(trace_free_queries.end(), ids, ids + 64);
+        trace_queries += 64;
+    }
+    for (int i = 0; i < 2; i++) {
+        queries[i] = trace_free_queries.back();
+        trace_free_queries.pop_back();
+    }
+    return true;
+}
+
+// move the oldest pending GPU marker to the recorded events once its results are available (or block for them with wait)
+static bool trace_resolve_front(bool wait) {
+    PendingMarker& marker = trace_pending.front();
+    if (!wait) {
+        GLuint ready = GL_FALSE;
+        glGetQueryObjectuiv(marker.queries[1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return false;
+    }
+    GLuint64 start, stop;
+    glGetQueryObjectui64v(marker.queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(marker.queries[1], GL_QUERY_RESULT, &stop);
+    // GPU timestamps are mapped onto the CPU clock at the instant of Tracer::enable()
+    marker.event.start_us = double(GLint64(start) - trace_gpu_epoch) / 1000.0;
+    marker.event.duration_us = double(stop - start) / 1000.0;
+    trace_record(std::move(marker.event));
+    trace_free_queries.push_back(marker.queries[0]);
+    trace_free_queries.push_back(marker.queries[1]);
+    trace_pending.pop_front();
+    return true;
+}
+
+// -------------------------------------------
+// Tracer
+
+void Tracer::enable(size_t max_events) {
+    if (trace_enabled) disable();
+    trace_events.clear();
+    trace_max_events = max_events;
+    trace_frame = 0;
+    trace_cpu_epoch = std::chrono::steady_clock::now();
+    glGetInteger64v(GL_TIMESTAMP, &trace_gpu_epoch);
+    trace_enabled = true;
+}
+
+void Tracer::disable() {
+    if (!trace_enabled) return;
+    while (!trace_stack.empty()) end();
+    while (!trace_pending.empty()) trace_resolve_front(true);
+    if (!trace_free_queries.empty())
+        glDeleteQueries(GLsizei(trace_free_queries.size()), trace_free_queries.data());
+    trace_free_queries.clear();
+    trace_queries = 0;
+    trace_enabled = false;
+}
+
+bool Tracer::enabled() { return trace_enabled; }
+
+void Tracer::begin(const std::string& name) {
+    if (!trace_enabled) return;
+    OpenMarker marker;
+    marker.name = name;
+    marker.gpu = trace_acquire_queries(marker.queries);
+    if (marker.gpu) glQueryCounter(marker.queries[0], GL_TIMESTAMP);
+    marker.start_us = trace_now_us();
+    trace_stack.push_back(std::move(marker));
+}
+
+void Tracer::end() {
+    if (!trace_enabled || trace_stack.empty()) return;
+    OpenMarker& marker = trace_stack.back();
+    const uint32_t depth = uint32_t(trace_stack.size() - 1);
+    if (marker.gpu) {
+        glQueryCounter(marker.queries[1], GL_TIMESTAMP);
+        trace_pending.push_back(PendingMarker{ TraceEvent{ marker.name, true, depth, trace_frame, 0, 0 }, { marker.queries[0], marker.queries[1] } });
+    }
+    trace_record(TraceEvent{ std::move(marker.name), false, depth, trace_frame, marker.start_us, trace_now_us() - marker.start_us });
+    trace_stack.pop_back();
+}
+
+void Tracer::frame() {
+    if (!trace_enabled) return;
+    while (!trace_pending.empty() && trace_resolve_front(false));
+    trace_frame++;
+}
+
+const std::vector<TraceEvent>& Tracer::events() { return trace_events; }
+
+void Tracer::export_trace(const std::filesystem::path& path) {
+    if (path.extension() == ".csv")
+        export_csv(path);
+    else
+        export_chrome(path);
+}
+
+static std::string json_escape(const std::string& str) {
+    std::string escaped;
+    for (const char c : str) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (c >= 0 && c < 0x20) continue;
+        escaped += c;
+    }
+    return escaped;
+}
+
+void Tracer::export_chrome(const std::filesystem::path& path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Tracer: unable to write " + path.string());
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}}," << std::endl;
+    out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}";
+    for (const auto& event : trace_events) {
+        out << "," << std::endl << "{\"name\": \"" << json_escape(event.name) << "\", \"cat\": \"" << (event.gpu ? "gpu" : "cpu")
+            << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << (event.gpu ? 2 : 1) << ", \"ts\": " << event.start_us
+            << ", \"dur\": " << event.duration_us << ", \"args\": {\"frame\": " << event.frame << "}}";
+    }
+    out << std::endl << "]}" << std::endl;
+}
+
+static std::string csv_escape(const std::string& str) {
+    std::string escaped;
+    for (const char c : str) {
+        if (c == '"') escaped += '"';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void Tracer::export_csv(const std::filesystem::path& path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Tracer: unable to write " + path.string());
+    out << std::fixed << std::setprecision(4);
+    out << "frame,track,depth,name,start_ms,duration_ms" << std::endl;
+    for (const auto& event : trace_events)
+        out << event.frame << "," << (event.gpu ? "gpu" : "cpu") << "," << event.depth << ",\"" << csv_escape(event.name) << "\","
+            << event.start_us / 1000.0 << "," << event.duration_us / 1000.0 << std::endl;
+}
+
+// -------------------------------------------
+// TraceScope
+
+TraceScope::TraceScope(const char* name, int index) : active(Tracer::enabled()) {
+    if (active) Tracer::begin(index < 0 ? std::string(name) : std::string(name) + " " + std::to_string(index));
+}
+
+TraceScope::~TraceScope() {
+    if (active) Tracer::end();
+}
+
+CPPGL_NAMESPACE_END
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include "platform.h"
+
+CPPGL_NAMESPACE_BEGIN
+
+// -------------------------------------------------------
+// Per-stage tracing with nested CPU/GPU markers
+// GPU markers are timestamp query pairs that are read once available, so tracing never stalls the pipeline
+
+struct TraceEvent {
+    std::string name;
+    bool gpu;                       // GPU track (timestamp queries) or CPU track
+    uint32_t depth;                 // nesting level of the marker
+    uint64_t frame;                 // frame the marker was issued in (see Tracer::frame())
+    double start_us, duration_us;   // start relative to Tracer::enable()
+};
+
+class Tracer {
+public:
+    // start recording (discards previous events), at most max_events are kept
+    static void enable(size_t max_events = 1 << 20);
+    // stop recording, waits for the results of outstanding GPU markers
+    static void disable();
+    static bool enabled();
+
+    // open/close a marker on both tracks, markers nest
+    static void begin(const std::string& name);
+    static void end();
+    // read available GPU results and advance the frame counter (called by Context::swap_buffers)
+    static void frame();
+
+    static const std::vector<TraceEvent>& events();
+    // write all recorded events as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or CSV (.csv extension)
+    static void export_trace(const std::filesystem::path& path);
+    static void export_chrome(const std::filesystem::path& path);
+    static void export_csv(const std::filesystem::path& path);
+};
+
+// marker for the enclosing scope, named "<name> <index>" if an index is given
+// the name is only formatted while tracing, so disabled markers cost a branch
+class TraceScope {
+public:
+    TraceScope(const char* name, int index = -1);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    bool active;
+};
+
+CPPGL_NAMESPACE_END
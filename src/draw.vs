@@ -3,14 +3,28 @@ layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec3 in_norm;
 layout (location = 2) in vec2 in_tc;
 
+//View and projection matrix of the rendered view, each view binds its own range of the buffer
+layout (std140) uniform ViewMatrices {
+    mat4 view;
+    mat4 proj;
+};
+
+#ifdef ARENA
+//Model matrices of all drawelements drawn from the geometry arena (4 texels each), selected by the index of the draw
+uniform samplerBuffer arena_models;
+layout (location = 3) in uint in_draw;
+#else
 uniform mat4 model;
-uniform mat4 view_normal;
-uniform mat4 view;
-uniform mat4 proj;
+#endif
 
 out vec2 tc;
 
 void main() {
+#ifdef ARENA
+    int texel = int(in_draw) * 4;
+    mat4 model = mat4(texelFetch(arena_models, texel), texelFetch(arena_models, texel + 1),
+                      texelFetch(arena_models, texel + 2), texelFetch(arena_models, texel + 3));
+#endif
     tc = in_tc;
     gl_Position = proj * view * model * vec4(in_pos, 1.0);
 }
@@ -0,0 +1,30 @@
+#version 330
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_norm;
+layout (location = 2) in vec2 in_tc;
+
+#define MAX_VIEWS 128
+
+//View-projection matrix and quilt tile (xy: scale, zw: offset in clip space) of every view, one instance per view
+layout (std140) uniform LightfieldViews {
+    mat4 view_proj[MAX_VIEWS];
+    vec4 tile[MAX_VIEWS];
+};
+
+uniform mat4 model;
+
+out vec2 tc;
+out float gl_ClipDistance[4];
+
+void main() {
+    tc = in_tc;
+    vec4 pos = view_proj[gl_InstanceID] * model * vec4(in_pos, 1.0);
+    //clip against the borders of the view, since viewport and scissor now span the whole quilt
+    gl_ClipDistance[0] = pos.w + pos.x;
+    gl_ClipDistance[1] = pos.w - pos.x;
+    gl_ClipDistance[2] = pos.w + pos.y;
+    gl_ClipDistance[3] = pos.w - pos.y;
+    //move the view into its quilt tile
+    pos.xy = pos.xy * tile[gl_InstanceID].xy + pos.w * tile[gl_InstanceID].zw;
+    gl_Position = pos;
+}
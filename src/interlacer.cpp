@@ -0,0 +1,225 @@
+#include "interlacer.h"
+#include <cmath>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+
+Interlacer::Interlacer(const InterlacingParameters& parameters, bool ourAlgorithm) : params(parameters), ourAlgorithm(ourAlgorithm) {
+    cosTilt = cosf(-params.tilt_angle);
+    sinTilt = sinf(-params.tilt_angle);
+    tanTilt = tanf(-params.tilt_angle);
+    sinTiltPositive = sinf(params.tilt_angle);
+    invPitchD = 1.0f / params.pitch_d;
+    viewShift = float(params.pr_tl - params.pr_total / 2) / params.tile.z;
+}
+
+
+
+//Interlaces the quilt into the image, both RGBA8 with rows from bottom to top
+void Interlacer::interlace(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* image, int imageWidth, int imageHeight, cppgl::ThreadPool& pool) const {
+    pool.parallel_for(size_t(imageHeight), [&](size_t begin, size_t end) {
+        for (int y = int(begin); y < int(end); y++) {
+            uint8_t* row = image + size_t(y) * imageWidth * 4;
+            int x = 0;
+#ifdef __AVX2__
+            x = interlaceRowAVX2(quilt, quiltWidth, quiltHeight, row, y, imageWidth, imageHeight);
+#endif
+            interlaceRowScalar(quilt, quiltWidth, quiltHeight, row, y, x, imageWidth, imageHeight);
+        }
+    });
+}
+
+
+
+//Transforms the texture coordinates to the position of the given view in the quilt, see readColor() of the interlacing shaders
+glm::vec2 Interlacer::readColor(glm::vec2 tc, float index) const {
+    if (!ourAlgorithm) {
+        float x = (index - params.tile.x * floorf(index / params.tile.x) + tc.x) / params.tile.x;
+        float y = (floorf(index / params.tile.x) + tc.y) / params.tile.y;
+        return glm::vec2(x, y);
+    }
+
+    glm::vec2 tc_new;
+    if (params.tilt_angle < 0)
+        tc_new.x = (cosTilt * params.aspect_ratio * (tc.x + tanTilt / params.aspect_ratio) - sinTilt * tc.y) / (params.aspect_ratio_n * params.fovFactor);
+    else
+        tc_new.x = (cosTilt * params.aspect_ratio * tc.x - sinTilt * tc.y) / (params.aspect_ratio_n * params.fovFactor);
+    float si_reverse;
+    if (params.invView != 1)
+        si_reverse = -(params.tile.z - index) / params.tile.z + 0.5f;
+    else
+        si_reverse = index / params.tile.z + 0.5f;
+    tc_new.x += (si_reverse + viewShift) * invPitchD;
+
+    if (params.tilt_angle < 0)
+        tc_new.y = (cosTilt * tc.y + sinTilt * tc.x * params.aspect_ratio) / params.fovFactor;
+    else
+        tc_new.y = (cosTilt * tc.y + sinTilt * tc.x * params.aspect_ratio + sinTiltPositive * params.aspect_ratio) / params.fovFactor;
+
+    float x = (index - params.tile.x * floorf(index / params.tile.x) + tc_new.x) / params.tile.x;
+    float y = (floorf(index / params.tile.x) + tc_new.y) / params.tile.y;
+    return glm::vec2(x, y);
+}
+
+
+
+//Bilinear lookup of one channel like a GL_LINEAR texture with GL_REPEAT wrapping
+static float sampleChannel(const uint8_t* quilt, int w, int h, glm::vec2 tc, int channel) {
+    const float u = tc.x * w - 0.5f;
+    const float v = tc.y * h - 0.5f;
+    const float u0 = floorf(u);
+    const float v0 = floorf(v);
+    const float a = u - u0;
+    const float b = v - v0;
+    const int x0 = ((int(u0) % w) + w) % w;
+    const int y0 = ((int(v0) % h) + h) % h;
+    const int x1 = x0 + 1 == w ? 0 : x0 + 1;
+    const int y1 = y0 + 1 == h ? 0 : y0 + 1;
+    const float t00 = quilt[(size_t(y0) * w + x0) * 4 + channel];
+    const float t10 = quilt[(size_t(y0) * w + x1) * 4 + channel];
+    const float t01 = quilt[(size_t(y1) * w + x0) * 4 + channel];
+    const float t11 = quilt[(size_t(y1) * w + x1) * 4 + channel];
+    return ((t00 * (1.0f - a) + t10 * a) * (1.0f - b) + (t01 * (1.0f - a) + t11 * a) * b) * (1.0f / 255.0f);
+}
+
+
+
+void Interlacer::interlaceRowScalar(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* row, int y, int begin, int imageWidth, int imageHeight) const {
+    const float invert = params.invView == 1 ? -1.0f : 1.0f;
+    for (int x = begin; x < imageWidth; x++) {
+        const glm::vec2 texCoords = glm::vec2((x + 0.5f) / imageWidth, (y + 0.5f) / imageHeight);
+        for (int i = 0; i < 3; i++) {
+            float index = (texCoords.x + i * params.subp + texCoords.y * params.tilt) * params.pitch - params.center;
+            index = index + ceilf(fabsf(index));
+            index = index - floorf(index);
+            index *= invert;
+            index *= params.tile.z;
+            const float colB = sampleChannel(quilt, quiltWidth, quiltHeight, readColor(texCoords, floorf(index)), i);
+            const float colT = sampleChannel(quilt, quiltWidth, quiltHeight, readColor(texCoords, ceilf(index)), i);
+            const float weight = index - floorf(index);
+            const float color = colB * (1.0f - weight) + colT * weight;
+            row[x * 4 + i] = uint8_t(std::min(std::max(color, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        row[x * 4 + 3] = 255;
+    }
+}
+
+
+
+#ifdef __AVX2__
+//AVX2 versions of readColor() and sampleChannel() for eight pixels
+namespace {
+    inline __m256 floor8(__m256 v) { return _mm256_floor_ps(v); }
+    inline __m256 set8(float v) { return _mm256_set1_ps(v); }
+
+    //Positive remainder of integral values for GL_REPEAT wrapping
+    inline __m256i wrap8(__m256 v, float size) {
+        const __m256 wrapped = _mm256_sub_ps(v, _mm256_mul_ps(set8(size), floor8(_mm256_div_ps(v, set8(size)))));
+        return _mm256_cvttps_epi32(wrapped);
+    }
+
+    inline __m256 sampleChannel8(const uint8_t* quilt, int w, int h, __m256 tcx, __m256 tcy, int channel) {
+        const __m256 u = _mm256_sub_ps(_mm256_mul_ps(tcx, set8(float(w))), set8(0.5f));
+        const __m256 v = _mm256_sub_ps(_mm256_mul_ps(tcy, set8(float(h))), set8(0.5f));
+        const __m256 u0 = floor8(u);
+        const __m256 v0 = floor8(v);
+        const __m256 a = _mm256_sub_ps(u, u0);
+        const __m256 b = _mm256_sub_ps(v, v0);
+        const __m256i x0 = wrap8(u0, float(w));
+        const __m256i y0 = wrap8(v0, float(h));
+        //x0 + 1 wrapped to 0 at the border
+        const __m256i x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_add_epi32(x0, _mm256_set1_epi32(1)), _mm256_set1_epi32(w)), _mm256_add_epi32(x0, _mm256_set1_epi32(1)));
+        const __m256i y1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_add_epi32(y0, _mm256_set1_epi32(1)), _mm256_set1_epi32(h)), _mm256_add_epi32(y0, _mm256_set1_epi32(1)));
+        const __m256i row0 = _mm256_mullo_epi32(y0, _mm256_set1_epi32(w));
+        const __m256i row1 = _mm256_mullo_epi32(y1, _mm256_set1_epi32(w));
+
+        //Gather whole RGBA8 texels and extract the channel
+        const int* texels = reinterpret_cast<const int*>(quilt);
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m128i shift = _mm_cvtsi32_si128(8 * channel);
+        auto fetch = [&](__m256i row, __m256i x) {
+            const __m256i texel = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row, x), 4);
+            return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(texel, shift), mask));
+        };
+        const __m256 t00 = fetch(row0, x0);
+        const __m256 t10 = fetch(row0, x1);
+        const __m256 t01 = fetch(row1, x0);
+        const __m256 t11 = fetch(row1, x1);
+
+        const __m256 one_a = _mm256_sub_ps(set8(1.0f), a);
+        const __m256 one_b = _mm256_sub_ps(set8(1.0f), b);
+        const __m256 top = _mm256_add_ps(_mm256_mul_ps(t00, one_a), _mm256_mul_ps(t10, a));
+        const __m256 bottom = _mm256_add_ps(_mm256_mul_ps(t01, one_a), _mm256_mul_ps(t11, a));
+        return _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(top, one_b), _mm256_mul_ps(bottom, b)), set8(1.0f / 255.0f));
+    }
+}
+
+
+
+int Interlacer::interlaceRowAVX2(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* row, int y, int imageWidth, int imageHeight) const {
+    const InterlacingParameters& p = params;
+    const __m256 invert = set8(p.invView == 1 ? -1.0f : 1.0f);
+    const __m256 tcy = set8((y + 0.5f) / imageHeight);
+    const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+
+    //readColor() for eight view indices
+    auto readColor8 = [&](__m256 tcx, __m256 index, __m256& x, __m256& y) {
+        __m256 tx = tcx, ty = tcy;
+        if (ourAlgorithm) {
+            const __m256 ar = set8(p.aspect_ratio);
+            if (p.tilt_angle < 0)
+                tx = _mm256_mul_ps(_mm256_mul_ps(set8(cosTilt), ar), _mm256_add_ps(tcx, set8(tanTilt / p.aspect_ratio)));
+            else
+                tx = _mm256_mul_ps(_mm256_mul_ps(set8(cosTilt), ar), tcx);
+            tx = _mm256_div_ps(_mm256_sub_ps(tx, _mm256_mul_ps(set8(sinTilt), tcy)), set8(p.aspect_ratio_n * p.fovFactor));
+            __m256 si_reverse;
+            if (p.invView != 1)
+                si_reverse = _mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(index, set8(p.tile.z)), set8(p.tile.z)), set8(0.5f));
+            else
+                si_reverse = _mm256_add_ps(_mm256_div_ps(index, set8(p.tile.z)), set8(0.5f));
+            tx = _mm256_add_ps(tx, _mm256_mul_ps(_mm256_add_ps(si_reverse, set8(viewShift)), set8(invPitchD)));
+
+            ty = _mm256_add_ps(_mm256_mul_ps(set8(cosTilt), tcy), _mm256_mul_ps(_mm256_mul_ps(set8(sinTilt), tcx), ar));
+            if (p.tilt_angle >= 0)
+                ty = _mm256_add_ps(ty, set8(sinTiltPositive * p.aspect_ratio));
+            ty = _mm256_div_ps(ty, set8(p.fovFactor));
+        }
+        const __m256 column = floor8(_mm256_div_ps(index, set8(p.tile.x)));
+        x = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(index, _mm256_mul_ps(set8(p.tile.x), column)), tx), set8(p.tile.x));
+        y = _mm256_div_ps(_mm256_add_ps(column, ty), set8(p.tile.y));
+    };
+
+    int x = 0;
+    for (; x + 8 <= imageWidth; x += 8) {
+        const __m256 tcx = _mm256_div_ps(_mm256_add_ps(set8(float(x)), lane), set8(float(imageWidth)));
+        __m256i channels[3];
+        for (int i = 0; i < 3; i++) {
+            __m256 index = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(tcx, set8(i * p.subp)), _mm256_mul_ps(tcy, set8(p.tilt))), set8(p.pitch)), set8(p.center));
+            const __m256 absIndex = _mm256_andnot_ps(set8(-0.0f), index);
+            index = _mm256_add_ps(index, _mm256_ceil_ps(absIndex));
+            index = _mm256_sub_ps(index, floor8(index));
+            index = _mm256_mul_ps(_mm256_mul_ps(index, invert), set8(p.tile.z));
+
+            const __m256 indexB = floor8(index);
+            const __m256 indexT = _mm256_ceil_ps(index);
+            __m256 bx, by, tx, ty;
+            readColor8(tcx, indexB, bx, by);
+            readColor8(tcx, indexT, tx, ty);
+            const __m256 colB = sampleChannel8(quilt, quiltWidth, quiltHeight, bx, by, i);
+            const __m256 colT = sampleChannel8(quilt, quiltWidth, quiltHeight, tx, ty, i);
+            const __m256 weight = _mm256_sub_ps(index, indexB);
+            __m256 color = _mm256_add_ps(_mm256_mul_ps(colB, _mm256_sub_ps(set8(1.0f), weight)), _mm256_mul_ps(colT, weight));
+            color = _mm256_min_ps(_mm256_max_ps(color, set8(0.0f)), set8(1.0f));
+            channels[i] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(color, set8(255.0f)), set8(0.5f)));
+        }
+        //Pack to RGBA8 with alpha 255
+        const __m256i rgba = _mm256_or_si256(_mm256_or_si256(channels[0], _mm256_slli_epi32(channels[1], 8)),
+                                             _mm256_or_si256(_mm256_slli_epi32(channels[2], 16), _mm256_set1_epi32(int(0xff000000))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x * 4), rgba);
+    }
+    return x;
+}
+#endif
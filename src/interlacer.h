@@ -0,0 +1,56 @@
+#pragma once
+#include <cppgl.h>
+#include <cstdint>
+
+
+//Parameters of the interlacing shaders interlacingShaderStandard.fs and interlacingShaderEfficient.fs
+//Derived by Lightfield::getInterlacingParameters() from the calibration and the adapted projective mapping
+struct InterlacingParameters {
+    //Calibration values
+    float pitch = 1.0f;
+    float tilt = 0.0f;
+    float center = 0.0f;
+    int invView = 0;
+    float subp = 0.0f;
+    float aspect_ratio = 0.5f;
+
+    //Quilt settings: columns, rows, number of views
+    glm::vec3 tile = glm::vec3(1.0f);
+
+    //Parameters of the adapted projective mapping
+    float tilt_angle = 0.5f;
+    float pitch_d = 1.0f;
+    float fovFactor = 1.0f;
+    float aspect_ratio_n = 0.5f;
+    int pr_tl = 0;
+    int pr_total = 0;
+};
+
+
+
+//CPU implementation of the interlacing shaders for offline quilt to panel conversion and as reference for the GPU path
+//Follows the shaders operation by operation in single precision, the quilt is sampled like a GL_LINEAR/GL_REPEAT texture
+//Images are RGBA8 with rows from bottom to top (as returned by cppgl::image_load and glReadPixels)
+//Rows are distributed over the given thread pool, with AVX2 eight pixels of a row are interlaced at once
+class Interlacer {
+public:
+    Interlacer(const InterlacingParameters& parameters, bool ourAlgorithm);
+
+    void interlace(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* image, int imageWidth, int imageHeight, cppgl::ThreadPool& pool) const;
+
+    //Interlaces the pixels [begin, imageWidth) of row y without SIMD, used for the remainder of a row and as reference for the AVX2 path
+    void interlaceRowScalar(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* row, int y, int begin, int imageWidth, int imageHeight) const;
+#ifdef __AVX2__
+    //Interlaces row y eight pixels at a time and returns the number of pixels written
+    int interlaceRowAVX2(const uint8_t* quilt, int quiltWidth, int quiltHeight, uint8_t* row, int y, int imageWidth, int imageHeight) const;
+#endif
+
+private:
+    InterlacingParameters params;
+    bool ourAlgorithm;
+
+    //Terms of readColor() in interlacingShaderEfficient.fs that only depend on the parameters
+    float cosTilt, sinTilt, tanTilt, sinTiltPositive, invPitchD, viewShift;
+
+    glm::vec2 readColor(glm::vec2 tc, float index) const;
+};
@@ -0,0 +1,32 @@
+#version 330 core
+in vec2 texCoords; 
+
+//Precomputes the view index of the interlacing shaders for every subpixel
+//Each channel holds the full index as float, so the interlacing shaders blend exactly as without lookup
+layout (location = 0) out vec4 viewLookup;
+ 
+//Calibration values 
+uniform float pitch; 
+uniform float tilt; 
+uniform float center; 
+uniform int invView; 
+uniform float subp; 
+
+//Quilt settings 
+uniform vec3 tile; 
+ 
+void main() 
+{ 
+	float invert = 1.0; 
+	if (invView == 1) invert = -1.0; 
+	vec4 views = vec4(0.0); float index;
+	for (int i=0; i < 3; i++) 
+	{ 
+		index = (texCoords.x + i * subp + texCoords.y * tilt) * pitch - center; 
+		index = mod(index + ceil(abs(index)), 1.0); 
+		index *= invert; 
+		index *= tile.z; 
+		views[i] = index; 
+	} 
+	viewLookup = views;
+}
@@ -3,6 +3,23 @@ in vec2 texCoords;
 
 out vec4 fragColor; 
  
+#ifdef BAKED_CALIBRATION
+//Calibration values, quilt settings and parameters of the adapted projective mapping as compile time constants
+//Set by Lightfield::specializeInterlacingShader, so that the transforms and branches below are folded by the compiler
+const float pitch = PITCH;
+const float tilt = TILT;
+const float center = CENTER;
+const int invView = INV_VIEW;
+const float subp = SUBP;
+const float aspect_ratio = ASPECT_RATIO;
+const vec3 tile = TILE;
+const float tilt_angle = TILT_ANGLE;
+const float pitch_d = PITCH_D;
+const float fovFactor = FOV_FACTOR;
+const float aspect_ratio_n = ASPECT_RATIO_N;
+const int pr_tl = PR_TL;
+const int pr_total = PR_TOTAL;
+#else
 //Calibration values 
 uniform float pitch; 
 uniform float tilt; 
@@ -13,7 +30,6 @@ uniform float aspect_ratio;
 
 //Quilt settings 
 uniform vec3 tile; 
-uniform sampler2D quilt;
 
 //Parameters of the adapted projective mapping
 uniform float tilt_angle;
@@ -22,9 +38,17 @@ uniform float fovFactor;
 uniform float aspect_ratio_n;
 uniform int pr_tl;
 uniform int pr_total;
+#endif
+uniform sampler2D quilt;
+
+#ifdef VIEW_LOOKUP
+//Precomputed view index per subpixel, see interlacingLookup.fs
+uniform sampler2D view_lookup;
+#endif
  
-//Transform the texture coordinates and read the original color from the selected quilt view index
-vec2 readColor(vec2 tc, float index) 
+//Transform the texture coordinates into the local coordinates of the views
+//Independent of the view index, so this is done once per pixel instead of once per quilt read
+vec2 transformCoords(vec2 tc) 
 { 
 	vec2 tc_new;
 	//Transform local x texture coordinate - formulas stem from inverted matrices
@@ -36,16 +60,6 @@ vec2 readColor(vec2 tc, float index)
 		tc_new.x = (cos(-tilt_angle) * aspect_ratio * tc.x  -  sin(-tilt_angle) * tc.y)
 						/ (aspect_ratio_n * fovFactor);
 	}
-	//Reset projection matrix skew parameter
-	float si_reverse;                                
-	if (invView != 1){
-		si_reverse = -(tile.z-index) / tile.z + 0.5;                             
-	}
-	else{
-		si_reverse = index / tile.z + 0.5;
-	}
-	tc_new.x += (si_reverse + (pr_tl - pr_total/2) / tile.z)  *  (1.0f / pitch_d);
-
 
 	//Transform local y texture coordinate - formulas stem from inverted matrices
 	if(tilt_angle<0) {
@@ -56,7 +70,22 @@ vec2 readColor(vec2 tc, float index)
 		tc_new.y = (cos(-tilt_angle) * tc.y  +  sin(-tilt_angle) * tc.x * aspect_ratio  +  sin(tilt_angle) * aspect_ratio) 
 						/ fovFactor;
 	}
-	
+	return tc_new;
+}
+
+//Read the original color from the selected quilt view index at the transformed texture coordinates
+vec2 readColor(vec2 tc_new, float index) 
+{ 
+	//Reset projection matrix skew parameter
+	float si_reverse;                                
+	if (invView != 1){
+		si_reverse = -(tile.z-index) / tile.z + 0.5;                             
+	}
+	else{
+		si_reverse = index / tile.z + 0.5;
+	}
+	tc_new.x += (si_reverse + (pr_tl - pr_total/2) / tile.z)  *  (1.0f / pitch_d);
+
 	//Transform local texture coordinates to the position of the desired view in the quilt
 	float x = (mod(index, tile.x) + tc_new.x) / tile.x ; 
 	float y = (floor(index / tile.x) + tc_new.y) / tile.y; 
@@ -67,19 +96,29 @@ vec2 readColor(vec2 tc, float index)
  
 void main() 
 { 		
+	vec2 tc_new = transformCoords(texCoords);
+#ifdef VIEW_LOOKUP
+	//texCoords instead of gl_FragCoord, which is offset by the origin of the viewport
+	vec4 views = texelFetch(view_lookup, ivec2(texCoords * vec2(textureSize(view_lookup, 0))), 0);
+#else
 	float invert = 1.0; 
 	if (invView == 1) invert = -1.0; 
+#endif
 	vec4 rgb[3]; float index;
 	for (int i=0; i < 3; i++) 
 	{ 
+#ifdef VIEW_LOOKUP
+		index = views[i]; 
+#else
 		index = (texCoords.x + i * subp + texCoords.y * tilt) * pitch - center; 
 		index = mod(index + ceil(abs(index)), 1.0); 
 		index *= invert; 
 		index *= tile.z; 
-		vec4 colB = texture(quilt, readColor(texCoords, floor(index))); 
-		vec4 colT = texture(quilt, readColor(texCoords, ceil(index))); 
+#endif
+		vec4 colB = texture(quilt, readColor(tc_new, floor(index))); 
+		vec4 colT = texture(quilt, readColor(tc_new, ceil(index))); 
 		rgb[i] = mix(colB, colT, index - floor(index)); 
 	} 
 	fragColor = vec4(rgb[0].r, rgb[1].g, rgb[2].b, 1.0); 
 	
-} 
\ No newline at end of file
+}
\ No newline at end of file
@@ -4,6 +4,15 @@ in vec2 texCoords;
 //Inspired by Looking Glass SDK: HoloPlayShaders.h
 out vec4 fragColor; 
  
+#ifdef BAKED_CALIBRATION
+// Calibration values and quilt settings as compile time constants, set by Lightfield::specializeInterlacingShader
+const float pitch = PITCH;
+const float tilt = TILT;
+const float center = CENTER;
+const int invView = INV_VIEW;
+const float subp = SUBP;
+const vec3 tile = TILE;
+#else
 // Calibration values 
 uniform float pitch; 
 uniform float tilt; 
@@ -13,7 +22,13 @@ uniform float subp;
  
 // Quilt settings 
 uniform vec3 tile; 
+#endif
 uniform sampler2D quilt; 
+
+#ifdef VIEW_LOOKUP
+// Precomputed view index per subpixel, see interlacingLookup.fs
+uniform sampler2D view_lookup;
+#endif
  
 //Read the color from the selected quilt view index
 vec2 readColor(vec2 tc, float index) 
@@ -26,15 +41,24 @@ vec2 readColor(vec2 tc, float index)
  
 void main() 
 { 
+#ifdef VIEW_LOOKUP
+	//texCoords instead of gl_FragCoord, which is offset by the origin of the viewport
+	vec4 views = texelFetch(view_lookup, ivec2(texCoords * vec2(textureSize(view_lookup, 0))), 0);
+#else
 	float invert = 1.0; 
 	if (invView == 1) invert = -1.0; 
+#endif
 	vec4 rgb[3]; float index;
 	for (int i=0; i < 3; i++) 
 	{ 
+#ifdef VIEW_LOOKUP
+		index = views[i]; 
+#else
 		index = (texCoords.x + i * subp + texCoords.y * tilt) * pitch - center; 
 		index = mod(index + ceil(abs(index)), 1.0); 
 		index *= invert; 
 		index *= tile.z; 
+#endif
 		vec4 colB = texture(quilt, readColor(texCoords, floor(index))); 
 		vec4 colT = texture(quilt, readColor(texCoords, ceil(index))); 
 		rgb[i] = mix(colB, colT, index - floor(index)); 
@@ -1,6 +1,12 @@
 #include <cppgl.h>
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include "interlacer.h"
 
 
 using namespace cppgl;
@@ -9,15 +15,62 @@ class Lightfield {
 public:
     int imageWidth = 0;    //Width of the interlaced image of the lightfield display in pixels
     int imageHeight = 0;   //Height of the interlaced image of the lightfield display in pixels
+    bool singlePassRendering = false;   //Render all views with one instanced draw call per drawelement instead of one pass per view
+
+    //Shader variants used for interlacing
+    //Uniforms: calibration passed as uniforms, Specialized: calibration baked in as compile time constants,
+    //Lookup: baked calibration and precomputed view indices and blend weights per subpixel
+    enum class InterlacingVariant { Uniforms, Specialized, Lookup };
+    InterlacingVariant interlacingVariant = InterlacingVariant::Specialized;
+
+    //Reuse the quilt and the interlaced image of the previous frame if camera, drawelements and parameters are unchanged
+    bool skipUnchangedFrames = true;
+
+    //Draw drawelements only into the views whose frustum intersects their bounding box
+    bool frustumCulling = true;
+
+    //Pack the meshes into a shared geometry arena and draw the drawelements with the same shader and material with a
+    //single (indirect) draw per view, see buildDrawBatches(), only used by multi-pass rendering
+    bool geometryBatching = true;
+
+    //Rasterize only every k-th view (and the last one) and synthesize the views in between by warping their two
+    //rendered neighbours with the quilt depth, 1 renders all views, see synthesizeViews()
+    int synthesisStride = 1;
+    //Relative view space depth difference within a warped grid cell above which the cell is treated as a disocclusion
+    float synthesisDepthThreshold = 0.05f;
+
+    //Quality of the synthesized views of the current synthesisStride against fully rendered views, see measureSynthesisQuality()
+    struct SynthesisQuality {
+        int synthesizedViews = 0;
+        double psnrMean = 0.0;      //Mean PSNR of the synthesized views in dB (8 bit RGB)
+        double psnrMin = 0.0;       //PSNR of the worst synthesized view in dB
+    };
+
+    //Internal format of the quilt color buffers: GL_RGBA8, GL_RGB10_A2, GL_RGBA16F or GL_RGBA32F, applied by setupQuilts()
+    GLint quiltFormat = GL_RGBA8;
 
     Lightfield();
     inline virtual ~Lightfield();
     void setLightfieldParameters();
+    void loadCalibration(const std::string& path);
+    void setViewParameters(int number_of_views, int rows, int columns, int quiltwidth, int quiltheight);
+    void setDisplayResolution(int imageWidth, int imageHeight);
     void calculateRotatedBoundingBoxDimensions();
     void getFrustumParameters();
-    void setupQuilts();
+    void setupQuilts(bool ourAlgorithm = true);
+    Framebuffer getQuilt(bool ourAlgorithm);
+    void releaseQuilt(bool ourAlgorithm);
+    size_t getQuiltMemory() const;
     void viewRendering(bool ourAlgorithm);
     void interlacing(bool ourAlgorithm);
+    glm::ivec2 getQuiltDimensions(bool ourAlgorithm) const;
+    static glm::ivec2 getTileLayout(int views);
+    InterlacingParameters getInterlacingParameters() const;
+    uint64_t getCalibrationHash() const;
+    const CullingStats& getCullingStats() const;
+    bool isRenderedView(int viewIndex) const;
+    SynthesisQuality measureSynthesisQuality(bool ourAlgorithm);
+    void invalidate();
 
 private:
     //Display specific parameters
@@ -50,9 +103,105 @@ private:
     int diagonal_pitch = 1;     //Full pitch in the image diagonal resulting from the rotation with the tilt angle
 
 
+    //Uniform block of draw_multiview.vs holding the matrices and quilt tiles of all views for single-pass rendering
+    static const int maxSinglePassViews = 128;
+    struct LightfieldViews {
+        glm::mat4 view_proj[maxSinglePassViews];
+        glm::vec4 tile[maxSinglePassViews];
+    } views;
+    //Ring of one LightfieldViews block per frame in flight (see FramePacer), so uploads never wait for the GPU
+    UBO viewsUBO;
+    uint64_t viewsUploadFrame = UINT64_MAX;  //Frame of the last upload into the ring
+
+    //Uniform block of draw.vs holding the matrices of one view for multi-pass rendering
+    struct ViewMatrices {
+        glm::mat4 view;
+        glm::mat4 proj;
+    };
+    //Ring of the ViewMatrices of all views per frame in flight, each view binds its range of the current slot
+    UBO viewMatricesUBO;
+    uint64_t viewMatricesUploadFrame = UINT64_MAX;
+    std::vector<uint8_t> viewMatricesData;
+
+    //Quilts of the standard [0] and our [1] algorithm, allocated on first use by getQuilt()
+    Framebuffer quilts[2];
+    bool quiltValid[2] = { false, false };  //Quilt holds the current scene, see viewRendering()
+    int quiltSynthesisStride[2] = { 1, 1 }; //synthesisStride the quilt was rendered with
+    uint64_t quiltTextureUploads[2] = { 0, 0 };    //TextureLoader::uploads() the quilt was rendered with
+
+    //Handles resolved by name once instead of every frame, looked up again when they went stale
+    HandleId cameraId;
+    std::vector<Shader> multiviewShaders;       //Per drawelement (Drawelement::all() order): "_multiview" variant of its shader
+    //Depth buffer shared by both quilts, sized to enclose the larger one
+    Texture2D quiltDepth;
+
+    //Interlacing shaders with the calibration baked in for [ourAlgorithm][viewLookup], compiled on first use after each getFrustumParameters()
+    Shader specializedInterlacingShaders[2][2];
+    //View index per subpixel at the resolution of the interlaced image, see interlacingLookup.fs
+    Framebuffer viewLookup;
+
+    //Per view matrices of the standard [0] and our [1] algorithm, recomputed by updateFrusta() when the camera moves
+    struct Frusta {
+        bool valid = false;
+        glm::mat4 cameraView = glm::mat4(1);
+        std::vector<glm::mat4> view, proj;
+    } frusta[2];
+
+    //State of a drawelement the quilts were rendered with, see updateSceneState()
+    struct DrawelementState {
+        const DrawelementImpl* drawelement;
+        const MeshImpl* mesh;
+        uint64_t meshRevision;
+        GLuint shader;
+        glm::mat4 model;
+    };
+    std::vector<DrawelementState> quiltScene[2];
+
+    //Bounding boxes of the drawelements with a geometry, tested against the frusta of all views by cullDrawelements()
+    FrustumCuller culler;
+    std::vector<uint32_t> culledDrawelements;       //Drawelement (Drawelement::all() order) of each box of the culler
+    std::vector<uint32_t> unboundedDrawelements;    //Drawelements without geometry, drawn into all views
+    std::vector<std::vector<uint32_t>> visibleDrawelements;     //Per view: indices of the visible boxes
+    std::vector<std::vector<uint32_t>> drawelementViews;        //Per drawelement: views it is visible in, ascending
+
+    //Drawelements drawn from the geometry arena, grouped by the "_arena" variant of their shader and their material
+    struct DrawBatch {
+        Shader shader;
+        Material material;
+        std::vector<ArenaDraw> draws;       //Draw index: the drawelement (Drawelement::all() order)
+    };
+    std::unique_ptr<GeometryArena> arena;
+    std::vector<DrawBatch> drawBatches;
+    std::vector<uint32_t> unbatchedDrawelements;    //Drawelements drawn one by one
+    bool drawBatchesValid = false;
+    bool drawBatchesEnabled = false;                //geometryBatching the batches were built with
+    std::vector<std::vector<ArenaDraw>> viewDraws;  //Per view: draws of the current batch
+
+    //Copy of the rendered views and their depth, sampled while the synthesized views are written to the quilt
+    Framebuffer synthesisSource;
+
+    //Copy of the last interlaced image, presented instead of interlacing again if nothing changed
+    Framebuffer interlacedImage;
+    bool interlacedValid = false;
+    bool interlacedAlgorithm = true;
+    InterlacingVariant interlacedVariant = InterlacingVariant::Specialized;
+    GLint interlacedTarget = 0;
+
     glm::ivec2 getRotatedBBDimensions(float lenx, float leny);
     float getIndex(float x, float y, float pitch);
-    std::vector<glm::mat4> generateFrustaMatrices(glm::mat4 currentViewMatrix, int i, bool ourAlgorithm);
+    void generateFrustaMatrices(const glm::mat4& currentViewMatrix, int i, bool ourAlgorithm, glm::mat4& viewMatrix, glm::mat4& projectionMatrix) const;
+    void viewRenderingSinglePass(bool ourAlgorithm, int qs_viewWidth, int qs_viewHeight);
+    size_t uploadFrameBlock(UBO& ubo, uint64_t& uploadFrame, const std::string& name, const void* data, size_t size);
+    bool updateFrusta(bool ourAlgorithm);
+    bool updateSceneState(bool ourAlgorithm);
+    void cullDrawelements(bool ourAlgorithm, bool sceneChanged);
+    void buildDrawBatches();
+    Shader arenaShader(const Shader& shader);
+    void synthesizeViews(bool ourAlgorithm, int qs_viewWidth, int qs_viewHeight);
+    void parametersChanged();
+    Shader specializeInterlacingShader(bool ourAlgorithm, bool lookup);
+    void updateViewLookup();
+    static std::string toGLSL(float value);
 
 };
 
@@ -96,6 +245,64 @@ void Lightfield::setLightfieldParameters() {
 
 
 
+//Overrides the display specific parameters with a Looking Glass calibration file (visual.json)
+//The interlacing parameters are derived like in the Looking Glass software: the pitch in lenticules per inch becomes
+//repetitions per image width along the x-axis, the slope becomes the tilt and the subpixel offset is a third pixel
+void Lightfield::loadCalibration(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open calibration file: " + path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    const std::string json = ss.str();
+
+    //Entries are stored as "key": {"value": x} (or "key": x), the first number after the key is its value
+    const auto value = [&](const std::string& key, float fallback) {
+        const size_t at = json.find("\"" + key + "\"");
+        if (at == std::string::npos) return fallback;
+        const size_t number = json.find_first_of("-+.0123456789", json.find(':', at));
+        return number == std::string::npos ? fallback : std::strtof(json.c_str() + number, nullptr);
+    };
+    const float screenW = value("screenW", NAN), screenH = value("screenH", NAN), dpi = value("DPI", NAN), slope = value("slope", NAN);
+    const float lenticulePitch = value("pitch", NAN);
+    if (std::isnan(screenW) || std::isnan(screenH) || std::isnan(dpi) || std::isnan(slope) || std::isnan(lenticulePitch) || slope == 0.0f)
+        throw std::runtime_error("Incomplete calibration file (expected pitch, slope, DPI, screenW and screenH): " + path);
+
+    pitch = lenticulePitch * screenW / dpi * cos(atan(1.0f / slope));
+    tilt = screenH / (screenW * slope);
+    if (value("flipImageX", 0.0f) != 0.0f) tilt = -tilt;
+    center = value("center", 0.0f);
+    subp = 1.0f / (3.0f * screenW);
+    invert = value("invView", 1.0f) != 0.0f;
+    viewCone = value("viewCone", viewCone);
+    setDisplayResolution(int(screenW), int(screenH));
+}
+
+
+
+//Overrides the user specific view and quilt parameters, e.g. for benchmark sweeps
+//Call before calculateRotatedBoundingBoxDimensions() and getFrustumParameters()
+void Lightfield::setViewParameters(int number_of_views, int rows, int columns, int quiltwidth, int quiltheight) {
+    this->number_of_views = number_of_views;
+    this->rows = rows;
+    this->columns = columns;
+    oldquiltwidth = quiltwidth;
+    oldquiltheight = quiltheight;
+}
+
+
+
+//Overrides the resolution of the interlaced image and updates the parameters derived from it
+//Call before calculateRotatedBoundingBoxDimensions() and getFrustumParameters()
+void Lightfield::setDisplayResolution(int imageWidth, int imageHeight) {
+    this->imageWidth = imageWidth;
+    this->imageHeight = imageHeight;
+    aspectRatio = float(imageWidth) / float(imageHeight);
+    tiltAngle = atan((tilt * imageWidth) / imageHeight);
+}
+
+
+
 
 //Calculates the rotated bounding box dimensions of individual views and the interlaced image
 void Lightfield::calculateRotatedBoundingBoxDimensions() {
@@ -188,31 +395,111 @@ void Lightfield::getFrustumParameters() {
         //Get new quilt dimensions 
         newquiltwidth = diagonal_pitch * columns;
         newquiltheight = BBDimensionsView.y * rows;   
+
+        parametersChanged();
+}
+
+
+
+//Drops everything derived from the parameters: frusta, quilt contents, interlacing shaders and the interlaced image
+void Lightfield::parametersChanged() {
+    for (auto& shaders : specializedInterlacingShaders)
+        shaders[0] = shaders[1] = Shader();
+    viewLookup = Framebuffer();
+    frusta[0].valid = frusta[1].valid = false;
+    invalidate();
+}
+
+
+
+//Forces view rendering and interlacing in the next frame, e.g. after changing materials, lights or shaders
+void Lightfield::invalidate() {
+    quiltValid[0] = quiltValid[1] = false;
+    interlacedValid = false;
+    drawBatchesValid = false;
 }
 
 
 
 
 //Intializes the quilts for standard rendering and our adapted algorithm
-void Lightfield::setupQuilts() {
-    //New quilt resulting from our algorithm
-    Framebuffer newquilt = Framebuffer("newquilt", newquiltwidth, newquiltheight);
-    newquilt->attach_depthbuffer(Texture2D("newquilt_depth", newquiltwidth, newquiltheight, GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_FLOAT));
-    newquilt->attach_colorbuffer(Texture2D("newquilt_col", newquiltwidth, newquiltheight, GL_RGBA32F, GL_RGBA, GL_FLOAT));
-    newquilt->check();
+//Only the quilt of the given algorithm is allocated, the other one on first use
+void Lightfield::setupQuilts(bool ourAlgorithm) {
+    //Dimensions or format may have changed
+    releaseQuilt(true);
+    releaseQuilt(false);
+    getQuilt(ourAlgorithm);
+}
+
+
+
+//Returns the quilt of the given algorithm (new quilt for our algorithm, original quilt otherwise) and allocates it if needed
+Framebuffer Lightfield::getQuilt(bool ourAlgorithm) {
+    Framebuffer& quilt = quilts[ourAlgorithm];
+    if (quilt) return quilt;
 
-    //Original quilt
-    Framebuffer oldquilt = Framebuffer("oldquilt", oldquiltwidth, oldquiltheight);
-    oldquilt->attach_depthbuffer(Texture2D("oldquilt_depth", oldquiltwidth, oldquiltheight, GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_FLOAT));
-    oldquilt->attach_colorbuffer(Texture2D("oldquilt_col", oldquiltwidth, oldquiltheight, GL_RGBA32F, GL_RGBA, GL_FLOAT));
-    oldquilt->check();
+    //Both quilts render with the same depth buffer, only the area of the bound quilt is used
+    if (!quiltDepth)
+        quiltDepth = Texture2D("quilt_depth", std::max(newquiltwidth, oldquiltwidth), std::max(newquiltheight, oldquiltheight), GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+
+    const std::string name = ourAlgorithm ? "newquilt" : "oldquilt";
+    const glm::ivec2 size = getQuiltDimensions(ourAlgorithm);
+    const GLenum type = quiltFormat == GL_RGBA8 ? GL_UNSIGNED_BYTE : quiltFormat == GL_RGB10_A2 ? GL_UNSIGNED_INT_2_10_10_10_REV : quiltFormat == GL_RGBA16F ? GL_HALF_FLOAT : GL_FLOAT;
+    quilt = Framebuffer(name, size.x, size.y);
+    quilt->attach_depthbuffer(quiltDepth);
+    quilt->attach_colorbuffer(Texture2D(name + "_col", size.x, size.y, quiltFormat, GL_RGBA, type));
+    quilt->check();
+    quiltValid[ourAlgorithm] = false;
+    return quilt;
+}
+
+
+
+//Frees the quilt of the given algorithm, the shared depth buffer is freed with the last quilt
+void Lightfield::releaseQuilt(bool ourAlgorithm) {
+    const std::string name = ourAlgorithm ? "newquilt" : "oldquilt";
+    quilts[ourAlgorithm] = Framebuffer();
+    Framebuffer::erase(name);
+    Texture2D::erase(name + "_col");
+    if (!quilts[0] && !quilts[1]) {
+        quiltDepth = Texture2D();
+        Texture2D::erase("quilt_depth");
+    }
+}
+
+
+
+//Returns the video memory of all allocated quilts including the shared depth buffer in bytes
+size_t Lightfield::getQuiltMemory() const {
+    const size_t bytesPerPixel = quiltFormat == GL_RGBA32F ? 16 : quiltFormat == GL_RGBA16F ? 8 : 4;
+    size_t bytes = quiltDepth ? size_t(quiltDepth->w) * quiltDepth->h * 4 : 0;
+    for (const auto& quilt : quilts)
+        if (quilt)
+            bytes += size_t(quilt->w) * quilt->h * bytesPerPixel;
+    return bytes;
 }
 
 
 
 
 //Renders the scene #number_of_views times to the quilt using view dependent view and projection matrices
+//Skipped if the quilt already holds the current scene (see skipUnchangedFrames)
 void Lightfield::viewRendering(bool ourAlgorithm) {
+    TraceScope trace("view rendering");
+    Framebuffer quilt = getQuilt(ourAlgorithm);
+    const bool cameraMoved = updateFrusta(ourAlgorithm);
+    const bool sceneChanged = updateSceneState(ourAlgorithm);
+    if (skipUnchangedFrames && quiltValid[ourAlgorithm] && !cameraMoved && !sceneChanged && quiltSynthesisStride[ourAlgorithm] == synthesisStride
+        && quiltTextureUploads[ourAlgorithm] == TextureLoader::uploads())
+        return;
+    quiltValid[ourAlgorithm] = true;
+    quiltSynthesisStride[ourAlgorithm] = synthesisStride;
+    quiltTextureUploads[ourAlgorithm] = TextureLoader::uploads();
+    interlacedValid = false;
+    if (sceneChanged) drawBatchesValid = false;
+    if (frustumCulling)
+        cullDrawelements(ourAlgorithm, sceneChanged);
+
     //save the viewports for the total quilts
     GLint viewportO[4] = { 0,0, oldquiltwidth, oldquiltheight };
     GLint viewportN[4] = { 0,0, newquiltwidth, newquiltheight };
@@ -221,7 +508,7 @@ void Lightfield::viewRendering(bool ourAlgorithm) {
     if (ourAlgorithm) {
         glGetIntegerv(GL_VIEWPORT, viewportN);
         //render all drawelements into the new quilt
-        Framebuffer::find("newquilt")->bind();
+        quilt->bind();
         //get quilt view dimensions
         qs_viewWidth = int(round(float(newquiltwidth) / columns));
         qs_viewHeight = int(round(float(newquiltheight) /rows));
@@ -229,61 +516,500 @@ void Lightfield::viewRendering(bool ourAlgorithm) {
     else {
         glGetIntegerv(GL_VIEWPORT, viewportO);
         //render all drawelements into the original quilt
-        Framebuffer::find("oldquilt")->bind();
+        quilt->bind();
         //get quilt view dimensions
         qs_viewWidth = int(round(float(oldquiltwidth) / columns));
-        qs_viewHeight = int(round(float(oldquiltwidth) / rows));
+        qs_viewHeight = int(round(float(oldquiltheight) / rows));
     }   
 
-    //render all views and copy each view to the quilt
+    //render all views at once, each instance selects its quilt tile in the vertex shader
+    if (singlePassRendering && number_of_views <= maxSinglePassViews) {
+        viewRenderingSinglePass(ourAlgorithm, qs_viewWidth, qs_viewHeight);
+        if (synthesisStride > 1) synthesizeViews(ourAlgorithm, qs_viewWidth, qs_viewHeight);
+        quilt->unbind();
+        return;
+    }
+
+    //upload the matrices of all views at once, a view is selected by binding its range of the block
+    const Frusta& lightfieldMatrices = frusta[ourAlgorithm];
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const size_t viewStride = (sizeof(ViewMatrices) + alignment - 1) / alignment * alignment;
+    viewMatricesData.resize(viewStride * number_of_views);
     for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
-        //get the x and y origin for this view
+        const ViewMatrices matrices = { lightfieldMatrices.view[viewIndex], lightfieldMatrices.proj[viewIndex] };
+        std::memcpy(viewMatricesData.data() + viewStride * viewIndex, &matrices, sizeof(ViewMatrices));
+    }
+    const size_t offset = uploadFrameBlock(viewMatricesUBO, viewMatricesUploadFrame, "lightfield_view_matrices", viewMatricesData.data(), viewMatricesData.size());
+
+    //clear all views at once, the scissor covers the whole quilt
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+
+    if (!drawBatchesValid || drawBatchesEnabled != geometryBatching)
+        buildDrawBatches();
+    const std::vector<Drawelement>& drawelements = Drawelement::all();
+
+    //bind each batch once and submit the draws of all its drawelements visible in a view at once
+    viewDraws.resize(number_of_views);
+    for (size_t batchIndex = 0; batchIndex < drawBatches.size(); batchIndex++) {
+        const DrawBatch& batch = drawBatches[batchIndex];
+        TraceScope traceBatch("batch", int(batchIndex));
+        for (auto& draws : viewDraws)
+            draws.clear();
+        for (const ArenaDraw& draw : batch.draws) {
+            if (!frustumCulling) {
+                for (auto& draws : viewDraws)
+                    draws.push_back(draw);
+                continue;
+            }
+            for (const uint32_t viewIndex : drawelementViews[draw.draw])
+                viewDraws[viewIndex].push_back(draw);
+        }
+        batch.shader->bind();
+        if (batch.material) batch.material->bind(batch.shader);
+        arena->bind(batch.shader);
+        const bool viewBlock = batch.shader->find_uniform_block("ViewMatrices");
+        if (viewBlock)
+            batch.shader->uniform("ViewMatrices", viewMatricesUBO, 1, offset, sizeof(ViewMatrices));
+        for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
+            if (viewDraws[viewIndex].empty() || !isRenderedView(viewIndex)) continue;
+            TraceScope traceView("view", viewIndex);
+            int x = (viewIndex % int(columns)) * (qs_viewWidth);
+            int y = int(float(viewIndex) / columns) * (qs_viewHeight);
+            glViewport(x, y, qs_viewWidth, qs_viewHeight);
+            glScissor(x, y, qs_viewWidth, qs_viewHeight);
+            if (viewBlock)
+                viewMatricesUBO->bind_range(1, offset + viewStride * viewIndex, sizeof(ViewMatrices));
+            else {
+                batch.shader->uniform("view", lightfieldMatrices.view[viewIndex]);
+                batch.shader->uniform("proj", lightfieldMatrices.proj[viewIndex]);
+            }
+            arena->draw(viewDraws[viewIndex]);
+        }
+        arena->unbind();
+        if (batch.material) batch.material->unbind();
+        batch.shader->unbind();
+    }
+
+    //bind shader, material and mesh of each remaining drawelement once and draw it into every view it is visible in
+    for (const uint32_t drawelementIndex : unbatchedDrawelements) {
+        const Drawelement& drawelement = drawelements[drawelementIndex];
+        const std::vector<uint32_t>* views = frustumCulling ? &drawelementViews[drawelementIndex] : nullptr;
+        TraceScope traceDrawelement("drawelement", int(drawelementIndex));
+        const int viewCount = views ? int(views->size()) : number_of_views;
+        if (viewCount == 0) continue;
+        drawelement->bind();
+        //shaders without the ViewMatrices block get the matrices as plain uniforms
+        const bool viewBlock = drawelement->shader->find_uniform_block("ViewMatrices");
+        if (viewBlock)
+            drawelement->shader->uniform("ViewMatrices", viewMatricesUBO, 1, offset, sizeof(ViewMatrices));
+        for (int i = 0; i < viewCount; i++) {
+            const int viewIndex = views ? int((*views)[i]) : i;
+            if (!isRenderedView(viewIndex)) continue;
+            TraceScope traceView("view", viewIndex);
+            //get the x and y origin for this view
+            int x = (viewIndex % int(columns)) * (qs_viewWidth);
+            int y = int(float(viewIndex) / columns) * (qs_viewHeight);
+
+            //set the viewport to the view to control the projection extent and the scissor to keep the view in its tile
+            glViewport(x, y, qs_viewWidth, qs_viewHeight);
+            glScissor(x, y, qs_viewWidth, qs_viewHeight);
+
+            if (viewBlock)
+                viewMatricesUBO->bind_range(1, offset + viewStride * viewIndex, sizeof(ViewMatrices));
+            else {
+                drawelement->shader->uniform("view", lightfieldMatrices.view[viewIndex]);
+                drawelement->shader->uniform("proj", lightfieldMatrices.proj[viewIndex]);
+            }
+            drawelement->draw();
+        }
+        drawelement->unbind();
+    }
+
+    //reset viewport and scissor
+    const GLint* viewport = ourAlgorithm ? viewportN : viewportO;
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDisable(GL_SCISSOR_TEST);
+    glScissor(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (synthesisStride > 1) synthesizeViews(ourAlgorithm, qs_viewWidth, qs_viewHeight);
+    quilt->unbind();
+}
+
+
+
+
+
+//Renders all views into the bound quilt with a single instanced draw call per drawelement
+//Drawelements are drawn with the "<shader name>_multiview" variant of their shader (see draw_multiview.vs)
+void Lightfield::viewRenderingSinglePass(bool ourAlgorithm, int qs_viewWidth, int qs_viewHeight) {
+    const glm::ivec2 quilt = getQuiltDimensions(ourAlgorithm);
+    const Frusta& lightfieldMatrices = frusta[ourAlgorithm];
+
+    //collect the view-projection matrix and the clip space transform into the quilt tile of every rendered view
+    int instances = 0;
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
+        if (!isRenderedView(viewIndex)) continue;
         int x = (viewIndex % int(columns)) * (qs_viewWidth);
         int y = int(float(viewIndex) / columns) * (qs_viewHeight);
+        views.view_proj[instances] = lightfieldMatrices.proj[viewIndex] * lightfieldMatrices.view[viewIndex];
+        views.tile[instances] = glm::vec4(float(qs_viewWidth) / quilt.x, float(qs_viewHeight) / quilt.y,
+            float(qs_viewWidth + 2 * x) / quilt.x - 1.0f, float(qs_viewHeight + 2 * y) / quilt.y - 1.0f);
+        instances++;
+    }
 
-        //set the viewport to the view to control the projection extent
-        glViewport(x, y, qs_viewWidth, qs_viewHeight);
+    const size_t offset = uploadFrameBlock(viewsUBO, viewsUploadFrame, "lightfield_views", &views, sizeof(LightfieldViews));
+
+    //the viewport covers the whole quilt, so a single clear suffices
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int i = 0; i < 4; i++) glEnable(GL_CLIP_DISTANCE0 + i);
+
+    const std::vector<Drawelement>& drawelements = Drawelement::all();
+    multiviewShaders.resize(drawelements.size());
+    for (size_t drawelementIndex = 0; drawelementIndex < drawelements.size(); drawelementIndex++) {
+        const Drawelement& drawelement = drawelements[drawelementIndex];
+        //instances cover all views, so only drawelements outside of every view are skipped
+        if (frustumCulling && drawelementViews[drawelementIndex].empty()) continue;
+        //the variant is looked up by name only the first time and after it was erased or replaced
+        Shader& shader = multiviewShaders[drawelementIndex];
+        if (!Shader::get(shader.id)) {
+            const std::string variant = drawelement->shader->name + "_multiview";
+            if (!Shader::valid(variant))
+                throw std::runtime_error("ERROR: Single-pass rendering requires shader: " + variant);
+            shader = Shader::find(variant);
+        }
+        shader->bind();
+        shader->uniform("LightfieldViews", viewsUBO, 0, offset, sizeof(LightfieldViews));
+        shader->uniform("model", drawelement->model);
+        drawelement->mesh->bind(shader);
+        drawelement->mesh->draw_instanced(instances);
+        drawelement->mesh->unbind();
+        shader->unbind();
+    }
 
-        //set the scissor to the view to restrict calls like glClear from making modifications
-        glEnable(GL_SCISSOR_TEST);
+    for (int i = 0; i < 4; i++) glDisable(GL_CLIP_DISTANCE0 + i);
+}
+
+
+
+
+
+
+
+//Whether the view is rasterized or synthesized from its neighbours (see synthesisStride)
+bool Lightfield::isRenderedView(int viewIndex) const {
+    return synthesisStride <= 1 || viewIndex % synthesisStride == 0 || viewIndex == number_of_views - 1;
+}
+
+
+
+//Fills the views skipped by the rendering with the rendered views to their left and right, warped by their depth
+//Both neighbours are drawn as a grid of cells into the tile of the synthesized view, the depth test keeps the nearest surface.
+//Cells spanning a depth discontinuity are pushed behind all other surfaces, so they only fill the disoccluded areas.
+void Lightfield::synthesizeViews(bool ourAlgorithm, int qs_viewWidth, int qs_viewHeight) {
+    TraceScope trace("view synthesis");
+    static Shader view_synthesis_shader = Shader("view_synthesis_shader", "viewSynthesis.vs", "viewSynthesis.fs");
+    static GLuint gridVAO = 0;
+    if (!gridVAO) glGenVertexArrays(1, &gridVAO);
+    const int gridStep = 2;
+
+    //copy the rendered views with their depth, since the quilt cannot be sampled while it is rendered to
+    Framebuffer quilt = getQuilt(ourAlgorithm);
+    if (!synthesisSource || synthesisSource->w != quilt->w || synthesisSource->h != quilt->h || synthesisSource->color_textures[0]->internal_format != quiltFormat) {
+        const GLenum type = quiltFormat == GL_RGBA8 ? GL_UNSIGNED_BYTE : quiltFormat == GL_RGB10_A2 ? GL_UNSIGNED_INT_2_10_10_10_REV : quiltFormat == GL_RGBA16F ? GL_HALF_FLOAT : GL_FLOAT;
+        synthesisSource = Framebuffer("synthesis_source", quilt->w, quilt->h);
+        synthesisSource->attach_depthbuffer(Texture2D("synthesis_source_depth", quilt->w, quilt->h, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT));
+        synthesisSource->attach_colorbuffer(Texture2D("synthesis_source_col", quilt->w, quilt->h, quiltFormat, GL_RGBA, type));
+        synthesisSource->check();
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, quilt->id);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, synthesisSource->id);
+    glBlitFramebuffer(0, 0, quilt->w, quilt->h, 0, 0, quilt->w, quilt->h, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, quilt->id);
+
+    const Frusta& lightfieldMatrices = frusta[ourAlgorithm];
+    const glm::ivec2 cells = (glm::ivec2(qs_viewWidth, qs_viewHeight) - 1 + gridStep - 1) / gridStep;
+    view_synthesis_shader->bind();
+    view_synthesis_shader->uniform("source_color", synthesisSource->color_textures[0], 0);
+    view_synthesis_shader->uniform("source_depth", synthesisSource->depth_texture, 1);
+    view_synthesis_shader->uniform("tile_size", glm::ivec2(qs_viewWidth, qs_viewHeight));
+    view_synthesis_shader->uniform("grid_step", gridStep);
+    view_synthesis_shader->uniform("cells_x", cells.x);
+    view_synthesis_shader->uniform("stretch_threshold", synthesisDepthThreshold);
+    glBindVertexArray(gridVAO);
+    //warped cells flip their winding where the surface folds over, the depth test decides instead
+    const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_SCISSOR_TEST);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
+        if (isRenderedView(viewIndex)) continue;
+        int x = (viewIndex % int(columns)) * (qs_viewWidth);
+        int y = int(float(viewIndex) / columns) * (qs_viewHeight);
+        glViewport(x, y, qs_viewWidth, qs_viewHeight);
         glScissor(x, y, qs_viewWidth, qs_viewHeight);
+        const glm::mat4 viewProj = lightfieldMatrices.proj[viewIndex] * lightfieldMatrices.view[viewIndex];
+
+        //the closest rendered views on both sides
+        const int left = viewIndex / synthesisStride * synthesisStride;
+        const int right = std::min(left + synthesisStride, number_of_views - 1);
+        for (const int source : { left, right }) {
+            const glm::ivec2 origin = glm::ivec2((source % int(columns)) * qs_viewWidth, int(float(source) / columns) * qs_viewHeight);
+            const glm::mat4 sourceViewProj = lightfieldMatrices.proj[source] * lightfieldMatrices.view[source];
+            view_synthesis_shader->uniform("source_origin", origin);
+            view_synthesis_shader->uniform("reprojection", viewProj * glm::inverse(sourceViewProj));
+            view_synthesis_shader->uniform("source_inv_proj", glm::inverse(lightfieldMatrices.proj[source]));
+            glDrawArrays(GL_TRIANGLES, 0, cells.x * cells.y * 6);
+        }
+    }
 
-        //get different view and projection matrices for every view index
-        std::vector<glm::mat4> lightfieldMatrices = generateFrustaMatrices(Camera::find("std")->view, viewIndex, ourAlgorithm);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDisable(GL_SCISSOR_TEST);
+    glScissor(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (cullFace) glEnable(GL_CULL_FACE);
+    glBindVertexArray(0);
+    view_synthesis_shader->unbind();
+}
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        //render the teapot using the aquired matrices
-        for (const auto& [key, drawelement] : Drawelement::map) {
-            drawelement->bind();
-            drawelement->shader->uniform("view", lightfieldMatrices.at(0));
-            drawelement->shader->uniform("proj", lightfieldMatrices.at(1));
-            drawelement->draw();
-            drawelement->unbind();
+
+//Renders the quilt once with all views and once with the current synthesisStride and compares the synthesized views
+//Meant for choosing the stride per scene, the GPU is synchronized by the read back
+Lightfield::SynthesisQuality Lightfield::measureSynthesisQuality(bool ourAlgorithm) {
+    SynthesisQuality quality;
+    if (synthesisStride <= 1) return quality;
+    const Texture2D quilt = getQuilt(ourAlgorithm)->color_textures[0];
+    std::vector<uint8_t> reference(size_t(quilt->w) * quilt->h * 4), synthesized(reference.size());
+    const auto renderQuilt = [&](std::vector<uint8_t>& pixels) {
+        quiltValid[ourAlgorithm] = false;
+        viewRendering(ourAlgorithm);
+        glBindTexture(GL_TEXTURE_2D, quilt->id);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    };
+    const int stride = synthesisStride;
+    synthesisStride = 1;
+    renderQuilt(reference);
+    synthesisStride = stride;
+    renderQuilt(synthesized);
+
+    const glm::ivec2 size = getQuiltDimensions(ourAlgorithm);
+    const int viewWidth = int(round(float(size.x) / columns));
+    const int viewHeight = int(round(float(size.y) / rows));
+    quality.psnrMin = 1e10;
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
+        if (isRenderedView(viewIndex)) continue;
+        const int x0 = (viewIndex % int(columns)) * viewWidth;
+        const int y0 = int(float(viewIndex) / columns) * viewHeight;
+        double squaredError = 0.0;
+        for (int y = y0; y < std::min(y0 + viewHeight, int(quilt->h)); y++) {
+            for (int x = x0; x < std::min(x0 + viewWidth, int(quilt->w)); x++) {
+                const size_t i = (size_t(y) * quilt->w + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    const double error = double(reference[i + c]) - double(synthesized[i + c]);
+                    squaredError += error * error;
+                }
+            }
         }
-        //reset viewport
-        if (ourAlgorithm) {
-            glViewport(viewportN[0], viewportN[1], viewportN[2], viewportN[3]);
-            //restore scissor
-            glDisable(GL_SCISSOR_TEST);
-            glScissor(viewportN[0], viewportN[1], viewportN[2], viewportN[3]);
+        const double mse = squaredError / (double(viewWidth) * viewHeight * 3);
+        //identical views are reported with the PSNR of an error of a single step in one channel
+        const double psnr = 10.0 * log10(255.0 * 255.0 / std::max(mse, 1.0 / (double(viewWidth) * viewHeight * 3)));
+        quality.psnrMean += psnr;
+        quality.psnrMin = std::min(quality.psnrMin, psnr);
+        quality.synthesizedViews++;
+    }
+    if (quality.synthesizedViews > 0) quality.psnrMean /= quality.synthesizedViews;
+    else quality.psnrMin = 0.0;
+    return quality;
+}
+
+
+
+//Writes data into the ring slot of the current frame of a buffer holding one block per frame in flight and returns the offset of the slot
+//The frame pacer guarantees that the GPU is done with the slot, so the upload never waits
+size_t Lightfield::uploadFrameBlock(UBO& ubo, uint64_t& uploadFrame, const std::string& name, const void* data, size_t size) {
+    const FramePacer& pacer = Context::instance().frame_pacer;
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const size_t stride = (size + alignment - 1) / alignment * alignment;
+    if (!ubo) ubo = UBO(name, stride * pacer.frames_in_flight());
+    else if (ubo->size_bytes != stride * pacer.frames_in_flight()) ubo->resize(stride * pacer.frames_in_flight());
+    const size_t offset = stride * pacer.slot();
+    void* mapped = nullptr;
+    if (uploadFrame != pacer.frame())
+        mapped = ubo->map_range(offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped) {
+        std::memcpy(mapped, data, size);
+        ubo->unmap();
+    }
+    //the slot may still be in use by an earlier draw of this frame (or of every frame without swap_buffers, e.g. in lfd_bench)
+    else ubo->upload_subdata(data, offset, size);
+    uploadFrame = pacer.frame();
+    return offset;
+}
+
+
+
+//Tests the bounding boxes of all drawelements against the frusta of all views and fills the visible views of each drawelement
+//The boxes are only transformed and sorted again if the scene changed
+void Lightfield::cullDrawelements(bool ourAlgorithm, bool sceneChanged) {
+    if (sceneChanged || culler.size() + unboundedDrawelements.size() != Drawelement::all().size()) {
+        culler.clear();
+        culledDrawelements.clear();
+        unboundedDrawelements.clear();
+        uint32_t drawelementIndex = 0;
+        for (const Drawelement& drawelement : Drawelement::all()) {
+            if (drawelement->mesh && drawelement->mesh->geometry) {
+                const Geometry& geometry = drawelement->mesh->geometry;
+                culler.add(geometry->bb_min, geometry->bb_max, drawelement->model);
+                culledDrawelements.push_back(drawelementIndex);
+            }
+            else unboundedDrawelements.push_back(drawelementIndex);
+            drawelementIndex++;
         }
-        else {
-            glViewport(viewportO[0], viewportO[1], viewportO[2], viewportO[3]);
-            //restore scissor
-            glDisable(GL_SCISSOR_TEST);
-            glScissor(viewportO[0], viewportO[1], viewportO[2], viewportO[3]);
-        }      
     }
-    ourAlgorithm? Framebuffer::find("newquilt")->unbind() : Framebuffer::find("oldquilt")->unbind();
+
+    //the view-projection matrices of both mappings span exactly the rendered part of each view
+    const Frusta& lightfieldMatrices = frusta[ourAlgorithm];
+    std::vector<glm::mat4> viewProj(number_of_views);
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++)
+        viewProj[viewIndex] = lightfieldMatrices.proj[viewIndex] * lightfieldMatrices.view[viewIndex];
+    culler.cull(viewProj, visibleDrawelements);
+
+    drawelementViews.resize(Drawelement::all().size());
+    for (auto& views : drawelementViews)
+        views.clear();
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++) {
+        for (const uint32_t box : visibleDrawelements[viewIndex])
+            drawelementViews[culledDrawelements[box]].push_back(viewIndex);
+        for (const uint32_t drawelementIndex : unboundedDrawelements)
+            drawelementViews[drawelementIndex].push_back(viewIndex);
+    }
+}
+
+
+
+const CullingStats& Lightfield::getCullingStats() const {
+    return culler.stats;
+}
+
+
+
+//Packs the meshes of all drawelements into the geometry arena and groups the drawelements by shader and material
+//Drawelements whose mesh is not packable or whose shader does not support the arena are drawn one by one
+void Lightfield::buildDrawBatches() {
+    const std::vector<Drawelement>& drawelements = Drawelement::all();
+    drawBatches.clear();
+    unbatchedDrawelements.clear();
+    drawBatchesValid = true;
+    drawBatchesEnabled = geometryBatching;
+    if (!geometryBatching) {
+        for (uint32_t drawelementIndex = 0; drawelementIndex < drawelements.size(); drawelementIndex++)
+            unbatchedDrawelements.push_back(drawelementIndex);
+        return;
+    }
+
+    //pack the meshes again only if one of them is new or changed since
+    if (!arena) arena = std::make_unique<GeometryArena>("lightfield_arena");
+    std::vector<const MeshImpl*> meshes;
+    for (const Drawelement& drawelement : drawelements)
+        if (drawelement->mesh) meshes.push_back(drawelement->mesh.ptr.get());
+    if (arena->outdated(meshes)) arena->build(meshes);
+
+    std::vector<glm::mat4> models(drawelements.size());
+    std::map<std::pair<const ShaderImpl*, const MaterialImpl*>, size_t> batchIndices;
+    for (uint32_t drawelementIndex = 0; drawelementIndex < drawelements.size(); drawelementIndex++) {
+        const Drawelement& drawelement = drawelements[drawelementIndex];
+        models[drawelementIndex] = drawelement->model;
+        const ArenaRange* range = drawelement->mesh ? arena->find(drawelement->mesh.ptr.get()) : nullptr;
+        const Shader shader = range && drawelement->shader ? arenaShader(drawelement->shader) : Shader();
+        if (!shader) {
+            unbatchedDrawelements.push_back(drawelementIndex);
+            continue;
+        }
+        const Material& material = drawelement->mesh->material;
+        const auto [batch, inserted] = batchIndices.emplace(std::make_pair(shader.ptr.get(), material.ptr.get()), drawBatches.size());
+        if (inserted) drawBatches.push_back({ shader, material, {} });
+        drawBatches[batch->second].draws.push_back({ range, drawelementIndex });
+    }
+    arena->set_transforms(models);
 }
 
 
 
+//Returns the "_arena" variant of the shader (its sources compiled with ARENA defined), compiled on first use
+//Returns an empty handle if the variant does not read its model matrices from the arena (see draw.vs)
+Shader Lightfield::arenaShader(const Shader& shader) {
+    const std::string name = shader->name + "_arena";
+    Shader variant;
+    if (Shader::valid(name))
+        variant = Shader::find(name);
+    else {
+        variant = Shader(name);
+        for (const auto& [type, path] : shader->source_files)
+            variant->set_source(type, path);
+        for (const auto& [define, value] : shader->defines)
+            variant->set_define(define, value);
+        variant->set_define("ARENA");
+        //a failed compilation is reported on std::cerr and leaves the variant unlinked, its drawelements are drawn one by one
+        try { variant->compile(); } catch (const std::runtime_error&) {}
+    }
+    return variant && *variant && variant->find_uniform("arena_models") ? variant : Shader();
+}
+
+
+
+//Recomputes the view and projection matrices of all views if the camera moved or the parameters changed
+//Returns whether the matrices changed
+bool Lightfield::updateFrusta(bool ourAlgorithm) {
+    Frusta& table = frusta[ourAlgorithm];
+    const CameraImpl* camera = Camera::get(cameraId);
+    if (!camera) {
+        const Camera named = Camera::find("std");
+        cameraId = named.id;
+        camera = named.ptr.get();
+    }
+    const glm::mat4& currentViewMatrix = camera->view;
+    if (table.valid && table.cameraView == currentViewMatrix)
+        return false;
+
+    table.view.resize(number_of_views);
+    table.proj.resize(number_of_views);
+    for (int viewIndex = 0; viewIndex < number_of_views; viewIndex++)
+        generateFrustaMatrices(currentViewMatrix, viewIndex, ourAlgorithm, table.view[viewIndex], table.proj[viewIndex]);
+    table.cameraView = currentViewMatrix;
+    table.valid = true;
+    return true;
+}
+
+
+
+//Compares the drawelements (model matrix, mesh data and shader) with the state the quilt was last rendered with and records the current state
+//Returns whether the scene changed
+bool Lightfield::updateSceneState(bool ourAlgorithm) {
+    std::vector<DrawelementState>& scene = quiltScene[ourAlgorithm];
+    bool changed = scene.size() != Drawelement::all().size();
+    scene.resize(Drawelement::all().size());
+    size_t i = 0;
+    for (const Drawelement& drawelement : Drawelement::all()) {
+        const DrawelementState state = { drawelement.ptr.get(), drawelement->mesh.ptr.get(), drawelement->mesh ? drawelement->mesh->revision : 0,
+                                         drawelement->shader ? drawelement->shader->id : 0, drawelement->model };
+        DrawelementState& recorded = scene[i++];
+        changed = changed || recorded.drawelement != state.drawelement || recorded.mesh != state.mesh || recorded.meshRevision != state.meshRevision
+            || recorded.shader != state.shader || recorded.model != state.model;
+        recorded = state;
+    }
+    if (changed) multiviewShaders.clear();
+    return changed;
+}
+
+
 
 
 //Calculates the view dependant view and projection matrices
-std::vector<glm::mat4> Lightfield::generateFrustaMatrices(glm::mat4 currentViewMatrix, int viewIndex, bool ourAlgorithm) {
+void Lightfield::generateFrustaMatrices(const glm::mat4& currentViewMatrix, int viewIndex, bool ourAlgorithm, glm::mat4& viewMatrix, glm::mat4& projectionMatrix) const {
 
     //Adapted Projective Mapping
     if (ourAlgorithm) {
@@ -292,12 +1018,12 @@ std::vector<glm::mat4> Lightfield::generateFrustaMatrices(glm::mat4 currentViewM
         float offsetAngle = (float(viewIndex) / (float(number_of_views) - 1.0f) - 0.5f) * glm::radians(viewCone);
         float offset = cameraDistance * tan(offsetAngle); // calculate the offset that the camera should move
         glm::vec3 offsetLocal = glm::vec3(currentViewMatrix * glm::vec4(offset, 0.0f, cameraDistance, 1.0f));
-        glm::mat4 viewMatrix = glm::translate(currentViewMatrix, offsetLocal);
+        viewMatrix = glm::translate(currentViewMatrix, offsetLocal);
 
 
         //Calculate the new adapted projection matrix
         //init P with an aspect ratio of 1 and the user defined field of view
-        glm::mat4 projectionMatrix = glm::perspective(double(fov), 1.0, 0.1, 100.0);
+        projectionMatrix = glm::perspective(double(fov), 1.0, 0.1, 100.0);
 
         //modify the projection matrix, relative to the camera size and aspect ratio (=1) like before
         projectionMatrix[2][0] += offset / 1.0f;
@@ -323,13 +1049,6 @@ std::vector<glm::mat4> Lightfield::generateFrustaMatrices(glm::mat4 currentViewM
         float s = (round((partial_repeats_outside / 2) * number_of_views) - partial_repeat_tl) * width;
         //apply new offset si'
         projectionMatrix[2][0] += si + s;
-
-
-        //Return view and projection matrix
-        std::vector<glm::mat4> result;
-        result.push_back(viewMatrix);
-        result.push_back(projectionMatrix);
-        return result;
     }
 
     //Standard Projective Mapping
@@ -339,17 +1058,11 @@ std::vector<glm::mat4> Lightfield::generateFrustaMatrices(glm::mat4 currentViewM
         float offsetAngle = (float(viewIndex) / (float(number_of_views) - 1.0f) - 0.5f) * glm::radians(viewCone);
         float offset = cameraDistance * tan(offsetAngle);
         glm::vec3 offsetLocal = glm::vec3(currentViewMatrix * glm::vec4(offset, 0.0f, cameraDistance, 1.0f));
-        glm::mat4 viewMatrix = glm::translate(currentViewMatrix, offsetLocal);
+        viewMatrix = glm::translate(currentViewMatrix, offsetLocal);
 
         //Calculate the lightfield projection matrix
-        glm::mat4 projectionMatrix = glm::perspective(double(fov), double(aspectRatio), 0.1, 100.0);
+        projectionMatrix = glm::perspective(double(fov), double(aspectRatio), 0.1, 100.0);
         projectionMatrix[2][0] += offset / aspectRatio;
-
-        //Return view and projection matrix
-        std::vector<glm::mat4> result;
-        result.push_back(viewMatrix);
-        result.push_back(projectionMatrix);
-        return result;
     }
 
 }
@@ -359,13 +1072,45 @@ std::vector<glm::mat4> Lightfield::generateFrustaMatrices(glm::mat4 currentViewM
 
 
 //Passes the necessary parameters to the interlacing shader and constructs the interlaced image
+//The interlaced image is written to the currently bound framebuffer (the default framebuffer after viewRendering)
 void Lightfield::interlacing(bool ourAlgorithm) {    
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        TraceScope trace("interlacing");
         static Shader our_efficient_interlacing_shader = Shader("our_efficient_interlacing_shader", "interlacingShader.vs", "interlacingShaderEfficient.fs");
         static Shader standard_interlacing_shader = Shader("standard_interlacing_shader", "interlacingShader.vs", "interlacingShaderStandard.fs");
 
+        //Present the copy of the previous interlaced image if neither the quilt nor the output changed
+        GLint viewport[4], target;
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+        if (skipUnchangedFrames && interlacedValid && interlacedAlgorithm == ourAlgorithm && interlacedVariant == interlacingVariant && interlacedTarget == target
+                && interlacedImage->w == uint32_t(viewport[2]) && interlacedImage->h == uint32_t(viewport[3])) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, interlacedImage->id);
+            glBlitFramebuffer(0, 0, viewport[2], viewport[3], viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, target);
+            return;
+        }
+
+        //Use the interlacing shader of the selected algorithm with the calibration baked in
+        if (interlacingVariant != InterlacingVariant::Uniforms) {
+            const bool lookup = interlacingVariant == InterlacingVariant::Lookup;
+            Shader& specialized_interlacing_shader = specializedInterlacingShaders[ourAlgorithm][lookup];
+            if (!specialized_interlacing_shader)
+                specialized_interlacing_shader = specializeInterlacingShader(ourAlgorithm, lookup);
+            if (lookup)
+                updateViewLookup();
+
+            specialized_interlacing_shader->bind();
+            specialized_interlacing_shader->uniform("quilt", getQuilt(ourAlgorithm)->color_textures[0], 0);
+            if (lookup)
+                specialized_interlacing_shader->uniform("view_lookup", viewLookup->color_textures[0], 1);
+
+            Quad::draw();
+
+            specialized_interlacing_shader->unbind();
+        }
+
         //Use the adapted efficient interlacing shader for our algorithm
-        if (ourAlgorithm) {
+        else if (ourAlgorithm) {
             our_efficient_interlacing_shader->bind();
             our_efficient_interlacing_shader->uniform("pitch", pitch);
             our_efficient_interlacing_shader->uniform("tilt", tilt);        
@@ -373,7 +1118,7 @@ void Lightfield::interlacing(bool ourAlgorithm) {
             our_efficient_interlacing_shader->uniform("invView", invert);
             our_efficient_interlacing_shader->uniform("subp", subp);
             our_efficient_interlacing_shader->uniform("tile", glm::vec3(columns, rows, number_of_views));
-            our_efficient_interlacing_shader->uniform("quilt", Framebuffer::find("newquilt")->color_textures[0], 0);
+            our_efficient_interlacing_shader->uniform("quilt", getQuilt(true)->color_textures[0], 0);
 
             our_efficient_interlacing_shader->uniform("tilt_angle", tiltAngle);
             our_efficient_interlacing_shader->uniform("pitch_d", float(diagonal_pitch));
@@ -397,13 +1142,158 @@ void Lightfield::interlacing(bool ourAlgorithm) {
             standard_interlacing_shader->uniform("invView", invert);
             standard_interlacing_shader->uniform("subp", subp);
             standard_interlacing_shader->uniform("tile", glm::vec3(columns, rows, number_of_views));
-            standard_interlacing_shader->uniform("quilt", Framebuffer::find("oldquilt")->color_textures[0], 0);
+            standard_interlacing_shader->uniform("quilt", getQuilt(false)->color_textures[0], 0);
 
             Quad::draw();
 
             standard_interlacing_shader->unbind();
         }
-        glFinish();
+
+        //Keep a copy of the interlaced image for the following frames
+        if (skipUnchangedFrames) {
+            if (!interlacedImage || interlacedImage->w != uint32_t(viewport[2]) || interlacedImage->h != uint32_t(viewport[3])) {
+                interlacedImage = Framebuffer("interlaced_image", viewport[2], viewport[3]);
+                interlacedImage->attach_depthbuffer();
+                interlacedImage->attach_colorbuffer(Texture2D("interlaced_image_col", viewport[2], viewport[3], GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE));
+                interlacedImage->check();
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, interlacedImage->id);
+            glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3], 0, 0, viewport[2], viewport[3], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, target);
+            interlacedValid = true;
+            interlacedAlgorithm = ourAlgorithm;
+            interlacedVariant = interlacingVariant;
+            interlacedTarget = target;
+        }
+}
+
+
+
+//Compiles the interlacing shader of the given algorithm with all calibration and mapping parameters as compile time constants
+//With lookup the view indices are read from viewLookup instead of being computed per subpixel
+Shader Lightfield::specializeInterlacingShader(bool ourAlgorithm, bool lookup) {
+    Shader shader = Shader(std::string(ourAlgorithm ? "our_efficient" : "standard") + (lookup ? "_lookup" : "_specialized") + "_interlacing_shader");
+    shader->set_vertex_source("interlacingShader.vs");
+    shader->set_fragment_source(ourAlgorithm ? "interlacingShaderEfficient.fs" : "interlacingShaderStandard.fs");
+    shader->set_define("BAKED_CALIBRATION");
+    if (lookup)
+        shader->set_define("VIEW_LOOKUP");
+
+    shader->set_define("PITCH", toGLSL(pitch));
+    shader->set_define("TILT", toGLSL(tilt));
+    shader->set_define("CENTER", toGLSL(center));
+    shader->set_define("INV_VIEW", std::to_string(int(invert)));
+    shader->set_define("SUBP", toGLSL(subp));
+    shader->set_define("TILE", "vec3(" + toGLSL(float(columns)) + ", " + toGLSL(float(rows)) + ", " + toGLSL(float(number_of_views)) + ")");
+    if (ourAlgorithm) {
+        shader->set_define("ASPECT_RATIO", toGLSL(aspectRatio));
+        shader->set_define("TILT_ANGLE", toGLSL(tiltAngle));
+        shader->set_define("PITCH_D", toGLSL(float(diagonal_pitch)));
+        shader->set_define("FOV_FACTOR", toGLSL(fovFactor));
+        shader->set_define("ASPECT_RATIO_N", toGLSL(aspectRatioNew));
+        shader->set_define("PR_TL", std::to_string(partial_repeat_tl));
+        shader->set_define("PR_TOTAL", std::to_string(int(partial_repeats_outside * number_of_views)));
+    }
+    shader->compile();
+    return shader;
+}
+
+
+
+//(Re)computes the view lookup texture if the resolution of the interlaced image has changed
+//The lookup matches the interlacing pass texel by texel, so it is generated at the size of the current viewport
+//It stores the full float index, so the blend weights are the same as without lookup (16 bytes per pixel)
+void Lightfield::updateViewLookup() {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewLookup && viewLookup->w == uint32_t(viewport[2]) && viewLookup->h == uint32_t(viewport[3]))
+        return;
+    TraceScope trace("view lookup");
+
+    static Shader view_lookup_shader = Shader("view_lookup_shader", "interlacingShader.vs", "interlacingLookup.fs");
+
+    //Keep the framebuffer the interlaced image is written to
+    GLint target;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+    viewLookup = Framebuffer("view_lookup", viewport[2], viewport[3]);
+    viewLookup->attach_depthbuffer();
+    viewLookup->attach_colorbuffer(Texture2D("view_lookup_col", viewport[2], viewport[3], GL_RGBA32F, GL_RGBA, GL_FLOAT));
+    viewLookup->check();
+
+    viewLookup->bind();
+    glClear(GL_DEPTH_BUFFER_BIT);
+    view_lookup_shader->bind();
+    view_lookup_shader->uniform("pitch", pitch);
+    view_lookup_shader->uniform("tilt", tilt);
+    view_lookup_shader->uniform("center", center);
+    view_lookup_shader->uniform("invView", invert);
+    view_lookup_shader->uniform("subp", subp);
+    view_lookup_shader->uniform("tile", glm::vec3(columns, rows, number_of_views));
+
+    Quad::draw();
+
+    view_lookup_shader->unbind();
+    viewLookup->unbind();
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+
+
+//Formats a float as GLSL literal without losing precision
+std::string Lightfield::toGLSL(float value) {
+    std::ostringstream literal;
+    literal << std::scientific << std::setprecision(9) << value;
+    return literal.str();
+}
+
+
+
+//Returns the dimensions of the quilt rendered by the given algorithm in pixels
+glm::ivec2 Lightfield::getQuiltDimensions(bool ourAlgorithm) const {
+    return ourAlgorithm ? glm::ivec2(newquiltwidth, newquiltheight) : glm::ivec2(oldquiltwidth, oldquiltheight);
 }
 
 
+
+//Tiles the views into columns x rows with rows <= columns, as close to square as possible (48 -> 8x6)
+glm::ivec2 Lightfield::getTileLayout(int views) {
+    if (views <= 0)
+        throw std::runtime_error("Invalid number of views: " + std::to_string(views));
+    int rows = int(floor(sqrt(double(views))));
+    while (views % rows != 0) rows--;
+    return glm::ivec2(views / rows, rows);
+}
+
+
+
+//Returns the parameters passed to the interlacing shaders, e.g. for the CPU Interlacer
+//Call after getFrustumParameters()
+InterlacingParameters Lightfield::getInterlacingParameters() const {
+    InterlacingParameters parameters;
+    parameters.pitch = pitch;
+    parameters.tilt = tilt;
+    parameters.center = center;
+    parameters.invView = invert;
+    parameters.subp = subp;
+    parameters.aspect_ratio = aspectRatio;
+    parameters.tile = glm::vec3(columns, rows, number_of_views);
+    parameters.tilt_angle = tiltAngle;
+    parameters.pitch_d = float(diagonal_pitch);
+    parameters.fovFactor = fovFactor;
+    parameters.aspect_ratio_n = aspectRatioNew;
+    parameters.pr_tl = partial_repeat_tl;
+    parameters.pr_total = int(partial_repeats_outside * number_of_views);
+    return parameters;
+}
+
+
+
+
+//Identifies the display calibration (hash of the calibration values and the panel resolution), e.g. for frames exported
+//to other processes that need to know which display an interlaced image was rendered for
+uint64_t Lightfield::getCalibrationHash() const {
+    const float values[] = { pitch, tilt, center, subp, float(invert), float(imageWidth), float(imageHeight) };
+    return hash_bytes(values, sizeof(values));
+}
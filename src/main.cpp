@@ -18,6 +18,16 @@ void keyboard_callback(int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_ENTER && action == GLFW_PRESS)
         Context::screenshot("screenshot.png");
     if (key == GLFW_KEY_T && action == GLFW_PRESS) ourAlgorithm = !ourAlgorithm;
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) lightfield->singlePassRendering = !lightfield->singlePassRendering;
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+        lightfield->interlacingVariant = Lightfield::InterlacingVariant((int(lightfield->interlacingVariant) + 1) % 3);
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) lightfield->frustumCulling = !lightfield->frustumCulling;
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) lightfield->geometryBatching = !lightfield->geometryBatching;
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) lightfield->synthesisStride = lightfield->synthesisStride % 4 + 1;
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        FramePacer& pacer = Context::instance().frame_pacer;
+        pacer.set_mode(pacer.get_mode() == FramePacing::LOW_LATENCY ? FramePacing::MAX_THROUGHPUT : FramePacing::LOW_LATENCY);
+    }
     if (key == GLFW_KEY_M && action == GLFW_PRESS) { 
         moveToLightfieldDisplay = !moveToLightfieldDisplay;
         if (moveToLightfieldDisplay) {
@@ -42,6 +52,41 @@ void display_text() {
         else {
             ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Standard Algorithm");
         }
+        if (lightfield->singlePassRendering) {
+            ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Single-pass");
+        }
+        if (lightfield->interlacingVariant == Lightfield::InterlacingVariant::Uniforms) {
+            ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Generic interlacing");
+        }
+        else if (lightfield->interlacingVariant == Lightfield::InterlacingVariant::Lookup) {
+            ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Lookup interlacing");
+        }
+        if (lightfield->synthesisStride > 1) {
+            ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Synthesized views (k = %d)", lightfield->synthesisStride);
+        }
+        if (Context::instance().frame_pacer.get_mode() == FramePacing::LOW_LATENCY) {
+            ImGui::TextColored(ImVec4(0.0f, 0.0f, 0.0f, 1.0f), "Low latency");
+        }
+    }
+    ImGui::End();
+}
+
+
+//Culling statistics of the last rendered frame, shown with the [F1] overlay
+void display_culling_stats() {
+    if (ImGui::Begin("Frustum culling")) {
+        if (!lightfield->frustumCulling) {
+            ImGui::Text("disabled");
+        }
+        else {
+            const CullingStats& stats = lightfield->getCullingStats();
+            const uint64_t pairs = uint64_t(stats.objects) * stats.views;
+            ImGui::Text("objects: %u, views: %u", stats.objects, stats.views);
+            ImGui::Text("visible: %llu / %llu (%.1f%%)", (unsigned long long)stats.visible, (unsigned long long)pairs, pairs ? 100.0 * stats.visible / pairs : 0.0);
+            ImGui::Text("outside all views: %u", stats.culled);
+            ImGui::Text("tests: %llu clusters, %llu boxes", (unsigned long long)stats.cluster_tests, (unsigned long long)stats.box_tests);
+            ImGui::Text("time: %.3f ms", stats.ms);
+        }
     }
     ImGui::End();
 }
@@ -52,9 +97,29 @@ void display_text() {
 // main
 int main(int argc, char** argv) {   
 
+    //Optionally record CPU/GPU timings of all stages, written on exit as Chrome trace JSON or CSV (by file extension)
+    //Optionally record the interlaced images and/or quilts of every frame to .y4m, .raw or a directory of PNGs
+    //Optionally load the display calibration from a Looking Glass visual.json instead of Lightfield::setLightfieldParameters()
+    //Optionally publish the interlaced images and/or quilts to shared memory rings for other processes, see lfd_frame_consumer
+    //Optionally reload edited shaders while running (off by default, it checks the shader files every frame)
+    fs::path tracePath, recordPath, recordQuiltPath, calibrationPath;
+    bool meshCache = false;
+    std::string exportName, exportQuiltName;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--trace" && i + 1 < argc) tracePath = argv[++i];
+        else if (std::string(argv[i]) == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (std::string(argv[i]) == "--record-quilt" && i + 1 < argc) recordQuiltPath = argv[++i];
+        else if (std::string(argv[i]) == "--calibration" && i + 1 < argc) calibrationPath = argv[++i];
+        else if (std::string(argv[i]) == "--hot-reload") ShaderImpl::hot_reload = true;
+        else if (std::string(argv[i]) == "--mesh-cache") meshCache = true;
+        else if (std::string(argv[i]) == "--export") exportName = i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : "/lfd_interlaced";
+        else if (std::string(argv[i]) == "--export-quilt") exportQuiltName = i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : "/lfd_quilt";
+    }
+
     //Initialize parameters for our adapted projective mapping
     lightfield = new Lightfield();
     lightfield->setLightfieldParameters();
+    if (!calibrationPath.empty()) lightfield->loadCalibration(calibrationPath.string());
 
     //Init GL and window
     ContextParameters params;
@@ -66,6 +131,8 @@ int main(int argc, char** argv) {
     params.resizable = GLFW_FALSE;
     params.decorated = GLFW_FALSE;
     params.swap_interval = 1;
+    params.frames_in_flight = 2;
+    params.frame_pacing = FramePacing::MAX_THROUGHPUT;
     Context::init(params);
     int count; 
     GLFWmonitor** monitors = glfwGetMonitors(&count);
@@ -75,6 +142,12 @@ int main(int argc, char** argv) {
     std::cout << "___________________________________" << std::endl 
         << "Controls: " << std::endl
         << "[T] for toggling between ours and standard rendering. " << std::endl
+        << "[I] for toggling between per view and single-pass (instanced) rendering of all views." << std::endl
+        << "[V] for cycling through the specialized (default), lookup and generic interlacing shaders." << std::endl
+        << "[C] for toggling frustum culling of drawelements against all views." << std::endl
+        << "[B] for toggling batched draws from a shared geometry arena in per view rendering." << std::endl
+        << "[K] for cycling through rendering every view (default) or every 2nd, 3rd or 4th view and synthesizing the others." << std::endl
+        << "[L] for toggling between max throughput (default) and low latency frame pacing." << std::endl
         << "[M] to move the window to a second display (your Looking Glass Display, see README for information about calibration data)." << std::endl
         << "[Enter] to take a screenshot." << std::endl
         << "[F1] for timers and other information." << std::endl
@@ -85,9 +158,11 @@ int main(int argc, char** argv) {
 
     //Set IO functions
     Context::set_keyboard_callback(keyboard_callback);
+    gui_add_callback("culling", display_culling_stats);
 
     //setup draw shader
     Shader("draw", "draw.vs", "draw.fs");
+    Shader("draw_multiview", "draw_multiview.vs", "draw.fs");
 
     //Camera init
     auto defaultcam = Camera("std");
@@ -97,7 +172,7 @@ int main(int argc, char** argv) {
     current_camera()->update();
 
     //Load meshes
-    for (auto& mesh : load_meshes_gpu("../teapot/teapot.obj", true))
+    for (auto& mesh : load_meshes_gpu("../teapot/teapot.obj", true, meshCache))
         Drawelement(mesh->name, Shader::find("draw"), mesh);
 
     //Calculate additional parameters for our adapted projective mapping
@@ -105,6 +180,22 @@ int main(int argc, char** argv) {
     lightfield->getFrustumParameters();
     lightfield->setupQuilts();
 
+    if (!tracePath.empty()) Tracer::enable();
+    std::unique_ptr<FrameRecorder> recorder, quiltRecorder;
+    if (!recordPath.empty())
+        recorder = std::make_unique<FrameRecorder>(recordPath, Context::resolution().x, Context::resolution().y);
+    if (!recordQuiltPath.empty()) {
+        const glm::ivec2 quilt = lightfield->getQuiltDimensions(ourAlgorithm);
+        quiltRecorder = std::make_unique<FrameRecorder>(recordQuiltPath, quilt.x, quilt.y);
+    }
+    std::unique_ptr<SharedFrameExporter> exporter, quiltExporter;
+    if (!exportName.empty())
+        exporter = std::make_unique<SharedFrameExporter>(exportName, Context::resolution().x, Context::resolution().y);
+    if (!exportQuiltName.empty()) {
+        const glm::ivec2 quilt = lightfield->getQuiltDimensions(ourAlgorithm);
+        quiltExporter = std::make_unique<SharedFrameExporter>(exportQuiltName, quilt.x, quilt.y);
+    }
+
     //Run
     while (Context::running()) {
         //Render the individual views
@@ -113,13 +204,54 @@ int main(int argc, char** argv) {
         //Interlace the views and display the interlaced image
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         lightfield->interlacing(ourAlgorithm);
+
+        //Frames whose size differs from the start of the recording (moved window, toggled algorithm) are not recorded
+        if (recorder && Context::resolution() == glm::ivec2(recorder->w, recorder->h))
+            recorder->capture();
+        if (quiltRecorder) {
+            const Texture2D quilt = lightfield->getQuilt(ourAlgorithm)->color_textures[0];
+            if (uint32_t(quilt->w) == quiltRecorder->w && uint32_t(quilt->h) == quiltRecorder->h)
+                quiltRecorder->capture(quilt);
+        }
+        //Exported frames follow the same rule, readers get the calibration hash with every frame
+        if (exporter && Context::resolution() == glm::ivec2(exporter->w, exporter->h)) {
+            exporter->calibration_hash = lightfield->getCalibrationHash();
+            exporter->capture();
+        }
+        if (quiltExporter) {
+            const Texture2D quilt = lightfield->getQuilt(ourAlgorithm)->color_textures[0];
+            if (uint32_t(quilt->w) == quiltExporter->w && uint32_t(quilt->h) == quiltExporter->h) {
+                quiltExporter->calibration_hash = lightfield->getCalibrationHash();
+                quiltExporter->capture(quilt);
+            }
+        }
         Context::swap_buffers();
-        glFinish();
 
         //Display which method is currently rendered
         if (!moveToLightfieldDisplay) display_text();
     }
 
+    for (auto* rec : { recorder.get(), quiltRecorder.get() }) {
+        if (!rec) continue;
+        rec->flush();
+        std::cout << rec->frames_captured << " frames recorded to " << rec->path << " (" << rec->stall_ms << "ms waiting for writers)" << std::endl;
+    }
+    recorder.reset();
+    quiltRecorder.reset();
+    for (auto* exp : { exporter.get(), quiltExporter.get() }) {
+        if (!exp) continue;
+        exp->flush();
+        std::cout << exp->frames_captured << " frames exported to " << exp->name << " (" << exp->stall_ms << "ms waiting for the copy)" << std::endl;
+    }
+    exporter.reset();
+    quiltExporter.reset();
+
+    if (Tracer::enabled()) {
+        Tracer::disable();
+        Tracer::export_trace(tracePath);
+        std::cout << "Trace of " << Tracer::events().size() << " events written to " << tracePath << std::endl;
+    }
+
     return 0;
 
 }
@@ -0,0 +1,14 @@
+#version 330 core
+
+uniform sampler2D source_color;
+
+in vec2 texel;
+flat in float stretched;
+
+layout (location = 0) out vec4 out_col;
+
+void main() {
+    out_col = texelFetch(source_color, ivec2(texel), 0);
+    //surfaces take the front half of the depth range, stretched cells the back half, so they only fill disocclusions
+    gl_FragDepth = gl_FragCoord.z * 0.5 + stretched * 0.5;
+}
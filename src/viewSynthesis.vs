@@ -0,0 +1,49 @@
+#version 330 core
+
+//Forward warps a rendered view of the quilt into another view: a grid over the source view is lifted to 3D with the
+//source depth and projected into the target view, which is rasterized into its quilt tile (see Lightfield::synthesizeViews)
+uniform sampler2D source_depth;
+
+uniform ivec2 source_origin;    //Lower left pixel of the source view in the quilt
+uniform ivec2 tile_size;        //Size of a view in pixels
+uniform int grid_step;          //Pixels between grid vertices
+uniform int cells_x;            //Grid cells per row
+uniform mat4 reprojection;      //Target view-projection times inverse source view-projection
+uniform mat4 source_inv_proj;   //Inverse source projection, to compare view space depths
+uniform float stretch_threshold;//Relative depth difference within a cell above which it spans a depth discontinuity
+
+out vec2 texel;                 //Source pixel in the quilt
+flat out float stretched;       //Cell spans a depth discontinuity, only used to fill holes
+
+const ivec2 corners[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1), ivec2(0, 0), ivec2(1, 1), ivec2(0, 1));
+
+//Clamped depth of a grid point, the background at the far plane would be clipped otherwise
+float depthAt(ivec2 p) {
+    return min(texelFetch(source_depth, source_origin + p, 0).r, 0.9999);
+}
+
+vec3 ndcAt(ivec2 p) {
+    return vec3((vec2(p) + 0.5) / vec2(tile_size), depthAt(p)) * 2.0 - 1.0;
+}
+
+float viewDepth(vec3 ndc) {
+    vec4 pos = source_inv_proj * vec4(ndc, 1.0);
+    return -pos.z / pos.w;
+}
+
+void main() {
+    ivec2 cell = ivec2(gl_VertexID / 6 % cells_x, gl_VertexID / 6 / cells_x);
+    ivec2 p = min((cell + corners[gl_VertexID % 6]) * grid_step, tile_size - 1);
+
+    //all vertices of a cell agree on whether it spans a depth discontinuity
+    float minDepth = 1e30, maxDepth = 0.0;
+    for (int i = 0; i < 4; i++) {
+        float depth = viewDepth(ndcAt(min((cell + corners[i < 3 ? i : 5]) * grid_step, tile_size - 1)));
+        minDepth = min(minDepth, depth);
+        maxDepth = max(maxDepth, depth);
+    }
+    stretched = (maxDepth - minDepth) > stretch_threshold * minDepth ? 1.0 : 0.0;
+
+    texel = vec2(source_origin + p) + 0.5;
+    gl_Position = reprojection * vec4(ndcAt(p), 1.0);
+}
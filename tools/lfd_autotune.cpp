@@ -0,0 +1,294 @@
+#include <cppgl.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "lightfield.h"
+
+
+using namespace cppgl;
+
+//Autotuning settings, see print_usage()
+struct AutotuneSettings {
+    std::string calibration;
+    std::vector<int> views = { 16, 24, 32, 40, 48, 56, 64, 72, 80, 96 };
+    std::vector<glm::ivec2> quilts = { glm::ivec2(2048, 2048), glm::ivec2(2560, 2560), glm::ivec2(3360, 3360), glm::ivec2(4096, 4096) };
+    float aspect_tolerance = 1.5f;
+    int reference_views = 96;
+    glm::ivec2 reference_quilt = glm::ivec2(8192, 8192);
+    double min_psnr = 0.0;
+    double max_mib = 0.0;
+    std::string scene = "../teapot/teapot.obj";
+    std::string out = "autotune_results";
+    bool egl = false;
+};
+
+//A quilt layout and mapping with its cost and its error against the reference
+struct Candidate {
+    std::string mode;
+    int views, rows, columns;
+    glm::ivec2 quilt, rendered;
+    double quilt_mib = 0;
+    double psnr = 0;                //PSNR of the interlaced image against the reference in dB (8 bit RGB)
+    bool within_budget = false;
+    bool pareto = false;            //Not dominated in rendered pixels, quilt memory and PSNR by another candidate within budget
+
+    size_t pixels() const { return size_t(rendered.x) * rendered.y; }
+};
+
+
+void print_usage() {
+    std::cout << "Usage: lfd_autotune [options]" << std::endl
+        << "Sweeps view counts, tile arrangements and quilt resolutions for both mappings, measures the error of each interlaced" << std::endl
+        << "image against a high resolution reference and reports the Pareto-optimal configurations." << std::endl
+        << "  --calibration P   Looking Glass visual.json (default Lightfield::setLightfieldParameters())" << std::endl
+        << "  --views A,B,..    candidate view counts (default 16,24,32,40,48,56,64,72,80,96)" << std::endl
+        << "  --quilts WxH,..   candidate original quilt resolutions (default 2048x2048,2560x2560,3360x3360,4096x4096)" << std::endl
+        << "  --aspect-tol F    largest ratio between the aspect of a view tile and the display (default 1.5)" << std::endl
+        << "  --reference-views N       views of the reference (default 96)" << std::endl
+        << "  --reference-quilt WxH     quilt resolution of the reference, clamped to the texture limit (default 8192x8192)" << std::endl
+        << "  --min-psnr DB     quality budget, candidates below are excluded from the Pareto set (default none)" << std::endl
+        << "  --max-mib MIB     memory budget of the quilt and its depth buffer (default none)" << std::endl
+        << "  --scene PATH      mesh file to render (default ../teapot/teapot.obj)" << std::endl
+        << "  --out PREFIX      writes PREFIX.csv and PREFIX.json (default autotune_results)" << std::endl
+        << "  --egl             create an EGL instead of a native context (e.g. for Mesa llvmpipe)" << std::endl;
+}
+
+std::vector<std::string> split(const std::string& str, char delim) {
+    std::vector<std::string> result;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, delim))
+        if (!item.empty()) result.push_back(item);
+    return result;
+}
+
+glm::ivec2 parse_resolution(const std::string& str) {
+    const auto parts = split(str, 'x');
+    if (parts.size() != 2)
+        throw std::runtime_error("Invalid resolution: " + str + " (expected WxH)");
+    return glm::ivec2(std::stoi(parts[0]), std::stoi(parts[1]));
+}
+
+AutotuneSettings parse_arguments(int argc, char** argv) {
+    AutotuneSettings settings;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--calibration" && has_value) settings.calibration = argv[++i];
+        else if (arg == "--views" && has_value) {
+            settings.views.clear();
+            for (const auto& v : split(argv[++i], ',')) {
+                settings.views.push_back(std::stoi(v));
+                if (settings.views.back() <= 0)
+                    throw std::runtime_error("Invalid view count: " + v + " (expected a positive number)");
+            }
+        }
+        else if (arg == "--quilts" && has_value) {
+            settings.quilts.clear();
+            for (const auto& q : split(argv[++i], ',')) settings.quilts.push_back(parse_resolution(q));
+        }
+        else if (arg == "--aspect-tol" && has_value) settings.aspect_tolerance = std::max(1.0f, std::stof(argv[++i]));
+        else if (arg == "--reference-views" && has_value) {
+            settings.reference_views = std::stoi(argv[++i]);
+            if (settings.reference_views <= 0)
+                throw std::runtime_error("Invalid reference view count: " + std::to_string(settings.reference_views) + " (expected a positive number)");
+        }
+        else if (arg == "--reference-quilt" && has_value) settings.reference_quilt = parse_resolution(argv[++i]);
+        else if (arg == "--min-psnr" && has_value) settings.min_psnr = std::stod(argv[++i]);
+        else if (arg == "--max-mib" && has_value) settings.max_mib = std::stod(argv[++i]);
+        else if (arg == "--scene" && has_value) settings.scene = argv[++i];
+        else if (arg == "--out" && has_value) settings.out = argv[++i];
+        else if (arg == "--egl") settings.egl = true;
+        else {
+            print_usage();
+            exit(arg == "--help" || arg == "-h" ? 0 : 1);
+        }
+    }
+    return settings;
+}
+
+//All arrangements (columns, rows) of the views whose tiles are at most tolerance times wider or narrower than the display
+std::vector<glm::ivec2> tile_arrangements(int views, const glm::ivec2& quilt, float display_aspect, float tolerance) {
+    std::vector<glm::ivec2> arrangements;
+    for (int rows = 1; rows <= views; rows++) {
+        if (views % rows != 0) continue;
+        const int columns = views / rows;
+        const float tile_aspect = (float(quilt.x) / columns) / (float(quilt.y) / rows);
+        const float ratio = tile_aspect / display_aspect;
+        if (ratio <= tolerance && ratio >= 1.0f / tolerance)
+            arrangements.push_back(glm::ivec2(columns, rows));
+    }
+    return arrangements;
+}
+
+
+//Applies a layout and allocates only the quilt of the given mapping, like lfd_rendering
+void apply_layout(Lightfield& lightfield, bool ourAlgorithm, int views, const glm::ivec2& tiles, const glm::ivec2& quilt) {
+    lightfield.setViewParameters(views, tiles.y, tiles.x, quilt.x, quilt.y);
+    lightfield.calculateRotatedBoundingBoxDimensions();
+    lightfield.getFrustumParameters();
+    lightfield.setupQuilts(ourAlgorithm);
+}
+
+//Renders the views and interlaces them into the panel, returns the RGBA8 panel image
+std::vector<uint8_t> render_panel(Lightfield& lightfield, bool ourAlgorithm, Framebuffer& panel) {
+    lightfield.viewRendering(ourAlgorithm);
+    std::vector<uint8_t> pixels(size_t(panel->w) * panel->h * 4);
+    panel->bind();
+    lightfield.interlacing(ourAlgorithm);
+    glReadPixels(0, 0, panel->w, panel->h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    panel->unbind();
+    return pixels;
+}
+
+//PSNR over the RGB channels, identical images are reported with the PSNR of an error of a single step in one channel
+double psnr(const std::vector<uint8_t>& reference, const std::vector<uint8_t>& image) {
+    double squared_error = 0.0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        if (i % 4 == 3) continue;
+        const double error = double(reference[i]) - double(image[i]);
+        squared_error += error * error;
+    }
+    const double channels = double(reference.size() / 4 * 3);
+    return 10.0 * log10(255.0 * 255.0 / std::max(squared_error / channels, 1.0 / channels));
+}
+
+//Marks the candidates within budget that no other candidate within budget beats in all of pixels, memory and PSNR
+void mark_pareto(std::vector<Candidate>& candidates) {
+    for (auto& a : candidates) {
+        if (!a.within_budget) continue;
+        a.pareto = std::none_of(candidates.begin(), candidates.end(), [&](const Candidate& b) {
+            if (!b.within_budget) return false;
+            const bool no_worse = b.pixels() <= a.pixels() && b.quilt_mib <= a.quilt_mib && b.psnr >= a.psnr;
+            const bool better = b.pixels() < a.pixels() || b.quilt_mib < a.quilt_mib || b.psnr > a.psnr;
+            return no_worse && better;
+        });
+    }
+}
+
+
+void write_csv(const std::string& path, const std::vector<Candidate>& candidates) {
+    std::ofstream file(path);
+    file << "mode,views,rows,columns,quilt_width,quilt_height,rendered_width,rendered_height,rendered_pixels,quilt_mib,psnr,within_budget,pareto" << std::endl;
+    for (const auto& c : candidates) {
+        file << c.mode << "," << c.views << "," << c.rows << "," << c.columns << "," << c.quilt.x << "," << c.quilt.y << ","
+             << c.rendered.x << "," << c.rendered.y << "," << c.pixels() << "," << c.quilt_mib << "," << c.psnr << ","
+             << c.within_budget << "," << c.pareto << std::endl;
+    }
+}
+
+void write_json(const std::string& path, const std::vector<Candidate>& candidates) {
+    std::ofstream file(path);
+    file << "[" << std::endl;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const auto& c = candidates[i];
+        file << "  {\"mode\": \"" << c.mode << "\", \"views\": " << c.views << ", \"rows\": " << c.rows << ", \"columns\": " << c.columns
+             << ", \"quilt\": [" << c.quilt.x << ", " << c.quilt.y << "], \"rendered\": [" << c.rendered.x << ", " << c.rendered.y << "]"
+             << ", \"rendered_pixels\": " << c.pixels() << ", \"quilt_mib\": " << c.quilt_mib << ", \"psnr\": " << c.psnr
+             << ", \"within_budget\": " << (c.within_budget ? "true" : "false") << ", \"pareto\": " << (c.pareto ? "true" : "false") << "}"
+             << (i + 1 < candidates.size() ? "," : "") << std::endl;
+    }
+    file << "]" << std::endl;
+}
+
+
+
+// --------------------------------------------------------------------
+// main
+int main(int argc, char** argv) {
+    const AutotuneSettings settings = parse_arguments(argc, argv);
+
+    Lightfield lightfield;
+    lightfield.setLightfieldParameters();
+    if (!settings.calibration.empty()) lightfield.loadCalibration(settings.calibration);
+    lightfield.skipUnchangedFrames = false;
+    const glm::ivec2 panel_res(lightfield.imageWidth, lightfield.imageHeight);
+
+    //Init GL with a hidden window, everything is rendered offscreen
+    ContextParameters params;
+    params.title = "lfd_autotune";
+    params.width = panel_res.x;
+    params.height = panel_res.y;
+    params.gl_major = 3;
+    params.gl_minor = 3;
+    params.visible = GLFW_FALSE;
+    params.swap_interval = 0;
+    params.context_api = settings.egl ? GLFW_EGL_CONTEXT_API : GLFW_NATIVE_CONTEXT_API;
+    Context::init(params);
+    glClearColor(1, 1, 1, 1);
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+
+    //Scene setup as in lfd_rendering
+    Shader("draw", "draw.vs", "draw.fs");
+    auto defaultcam = Camera("std");
+    make_camera_current(defaultcam);
+    current_camera()->dir = glm::vec3(current_camera()->dir.z, current_camera()->dir.y, current_camera()->dir.x);
+    current_camera()->pos -= current_camera()->dir * 2.f;
+    current_camera()->update();
+    for (auto& mesh : load_meshes_gpu(settings.scene, true))
+        Drawelement(mesh->name, Shader::find("draw"), mesh);
+    TextureLoader::finish();
+
+    Framebuffer panel = Framebuffer("autotune_panel", panel_res.x, panel_res.y);
+    panel->attach_depthbuffer();
+    panel->attach_colorbuffer(Texture2D("autotune_panel_col", panel_res.x, panel_res.y, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE));
+    panel->check();
+
+    //Reference: many views at a high resolution with the standard mapping
+    const glm::ivec2 reference_quilt = glm::min(settings.reference_quilt, glm::ivec2(max_texture_size));
+    const glm::ivec2 reference_tiles = Lightfield::getTileLayout(settings.reference_views);
+    apply_layout(lightfield, false, settings.reference_views, reference_tiles, reference_quilt);
+    const std::vector<uint8_t> reference = render_panel(lightfield, false, panel);
+    std::cout << "Reference: " << settings.reference_views << " views (" << reference_tiles.y << "x" << reference_tiles.x << "), quilt: "
+        << reference_quilt.x << "x" << reference_quilt.y << ", panel: " << panel_res.x << "x" << panel_res.y << std::endl;
+
+    std::vector<Candidate> candidates;
+    const float display_aspect = float(panel_res.x) / float(panel_res.y);
+    for (const auto& quilt : settings.quilts) {
+        for (const int views : settings.views) {
+            for (const auto& tiles : tile_arrangements(views, quilt, display_aspect, settings.aspect_tolerance)) {
+                for (const bool ourAlgorithm : { true, false }) {
+                    Candidate c;
+                    c.mode = ourAlgorithm ? "adapted" : "standard";
+                    c.views = views;
+                    c.rows = tiles.y;
+                    c.columns = tiles.x;
+                    c.quilt = quilt;
+                    lightfield.setViewParameters(views, tiles.y, tiles.x, quilt.x, quilt.y);
+                    lightfield.calculateRotatedBoundingBoxDimensions();
+                    lightfield.getFrustumParameters();
+                    c.rendered = lightfield.getQuiltDimensions(ourAlgorithm);
+                    if (c.rendered.x > max_texture_size || c.rendered.y > max_texture_size) {
+                        std::cout << c.mode << " views: " << views << " (" << tiles.y << "x" << tiles.x << "), quilt: " << quilt.x << "x" << quilt.y
+                            << " skipped, rendered quilt " << c.rendered.x << "x" << c.rendered.y << " exceeds the texture limit" << std::endl;
+                        continue;
+                    }
+                    lightfield.setupQuilts(ourAlgorithm);
+                    c.psnr = psnr(reference, render_panel(lightfield, ourAlgorithm, panel));
+                    c.quilt_mib = lightfield.getQuiltMemory() / (1024.0 * 1024.0);
+                    c.within_budget = c.psnr >= settings.min_psnr && (settings.max_mib <= 0.0 || c.quilt_mib <= settings.max_mib);
+                    std::cout << c.mode << " views: " << views << " (" << tiles.y << "x" << tiles.x << "), quilt: " << quilt.x << "x" << quilt.y
+                        << ", rendered: " << c.rendered.x << "x" << c.rendered.y << " (" << c.quilt_mib << " MiB), PSNR: " << c.psnr << "dB" << std::endl;
+                    candidates.push_back(c);
+                }
+            }
+        }
+    }
+
+    mark_pareto(candidates);
+    std::vector<Candidate> front;
+    std::copy_if(candidates.begin(), candidates.end(), std::back_inserter(front), [](const Candidate& c) { return c.pareto; });
+    std::sort(front.begin(), front.end(), [](const Candidate& a, const Candidate& b) { return a.pixels() < b.pixels(); });
+    std::cout << "___________________________________" << std::endl
+        << "Pareto-optimal configurations (" << front.size() << " of " << candidates.size() << "):" << std::endl;
+    for (const auto& c : front)
+        std::cout << "  " << c.mode << " views: " << c.views << " (" << c.rows << "x" << c.columns << "), quilt: " << c.quilt.x << "x" << c.quilt.y
+            << ", rendered pixels: " << c.pixels() << ", " << c.quilt_mib << " MiB, PSNR: " << c.psnr << "dB" << std::endl;
+
+    write_csv(settings.out + ".csv", candidates);
+    write_json(settings.out + ".json", candidates);
+    std::cout << "Results written to " << settings.out << ".csv and " << settings.out << ".json" << std::endl;
+    return 0;
+}
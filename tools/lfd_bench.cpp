@@ -0,0 +1,415 @@
+#include <cppgl.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "lightfield.h"
+
+
+using namespace cppgl;
+
+//Benchmark settings, see print_usage()
+struct BenchSettings {
+    int frames = 100;
+    int warmup = 10;
+    std::vector<int> views = { 48 };
+    std::vector<glm::ivec2> quilts = { glm::ivec2(3360, 3360) };
+    std::vector<glm::ivec2> panels = { glm::ivec2(1536, 2048) };
+    std::string scene = "../teapot/teapot.obj";
+    std::string out = "bench_results";
+    bool egl = false;
+    bool single_pass = false;
+    std::vector<std::string> interlacing = { "specialized" };
+    std::vector<std::string> quilt_formats = { "rgba8" };
+    std::vector<int> synthesis = { 1 };
+    bool validate = false;
+    double max_error_ratio = 0.001;     //--validate fails above this ratio of channels that differ from the CPU by more than one step
+};
+
+//Averaged measurements of a single configuration
+struct BenchResult {
+    std::string mode, rendering, interlacing, quilt_format;
+    int views, rows, columns;
+    glm::ivec2 quilt, panel, rendered;
+    double cpu_view_ms = 0, gpu_view_ms = 0, gpu_view_min_ms = 1e10;
+    double gpu_interlacing_ms = 0, gpu_interlacing_min_ms = 1e10;
+    double cpu_frame_ms = 0;
+    double samples_passed = 0;
+    double quilt_mib = 0;           //Video memory of the allocated quilts and their depth buffer
+    int cpu_max_error = -1;         //Largest difference to the CPU Interlacer in 8 bit steps, -1 if not validated
+    double cpu_error_ratio = 0;     //Ratio of channels that differ by more than one step
+    int specialized_max_error = -1; //Largest difference of the lookup to the specialized variant in 8 bit steps, -1 if not compared
+    size_t scalar_mismatches = 0;   //Channels in which the SIMD CPU Interlacer differs from its scalar path, must be 0
+    int synthesis = 1;              //Synthesis stride, every k-th view is rendered
+    double psnr_mean = 0, psnr_min = 0;     //PSNR of the synthesized views against rendered ones in dB, 0 without synthesis
+};
+
+
+void print_usage() {
+    std::cout << "Usage: lfd_bench [options]" << std::endl
+        << "  --frames N        measured frames per configuration (default 100)" << std::endl
+        << "  --warmup N        unmeasured frames per configuration (default 10)" << std::endl
+        << "  --views A,B,..    view counts, tiled into rows x columns (default 48)" << std::endl
+        << "  --quilts WxH,..   original quilt resolutions (default 3360x3360)" << std::endl
+        << "  --panels WxH,..   interlaced image resolutions (default 1536x2048)" << std::endl
+        << "  --scene PATH      mesh file to render (default ../teapot/teapot.obj)" << std::endl
+        << "  --out PREFIX      writes PREFIX.csv and PREFIX.json (default bench_results)" << std::endl
+        << "  --single-pass     additionally measure single-pass (instanced) view rendering" << std::endl
+        << "  --interlacing A,. interlacing shader variants: uniforms, specialized, lookup (default specialized)" << std::endl
+        << "  --quilt-formats . quilt color formats: rgba8, rgb10a2, rgba16f, rgba32f (default rgba8)" << std::endl
+        << "  --synthesis K,..  render every K-th view and synthesize the others, reports their PSNR (default 1)" << std::endl
+        << "  --validate        compare each interlaced image against the CPU Interlacer (and lookup against specialized)," << std::endl
+        << "                    exits with 1 if a comparison fails (see --max-error-ratio)" << std::endl
+        << "  --max-error-ratio R  ratio of channels that may differ from the CPU by more than one step (default 0.001)," << std::endl
+        << "                    the lookup may differ from specialized by one step, the SIMD and scalar CPU paths not at all" << std::endl
+        << "  --egl             create an EGL instead of a native context (e.g. for Mesa llvmpipe)" << std::endl;
+}
+
+std::vector<std::string> split(const std::string& str, char delim) {
+    std::vector<std::string> result;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, delim))
+        if (!item.empty()) result.push_back(item);
+    return result;
+}
+
+glm::ivec2 parse_resolution(const std::string& str) {
+    const auto parts = split(str, 'x');
+    if (parts.size() != 2)
+        throw std::runtime_error("Invalid resolution: " + str + " (expected WxH)");
+    return glm::ivec2(std::stoi(parts[0]), std::stoi(parts[1]));
+}
+
+//Maps the names accepted by --interlacing to the shader variants of the lightfield
+Lightfield::InterlacingVariant interlacing_variant(const std::string& name) {
+    if (name == "uniforms") return Lightfield::InterlacingVariant::Uniforms;
+    if (name == "specialized") return Lightfield::InterlacingVariant::Specialized;
+    if (name == "lookup") return Lightfield::InterlacingVariant::Lookup;
+    throw std::runtime_error("Invalid interlacing variant: " + name + " (expected uniforms, specialized or lookup)");
+}
+
+//Maps the names accepted by --quilt-formats to internal texture formats
+GLint quilt_format(const std::string& name) {
+    if (name == "rgba8") return GL_RGBA8;
+    if (name == "rgb10a2") return GL_RGB10_A2;
+    if (name == "rgba16f") return GL_RGBA16F;
+    if (name == "rgba32f") return GL_RGBA32F;
+    throw std::runtime_error("Invalid quilt format: " + name + " (expected rgba8, rgb10a2, rgba16f or rgba32f)");
+}
+
+BenchSettings parse_arguments(int argc, char** argv) {
+    BenchSettings settings;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--frames" && has_value) settings.frames = std::stoi(argv[++i]);
+        else if (arg == "--warmup" && has_value) settings.warmup = std::stoi(argv[++i]);
+        else if (arg == "--views" && has_value) {
+            settings.views.clear();
+            for (const auto& v : split(argv[++i], ',')) {
+                settings.views.push_back(std::stoi(v));
+                if (settings.views.back() <= 0)
+                    throw std::runtime_error("Invalid view count: " + v + " (expected a positive number)");
+            }
+        }
+        else if (arg == "--quilts" && has_value) {
+            settings.quilts.clear();
+            for (const auto& q : split(argv[++i], ',')) settings.quilts.push_back(parse_resolution(q));
+        }
+        else if (arg == "--panels" && has_value) {
+            settings.panels.clear();
+            for (const auto& p : split(argv[++i], ',')) settings.panels.push_back(parse_resolution(p));
+        }
+        else if (arg == "--scene" && has_value) settings.scene = argv[++i];
+        else if (arg == "--out" && has_value) settings.out = argv[++i];
+        else if (arg == "--single-pass") settings.single_pass = true;
+        else if (arg == "--interlacing" && has_value) {
+            settings.interlacing = split(argv[++i], ',');
+            for (const auto& v : settings.interlacing) interlacing_variant(v);
+        }
+        else if (arg == "--quilt-formats" && has_value) {
+            settings.quilt_formats = split(argv[++i], ',');
+            for (const auto& v : settings.quilt_formats) quilt_format(v);
+        }
+        else if (arg == "--synthesis" && has_value) {
+            settings.synthesis.clear();
+            for (const auto& k : split(argv[++i], ',')) settings.synthesis.push_back(std::max(1, std::stoi(k)));
+        }
+        else if (arg == "--validate") settings.validate = true;
+        else if (arg == "--max-error-ratio" && has_value) settings.max_error_ratio = std::stod(argv[++i]);
+        else if (arg == "--egl") settings.egl = true;
+        else {
+            print_usage();
+            exit(arg == "--help" || arg == "-h" ? 0 : 1);
+        }
+    }
+    return settings;
+}
+
+
+//Renders the configured number of frames in one mode and averages the per stage timings
+BenchResult run_configuration(Lightfield& lightfield, bool ourAlgorithm, const BenchSettings& settings, Framebuffer& panel) {
+    static GLuint timestamps[3] = { 0, 0, 0 };
+    static GLuint samples = 0;
+    if (!samples) {
+        glGenQueries(3, timestamps);
+        glGenQueries(1, &samples);
+    }
+
+    //The context counts the fragments of each frame between swap_buffers() calls, which the bench never makes
+    //Only one GL_SAMPLES_PASSED query may be active, so pause the context's query during the measurement
+    Context::instance().frag_count->end();
+    while (glGetError() != GL_NO_ERROR);
+
+    BenchResult result;
+    result.mode = ourAlgorithm ? "adapted" : "standard";
+    result.rendering = lightfield.singlePassRendering ? "single-pass" : "per-view";
+    result.rendered = lightfield.getQuiltDimensions(ourAlgorithm);
+    result.panel = glm::ivec2(panel->w, panel->h);
+
+    for (int frame = 0; frame < settings.warmup + settings.frames; frame++) {
+        Timer frame_timer;
+        glQueryCounter(timestamps[0], GL_TIMESTAMP);
+        glBeginQuery(GL_SAMPLES_PASSED, samples);
+        Timer view_timer;
+        lightfield.viewRendering(ourAlgorithm);
+        const double cpu_view_ms = view_timer.look();
+        glEndQuery(GL_SAMPLES_PASSED);
+        glQueryCounter(timestamps[1], GL_TIMESTAMP);
+
+        panel->bind();
+        lightfield.interlacing(ourAlgorithm);
+        panel->unbind();
+        glQueryCounter(timestamps[2], GL_TIMESTAMP);
+        glFinish();
+        const double cpu_frame_ms = frame_timer.look();
+        if (frame < settings.warmup) continue;
+
+        GLuint64 t[3] = { 0, 0, 0 }; GLuint passed = 0;
+        for (int i = 0; i < 3; i++)
+            glGetQueryObjectui64v(timestamps[i], GL_QUERY_RESULT, &t[i]);
+        glGetQueryObjectuiv(samples, GL_QUERY_RESULT, &passed);
+        const double gpu_view_ms = (t[1] - t[0]) / 1000000.0;
+        const double gpu_interlacing_ms = (t[2] - t[1]) / 1000000.0;
+
+        result.cpu_view_ms += cpu_view_ms / settings.frames;
+        result.cpu_frame_ms += cpu_frame_ms / settings.frames;
+        result.gpu_view_ms += gpu_view_ms / settings.frames;
+        result.gpu_interlacing_ms += gpu_interlacing_ms / settings.frames;
+        result.gpu_view_min_ms = std::min(result.gpu_view_min_ms, gpu_view_ms);
+        result.gpu_interlacing_min_ms = std::min(result.gpu_interlacing_min_ms, gpu_interlacing_ms);
+        result.samples_passed += double(passed) / settings.frames;
+    }
+
+    const GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+        std::cerr << "GL error 0x" << std::hex << error << std::dec << " in " << result.mode << " " << result.rendering << " configuration, its timings may be invalid" << std::endl;
+    Context::instance().frag_count->begin();
+    return result;
+}
+
+//Interlaces the current quilt on the GPU and with the CPU Interlacer and stores the differences in the result
+//The quilt is quantized to 8 bit first, so both sides sample identical texel values
+//The lookup variant is also compared to the specialized one, which computes the same view indices per subpixel
+//and the CPU Interlacer (AVX2 where available) to its scalar path, which has to match it exactly
+void validate_interlacing(Lightfield& lightfield, bool ourAlgorithm, Framebuffer& panel, ThreadPool& pool, BenchResult& result) {
+    const Texture2D quilt = lightfield.getQuilt(ourAlgorithm)->color_textures[0];
+    std::vector<uint8_t> quilt_data(size_t(quilt->w) * quilt->h * 4);
+    glBindTexture(GL_TEXTURE_2D, quilt->id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, quilt_data.data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quilt->w, quilt->h, GL_RGBA, GL_UNSIGNED_BYTE, quilt_data.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    std::vector<uint8_t> gpu(size_t(panel->w) * panel->h * 4), cpu(gpu.size());
+    panel->bind();
+    lightfield.interlacing(ourAlgorithm);
+    glReadPixels(0, 0, panel->w, panel->h, GL_RGBA, GL_UNSIGNED_BYTE, gpu.data());
+    std::vector<uint8_t> specialized;
+    if (lightfield.interlacingVariant == Lightfield::InterlacingVariant::Lookup) {
+        specialized.resize(gpu.size());
+        lightfield.interlacingVariant = Lightfield::InterlacingVariant::Specialized;
+        lightfield.interlacing(ourAlgorithm);
+        glReadPixels(0, 0, panel->w, panel->h, GL_RGBA, GL_UNSIGNED_BYTE, specialized.data());
+        lightfield.interlacingVariant = Lightfield::InterlacingVariant::Lookup;
+    }
+    panel->unbind();
+    const Interlacer interlacer(lightfield.getInterlacingParameters(), ourAlgorithm);
+    interlacer.interlace(quilt_data.data(), quilt->w, quilt->h, cpu.data(), panel->w, panel->h, pool);
+    std::vector<uint8_t> scalar(gpu.size());
+    pool.parallel_for(panel->h, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++)
+            interlacer.interlaceRowScalar(quilt_data.data(), quilt->w, quilt->h, scalar.data() + y * panel->w * 4, int(y), 0, panel->w, panel->h);
+    });
+    result.scalar_mismatches = 0;
+    for (size_t i = 0; i < cpu.size(); i++)
+        if (cpu[i] != scalar[i]) result.scalar_mismatches++;
+
+    size_t errors = 0;
+    result.cpu_max_error = 0;
+    for (size_t i = 0; i < gpu.size(); i++) {
+        if (i % 4 == 3) continue;
+        const int error = std::abs(int(gpu[i]) - int(cpu[i]));
+        result.cpu_max_error = std::max(result.cpu_max_error, error);
+        if (error > 1) errors++;
+    }
+    result.cpu_error_ratio = double(errors) / (gpu.size() / 4 * 3);
+
+    if (specialized.empty()) return;
+    result.specialized_max_error = 0;
+    for (size_t i = 0; i < gpu.size(); i++)
+        if (i % 4 != 3) result.specialized_max_error = std::max(result.specialized_max_error, std::abs(int(gpu[i]) - int(specialized[i])));
+}
+
+//Whether the interlaced image of a validated configuration is within the thresholds of --validate
+bool validation_passed(const BenchResult& result, const BenchSettings& settings) {
+    return result.cpu_error_ratio <= settings.max_error_ratio && result.specialized_max_error <= 1 && result.scalar_mismatches == 0;
+}
+
+
+void write_csv(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream file(path);
+    file << "mode,rendering,interlacing,quilt_format,quilt_mib,views,rows,columns,quilt_width,quilt_height,panel_width,panel_height,rendered_width,rendered_height,rendered_pixels,"
+         << "samples_passed,cpu_view_ms,gpu_view_ms,gpu_view_min_ms,gpu_interlacing_ms,gpu_interlacing_min_ms,cpu_frame_ms,cpu_max_error,cpu_error_ratio,specialized_max_error,scalar_mismatches,synthesis,psnr_mean,psnr_min" << std::endl;
+    for (const auto& r : results) {
+        file << r.mode << "," << r.rendering << "," << r.interlacing << "," << r.quilt_format << "," << r.quilt_mib << "," << r.views << "," << r.rows << "," << r.columns << ","
+             << r.quilt.x << "," << r.quilt.y << "," << r.panel.x << "," << r.panel.y << ","
+             << r.rendered.x << "," << r.rendered.y << "," << size_t(r.rendered.x) * r.rendered.y << ","
+             << size_t(r.samples_passed) << "," << r.cpu_view_ms << "," << r.gpu_view_ms << "," << r.gpu_view_min_ms << ","
+             << r.gpu_interlacing_ms << "," << r.gpu_interlacing_min_ms << "," << r.cpu_frame_ms << "," << r.cpu_max_error << "," << r.cpu_error_ratio << "," << r.specialized_max_error << "," << r.scalar_mismatches << ","
+             << r.synthesis << "," << r.psnr_mean << "," << r.psnr_min << std::endl;
+    }
+}
+
+void write_json(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream file(path);
+    file << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        file << "  {\"mode\": \"" << r.mode << "\", \"rendering\": \"" << r.rendering << "\", \"interlacing\": \"" << r.interlacing << "\", \"quilt_format\": \"" << r.quilt_format << "\", \"quilt_mib\": " << r.quilt_mib << ", \"views\": " << r.views << ", \"rows\": " << r.rows << ", \"columns\": " << r.columns
+             << ", \"quilt\": [" << r.quilt.x << ", " << r.quilt.y << "], \"panel\": [" << r.panel.x << ", " << r.panel.y << "]"
+             << ", \"rendered\": [" << r.rendered.x << ", " << r.rendered.y << "], \"rendered_pixels\": " << size_t(r.rendered.x) * r.rendered.y
+             << ", \"samples_passed\": " << size_t(r.samples_passed)
+             << ", \"cpu_view_ms\": " << r.cpu_view_ms << ", \"gpu_view_ms\": " << r.gpu_view_ms << ", \"gpu_view_min_ms\": " << r.gpu_view_min_ms
+             << ", \"gpu_interlacing_ms\": " << r.gpu_interlacing_ms << ", \"gpu_interlacing_min_ms\": " << r.gpu_interlacing_min_ms
+             << ", \"cpu_frame_ms\": " << r.cpu_frame_ms << ", \"cpu_max_error\": " << r.cpu_max_error << ", \"cpu_error_ratio\": " << r.cpu_error_ratio << ", \"specialized_max_error\": " << r.specialized_max_error << ", \"scalar_mismatches\": " << r.scalar_mismatches
+             << ", \"synthesis\": " << r.synthesis << ", \"psnr_mean\": " << r.psnr_mean << ", \"psnr_min\": " << r.psnr_min << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    file << "]" << std::endl;
+}
+
+
+
+// --------------------------------------------------------------------
+// main
+int main(int argc, char** argv) {
+    const BenchSettings settings = parse_arguments(argc, argv);
+
+    //Init GL with a hidden window, the interlaced image is rendered offscreen
+    ContextParameters params;
+    params.title = "lfd_bench";
+    params.width = settings.panels[0].x;
+    params.height = settings.panels[0].y;
+    params.gl_major = 3;
+    params.gl_minor = 3;
+    params.visible = GLFW_FALSE;
+    params.swap_interval = 0;
+    params.context_api = settings.egl ? GLFW_EGL_CONTEXT_API : GLFW_NATIVE_CONTEXT_API;
+    Context::init(params);
+    glClearColor(1, 1, 1, 1);
+
+    //Scene setup as in lfd_rendering
+    Shader("draw", "draw.vs", "draw.fs");
+    Shader("draw_multiview", "draw_multiview.vs", "draw.fs");
+    auto defaultcam = Camera("std");
+    make_camera_current(defaultcam);
+    current_camera()->dir = glm::vec3(current_camera()->dir.z, current_camera()->dir.y, current_camera()->dir.x);
+    current_camera()->pos -= current_camera()->dir * 2.f;
+    current_camera()->update();
+    for (auto& mesh : load_meshes_gpu(settings.scene, true))
+        Drawelement(mesh->name, Shader::find("draw"), mesh);
+    TextureLoader::finish();    //Measure with the final textures, not the placeholders
+
+    std::vector<BenchResult> results;
+    bool failed = false;
+    Lightfield lightfield;
+    lightfield.skipUnchangedFrames = false;    //The scene is static, measure every frame
+    ThreadPool pool;
+    for (const auto& panel_res : settings.panels) {
+        Framebuffer panel = Framebuffer("bench_panel", panel_res.x, panel_res.y);
+        panel->attach_depthbuffer();
+        panel->attach_colorbuffer(Texture2D("bench_panel_col", panel_res.x, panel_res.y, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE));
+        panel->check();
+
+        for (const auto& quilt : settings.quilts) {
+            for (const int views : settings.views) {
+                const glm::ivec2 layout = Lightfield::getTileLayout(views);
+                lightfield.setLightfieldParameters();
+                lightfield.setDisplayResolution(panel_res.x, panel_res.y);
+                lightfield.setViewParameters(views, layout.y, layout.x, quilt.x, quilt.y);
+                lightfield.calculateRotatedBoundingBoxDimensions();
+                lightfield.getFrustumParameters();
+
+                for (const auto& format : settings.quilt_formats) {
+                    lightfield.quiltFormat = quilt_format(format);
+                    lightfield.setupQuilts();
+
+                    for (const bool singlePass : { false, true }) {
+                        if (singlePass && !settings.single_pass) continue;
+                        lightfield.singlePassRendering = singlePass;
+                        for (const auto& interlacing : settings.interlacing) {
+                            lightfield.interlacingVariant = interlacing_variant(interlacing);
+                            for (const int synthesis : settings.synthesis) {
+                                lightfield.synthesisStride = synthesis;
+                                for (const bool ourAlgorithm : { true, false }) {
+                                    //Only the quilt of the measured algorithm is allocated, like in lfd_rendering
+                                    lightfield.releaseQuilt(!ourAlgorithm);
+                                    BenchResult result = run_configuration(lightfield, ourAlgorithm, settings, panel);
+                                    result.interlacing = interlacing;
+                                    result.quilt_format = format;
+                                    result.quilt_mib = lightfield.getQuiltMemory() / (1024.0 * 1024.0);
+                                    result.views = views;
+                                    result.rows = layout.y;
+                                    result.columns = layout.x;
+                                    result.quilt = quilt;
+                                    result.synthesis = synthesis;
+                                    if (synthesis > 1) {
+                                        const Lightfield::SynthesisQuality quality = lightfield.measureSynthesisQuality(ourAlgorithm);
+                                        result.psnr_mean = quality.psnrMean;
+                                        result.psnr_min = quality.psnrMin;
+                                    }
+                                    if (settings.validate)
+                                        validate_interlacing(lightfield, ourAlgorithm, panel, pool, result);
+                                    std::cout << result.mode << " (" << result.rendering << ", " << interlacing << " interlacing, " << format << " quilt) views: " << views << " (" << layout.y << "x" << layout.x << ")"
+                                        << ", quilt: " << quilt.x << "x" << quilt.y << ", panel: " << panel_res.x << "x" << panel_res.y
+                                        << ", rendered: " << result.rendered.x << "x" << result.rendered.y << " (" << result.quilt_mib << " MiB)"
+                                        << ", view rendering: " << result.gpu_view_ms << "ms (GPU) " << result.cpu_view_ms << "ms (CPU)"
+                                        << ", interlacing: " << result.gpu_interlacing_ms << "ms (GPU)";
+                                    if (settings.validate)
+                                        std::cout << ", max error to CPU: " << result.cpu_max_error << " (" << result.cpu_error_ratio * 100.0 << "% > 1)";
+                                    if (result.specialized_max_error >= 0)
+                                        std::cout << ", max error to specialized: " << result.specialized_max_error;
+                                    if (settings.validate)
+                                        std::cout << ", SIMD/scalar mismatches: " << result.scalar_mismatches;
+                                    if (synthesis > 1)
+                                        std::cout << ", synthesis k=" << synthesis << ": " << result.psnr_mean << "dB mean, " << result.psnr_min << "dB min";
+                                    std::cout << std::endl;
+                                    if (settings.validate && !validation_passed(result, settings)) {
+                                        std::cerr << "Validation failed: " << result.mode << " (" << result.rendering << ", " << interlacing << " interlacing, " << format << " quilt), " << views << " views" << std::endl;
+                                        failed = true;
+                                    }
+                                    results.push_back(result);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    write_csv(settings.out + ".csv", results);
+    write_json(settings.out + ".json", results);
+    std::cout << "Results written to " << settings.out << ".csv and " << settings.out << ".json" << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+#include <cppgl.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+
+using namespace cppgl;
+
+//Consumer settings, see print_usage()
+struct ConsumerSettings {
+    std::string name = "/lfd_interlaced";
+    int frames = 600;
+    double timeout = 10.0;      //Seconds to wait for the producer and between frames
+    int poll_us = 100;
+    bool touch = false;
+    std::string csv;
+};
+
+
+void print_usage() {
+    std::cout << "Usage: lfd_frame_consumer [options]" << std::endl
+        << "Reads the newest frames that lfd_rendering --export publishes to shared memory, in place and without blocking" << std::endl
+        << "the renderer, and reports the latency from the end of rendering to the arrival of each frame." << std::endl
+        << "  --name NAME       shared memory object (default /lfd_interlaced, the quilts are in /lfd_quilt)" << std::endl
+        << "  --frames N        frames to receive (default 600)" << std::endl
+        << "  --timeout S       seconds to wait for the producer and for each frame (default 10)" << std::endl
+        << "  --poll-us N       sleep between polls in microseconds, 0 spins (default 100)" << std::endl
+        << "  --touch           read every pixel of each frame, like an encoder would" << std::endl
+        << "  --csv FILE        write frame index and latencies of every received frame" << std::endl;
+}
+
+ConsumerSettings parse_arguments(int argc, char** argv) {
+    ConsumerSettings settings;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--name" && has_value) settings.name = argv[++i];
+        else if (arg == "--frames" && has_value) settings.frames = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--timeout" && has_value) settings.timeout = std::stod(argv[++i]);
+        else if (arg == "--poll-us" && has_value) settings.poll_us = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--touch") settings.touch = true;
+        else if (arg == "--csv" && has_value) settings.csv = argv[++i];
+        else {
+            print_usage();
+            exit(arg == "--help" || arg == "-h" ? 0 : 1);
+        }
+    }
+    return settings;
+}
+
+void poll_sleep(const ConsumerSettings& settings) {
+    if (settings.poll_us > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(settings.poll_us));
+    else
+        std::this_thread::yield();
+}
+
+//Retries until the producer created the ring
+std::unique_ptr<SharedFrameReader> open_reader(const ConsumerSettings& settings) {
+    const int64_t deadline = shared_frames_now_ns() + int64_t(settings.timeout * 1e9);
+    while (true) {
+        try {
+            return std::make_unique<SharedFrameReader>(settings.name);
+        } catch (const std::exception& e) {
+            if (shared_frames_now_ns() > deadline) {
+                std::cerr << e.what() << std::endl;
+                return nullptr;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+//Sum of all bytes, so the compiler can't skip reading the pixels
+uint64_t checksum(const SharedFrameView& view) {
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < view.h; y++) {
+        const uint8_t* row = view.pixels + size_t(y) * view.stride;
+        sum = std::accumulate(row, row + size_t(view.w) * 4, sum);
+    }
+    return sum;
+}
+
+//Received frame: capture to publish and capture to arrival in ms
+struct Arrival {
+    uint64_t frame;
+    double publish_ms, arrival_ms, read_ms;
+};
+
+void print_statistics(const std::string& label, std::vector<double> values) {
+    if (values.empty()) return;
+    std::sort(values.begin(), values.end());
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    auto percentile = [&](double p) { return values[std::min(values.size() - 1, size_t(p * values.size()))]; };
+    std::cout << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(3)
+        << " min " << values.front() << "  mean " << mean << "  p50 " << percentile(0.5)
+        << "  p99 " << percentile(0.99) << "  max " << values.back() << " ms" << std::endl;
+}
+
+
+
+// --------------------------------------------------------------------
+// main
+int main(int argc, char** argv) {
+    const ConsumerSettings settings = parse_arguments(argc, argv);
+    const std::unique_ptr<SharedFrameReader> reader = open_reader(settings);
+    if (!reader) return 1;
+    std::cout << "Reading " << reader->name << " of process " << reader->header->producer_pid << ": "
+        << reader->header->slot_count << " slots of " << reader->header->slot_bytes / double(1 << 20) << " MiB" << std::endl;
+
+    std::vector<Arrival> arrivals;
+    uint64_t seen = 0, skipped = 0, busy = 0, overwritten = 0, calibrations = 0, calibration_hash = 0, sum = 0;
+    int64_t last_arrival = shared_frames_now_ns();
+    while (int(arrivals.size()) < settings.frames && !reader->closed()) {
+        if (reader->published() <= seen) {
+            if (shared_frames_now_ns() - last_arrival > int64_t(settings.timeout * 1e9)) {
+                std::cerr << "No frame for " << settings.timeout << "s" << std::endl;
+                break;
+            }
+            poll_sleep(settings);
+            continue;
+        }
+        SharedFrameView view;
+        if (!reader->latest(view)) {
+            //The producer moved on and overwrote the slot between the loads
+            busy++;
+            poll_sleep(settings);
+            continue;
+        }
+        const int64_t arrival = shared_frames_now_ns();
+        if (view.frame < seen) continue;
+        skipped += view.frame - seen;
+        seen = view.frame + 1;
+        last_arrival = arrival;
+        if (arrivals.empty() || view.calibration_hash != calibration_hash) {
+            calibration_hash = view.calibration_hash;
+            calibrations++;
+        }
+
+        double read_ms = 0.0;
+        if (settings.touch) {
+            sum += checksum(view);
+            read_ms = (shared_frames_now_ns() - arrival) * 1e-6;
+            //The pixels were replaced while reading: the consumer is slower than slot_count - 1 frames
+            if (!reader->valid(view)) overwritten++;
+        }
+        arrivals.push_back({ view.frame, (view.publish_ns - view.capture_ns) * 1e-6, (arrival - view.capture_ns) * 1e-6, read_ms });
+    }
+
+    std::cout << arrivals.size() << " frames received, " << skipped << " skipped (newer frame already published), "
+        << busy << " polls raced with the producer";
+    if (settings.touch) std::cout << ", " << overwritten << " overwritten while reading (checksum " << sum << ")";
+    std::cout << ", " << calibrations << " calibration(s)" << std::endl;
+    std::vector<double> publish, arrival, read;
+    for (const Arrival& a : arrivals) {
+        publish.push_back(a.publish_ms);
+        arrival.push_back(a.arrival_ms);
+        read.push_back(a.read_ms);
+    }
+    print_statistics("capture to publish", publish);
+    print_statistics("capture to arrival", arrival);
+    if (settings.touch) print_statistics("read in place", read);
+
+    if (!settings.csv.empty()) {
+        std::ofstream csv(settings.csv);
+        csv << "frame,publish_ms,arrival_ms,read_ms" << std::endl;
+        for (const Arrival& a : arrivals)
+            csv << a.frame << "," << a.publish_ms << "," << a.arrival_ms << "," << a.read_ms << std::endl;
+        std::cout << "Results written to " << settings.csv << std::endl;
+    }
+    return arrivals.empty() ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+#include <cppgl.h>
+#include <iostream>
+#include <random>
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+using namespace cppgl;
+
+//Benchmark settings, see print_usage()
+struct GeometryBenchSettings {
+    int meshes = 16;
+    int vertices = 1000000;     //Per mesh
+    int runs = 5;
+    int threads = 0;
+};
+
+
+void print_usage() {
+    std::cout << "Usage: lfd_geometry_bench [options]" << std::endl
+        << "Normalizes random meshes into [-1, 1]^3 like load_meshes_cpu with the previous scalar passes (bounds, translate," << std::endl
+        << "scale) and with the fused transform, sequential and on a thread pool, and checks that the results agree." << std::endl
+        << "  --meshes N        number of meshes (default 16)" << std::endl
+        << "  --vertices N      vertices per mesh (default 1000000)" << std::endl
+        << "  --runs N          measured runs, the fastest is reported (default 5)" << std::endl
+        << "  --threads N       worker threads (default one per hardware thread)" << std::endl;
+}
+
+GeometryBenchSettings parse_arguments(int argc, char** argv) {
+    GeometryBenchSettings settings;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--meshes" && has_value) settings.meshes = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--vertices" && has_value) settings.vertices = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--runs" && has_value) settings.runs = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--threads" && has_value) settings.threads = std::stoi(argv[++i]);
+        else {
+            print_usage();
+            exit(arg == "--help" || arg == "-h" ? 0 : 1);
+        }
+    }
+    return settings;
+}
+
+//Meshes with random positions in an offset box and random unit normals, the same for every seed
+std::vector<Geometry> random_geometries(const GeometryBenchSettings& settings, const std::string& prefix) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-3.f, 5.f), direction(-1.f, 1.f);
+    std::vector<Geometry> geometries;
+    for (int m = 0; m < settings.meshes; m++) {
+        std::vector<glm::vec3> positions(settings.vertices), normals(settings.vertices);
+        for (int v = 0; v < settings.vertices; v++) {
+            positions[v] = glm::vec3(position(rng), position(rng), position(rng)) - glm::vec3(10.f);
+            normals[v] = glm::normalize(glm::vec3(direction(rng), direction(rng), direction(rng)) + glm::vec3(1e-3f));
+        }
+        geometries.push_back(Geometry(prefix + std::to_string(m), positions, std::vector<uint32_t>{ 0, 1, 2 }, normals));
+    }
+    return geometries;
+}
+
+//Center and scale factor of load_meshes_cpu(normalize = true)
+void normalization(const std::vector<Geometry>& geometries, glm::vec3& center, float& scale) {
+    glm::vec3 bb_min(FLT_MAX), bb_max(-FLT_MAX);
+    for (const auto& geom : geometries) {
+        bb_min = glm::min(bb_min, geom->bb_min);
+        bb_max = glm::max(bb_max, geom->bb_max);
+    }
+    center = (bb_min + bb_max) * 0.5f;
+    const glm::vec3 scale_v = glm::vec3(2) / (bb_max - bb_min);
+    scale = std::min(scale_v.x, std::min(scale_v.y, scale_v.z));
+}
+
+//The passes of load_meshes_cpu before the fused transform: bounds, translate, then scale with normalized normals
+void normalize_scalar(std::vector<Geometry>& geometries) {
+    for (auto& geom : geometries) {
+        geom->bb_min = glm::vec3(FLT_MAX);
+        geom->bb_max = glm::vec3(-FLT_MAX);
+        for (const auto& pos : geom->positions) {
+            geom->bb_min = glm::min(geom->bb_min, pos);
+            geom->bb_max = glm::max(geom->bb_max, pos);
+        }
+    }
+    glm::vec3 center;
+    float scale;
+    normalization(geometries, center, scale);
+    const glm::mat4 mat_norm = glm::transpose(glm::inverse(glm::scale(glm::mat4(1), glm::vec3(scale))));
+    for (auto& geom : geometries) {
+        for (auto& pos : geom->positions)
+            pos += -center;
+        for (auto& pos : geom->positions)
+            pos *= glm::vec3(scale);
+        for (auto& normal : geom->normals)
+            normal = glm::normalize(glm::vec3(mat_norm * glm::vec4(normal, 0)));
+    }
+}
+
+//The fused pass: bounds of each mesh, then one transform of all meshes
+void normalize_fused(std::vector<Geometry>& geometries, ThreadPool* pool) {
+    for (auto& geom : geometries)
+        geom->recompute_aabb(pool);
+    glm::vec3 center;
+    float scale;
+    normalization(geometries, center, scale);
+    transform_geometries(geometries, glm::scale(glm::mat4(1), glm::vec3(scale)) * glm::translate(glm::mat4(1), -center), pool);
+}
+
+//Fastest of the runs in ms, the geometries are regenerated before every run
+double measure(const GeometryBenchSettings& settings, const std::string& prefix, const std::function<void(std::vector<Geometry>&)>& func, std::vector<Geometry>& result) {
+    double best = 1e10;
+    for (int run = 0; run < settings.runs; run++) {
+        //Drop the previous run from the registry, the geometries of earlier measurements are held by their results
+        result.clear();
+        for (int m = 0; m < settings.meshes; m++)
+            Geometry::erase(prefix + std::to_string(m));
+        result = random_geometries(settings, prefix);
+        Timer timer;
+        func(result);
+        best = std::min(best, timer.look());
+    }
+    return best;
+}
+
+//Largest absolute difference of positions and normals
+float max_difference(const std::vector<Geometry>& a, const std::vector<Geometry>& b) {
+    float difference = 0.f;
+    for (size_t m = 0; m < a.size(); m++) {
+        for (size_t v = 0; v < a[m]->positions.size(); v++) {
+            const glm::vec3 d = glm::max(glm::abs(a[m]->positions[v] - b[m]->positions[v]), glm::abs(a[m]->normals[v] - b[m]->normals[v]));
+            difference = std::max(difference, std::max(d.x, std::max(d.y, d.z)));
+        }
+    }
+    return difference;
+}
+
+bool identical(const std::vector<Geometry>& a, const std::vector<Geometry>& b) {
+    for (size_t m = 0; m < a.size(); m++) {
+        if (std::memcmp(a[m]->positions.data(), b[m]->positions.data(), a[m]->positions.size() * sizeof(glm::vec3)) != 0) return false;
+        if (std::memcmp(a[m]->normals.data(), b[m]->normals.data(), a[m]->normals.size() * sizeof(glm::vec3)) != 0) return false;
+        if (a[m]->bb_min != b[m]->bb_min || a[m]->bb_max != b[m]->bb_max) return false;
+    }
+    return true;
+}
+
+
+
+// --------------------------------------------------------------------
+// main
+int main(int argc, char** argv) {
+    const GeometryBenchSettings settings = parse_arguments(argc, argv);
+    ThreadPool pool(settings.threads);
+    std::cout << settings.meshes << " meshes of " << settings.vertices << " vertices, " << pool.size() << " threads" << std::endl;
+
+    std::vector<Geometry> scalar, fused, parallel;
+    const double scalar_ms = measure(settings, "scalar_", normalize_scalar, scalar);
+    const double fused_ms = measure(settings, "fused_", [](std::vector<Geometry>& g) { normalize_fused(g, nullptr); }, fused);
+    const double parallel_ms = measure(settings, "parallel_", [&](std::vector<Geometry>& g) { normalize_fused(g, &pool); }, parallel);
+
+    std::cout << "scalar passes: " << scalar_ms << "ms" << std::endl
+        << "fused:         " << fused_ms << "ms (" << scalar_ms / fused_ms << "x)" << std::endl
+        << "fused, pool:   " << parallel_ms << "ms (" << scalar_ms / parallel_ms << "x)" << std::endl
+        << "max difference to the scalar passes: " << max_difference(scalar, fused) << std::endl
+        << "fused with and without pool identical: " << (identical(fused, parallel) ? "yes" : "no") << std::endl;
+    return identical(fused, parallel) ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include <cppgl.h>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include "lightfield.h"
+
+
+using namespace cppgl;
+
+//Conversion settings, see print_usage()
+struct InterlaceSettings {
+    fs::path input, output;
+    bool ourAlgorithm = true;
+    glm::ivec2 tiles = glm::ivec2(8, 6);
+    glm::ivec2 quilt = glm::ivec2(3360, 3360);
+    glm::ivec2 panel = glm::ivec2(0, 0);
+    int threads = 0;
+    std::string format = ".png";
+};
+
+
+void print_usage() {
+    std::cout << "Usage: lfd_interlace [options] INPUT_DIR OUTPUT_DIR" << std::endl
+        << "Interlaces all quilt images (.png, .jpg, .tga, .bmp) of INPUT_DIR on the CPU and writes the panel images to OUTPUT_DIR." << std::endl
+        << "The calibration is taken from Lightfield::setLightfieldParameters()." << std::endl
+        << "  --algorithm NAME  adapted (quilts of our algorithm) or standard (default adapted)" << std::endl
+        << "  --tiles CxR       columns and rows of views in the quilt (default 8x6)" << std::endl
+        << "  --quilt WxH       original quilt resolution the adapted quilts were derived from (default 3360x3360)" << std::endl
+        << "  --panel WxH       interlaced image resolution (default from the calibration)" << std::endl
+        << "  --threads N       worker threads (default one per hardware thread)" << std::endl
+        << "  --format EXT      output file format: png, jpg, tga or bmp (default png)" << std::endl;
+}
+
+glm::ivec2 parse_resolution(const std::string& str) {
+    const auto x = str.find('x');
+    if (x == std::string::npos)
+        throw std::runtime_error("Invalid resolution: " + str + " (expected WxH)");
+    return glm::ivec2(std::stoi(str.substr(0, x)), std::stoi(str.substr(x + 1)));
+}
+
+InterlaceSettings parse_arguments(int argc, char** argv) {
+    InterlaceSettings settings;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--algorithm" && has_value) {
+            const std::string algorithm = argv[++i];
+            if (algorithm != "adapted" && algorithm != "standard")
+                throw std::runtime_error("Invalid algorithm: " + algorithm + " (expected adapted or standard)");
+            settings.ourAlgorithm = algorithm == "adapted";
+        }
+        else if (arg == "--tiles" && has_value) settings.tiles = parse_resolution(argv[++i]);
+        else if (arg == "--quilt" && has_value) settings.quilt = parse_resolution(argv[++i]);
+        else if (arg == "--panel" && has_value) settings.panel = parse_resolution(argv[++i]);
+        else if (arg == "--threads" && has_value) settings.threads = std::stoi(argv[++i]);
+        else if (arg == "--format" && has_value) settings.format = "." + std::string(argv[++i]);
+        else if (arg.rfind("--", 0) != 0) positional.push_back(arg);
+        else {
+            print_usage();
+            exit(arg == "--help" || arg == "-h" ? 0 : 1);
+        }
+    }
+    if (positional.size() != 2) {
+        print_usage();
+        exit(1);
+    }
+    settings.input = positional[0];
+    settings.output = positional[1];
+    return settings;
+}
+
+bool is_image(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp";
+}
+
+//Expands 8 bit images with 1-4 channels to RGBA
+std::vector<uint8_t> to_rgba(const std::vector<uint8_t>& data, int w, int h, int channels) {
+    if (channels == 4) return data;
+    std::vector<uint8_t> rgba(size_t(w) * h * 4);
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+        for (int c = 0; c < 3; c++)
+            rgba[i * 4 + c] = data[i * channels + (channels >= 3 ? c : 0)];
+        rgba[i * 4 + 3] = channels == 2 || channels == 4 ? data[i * channels + channels - 1] : 255;
+    }
+    return rgba;
+}
+
+
+
+// --------------------------------------------------------------------
+// main
+int main(int argc, char** argv) {
+    const InterlaceSettings settings = parse_arguments(argc, argv);
+
+    //Derive the interlacing parameters like lfd_rendering, no GL context is needed for this
+    Lightfield lightfield;
+    lightfield.setLightfieldParameters();
+    if (settings.panel.x > 0)
+        lightfield.setDisplayResolution(settings.panel.x, settings.panel.y);
+    lightfield.setViewParameters(settings.tiles.x * settings.tiles.y, settings.tiles.y, settings.tiles.x, settings.quilt.x, settings.quilt.y);
+    lightfield.calculateRotatedBoundingBoxDimensions();
+    lightfield.getFrustumParameters();
+    const glm::ivec2 expected = lightfield.getQuiltDimensions(settings.ourAlgorithm);
+    const Interlacer interlacer(lightfield.getInterlacingParameters(), settings.ourAlgorithm);
+
+    std::vector<fs::path> quilts;
+    for (const auto& entry : fs::directory_iterator(settings.input))
+        if (entry.is_regular_file() && is_image(entry.path()))
+            quilts.push_back(entry.path());
+    std::sort(quilts.begin(), quilts.end());
+    fs::create_directories(settings.output);
+
+    ThreadPool pool(settings.threads);
+    std::vector<uint8_t> image(size_t(lightfield.imageWidth) * lightfield.imageHeight * 4);
+    std::cout << "Interlacing " << quilts.size() << " quilts to " << lightfield.imageWidth << "x" << lightfield.imageHeight
+        << " with " << pool.size() << " threads" << std::endl;
+
+    Timer total;
+    for (const auto& path : quilts) {
+        auto [data, w, h, channels, is_hdr] = image_load(path);
+        if (is_hdr) {
+            std::cerr << "Skipping HDR image " << path << std::endl;
+            continue;
+        }
+        if (w != expected.x || h != expected.y)
+            std::cerr << "Warning: " << path << " is " << w << "x" << h << ", expected a " << expected.x << "x" << expected.y << " quilt" << std::endl;
+
+        Timer timer;
+        const std::vector<uint8_t> quilt = to_rgba(data, w, h, channels);
+        interlacer.interlace(quilt.data(), w, h, image.data(), lightfield.imageWidth, lightfield.imageHeight, pool);
+        const double ms = timer.look();
+
+        const fs::path out = settings.output / path.filename().replace_extension(settings.format);
+        image_store_ldr(out, image.data(), lightfield.imageWidth, lightfield.imageHeight, 4);
+        std::cout << path.filename().string() << " -> " << out.string() << " (" << ms << "ms)" << std::endl;
+    }
+    std::cout << "Done in " << total.look() / 1000.0 << "s" << std::endl;
+    return 0;
+}